@@ -1,4 +1,4 @@
-QT       += core gui sql
+QT       += core gui sql concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,29 +9,62 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    brushengine.cpp \
+    colormatrix.cpp \
     databasemanager.cpp \
     filterapplyer.cpp \
     filterdialog.cpp \
+    filterjob.cpp \
+    floatimage.cpp \
+    floodfill.cpp \
     graphicscanvas.cpp \
+    imagedisplayitem.cpp \
     imageentry.cpp \
     imagemanipulator.cpp \
+    integralimage.cpp \
+    jpegexif.cpp \
     main.cpp \
     mainwindow.cpp \
+    orientation.cpp \
     procedure.cpp \
     project.cpp \
-    resizedialog.cpp
+    resampler.cpp \
+    resizedialog.cpp \
+    rotatedialog.cpp \
+    simdkernels.cpp \
+    tiledimage.cpp \
+    tilescheduler.cpp \
+    undohistory.cpp \
+    warpengine.cpp
 
 HEADERS += \
+    brushengine.h \
+    colormatrix.h \
     databasemanager.h \
     filterapplyer.h \
     filterdialog.h \
+    filterjob.h \
+    floatimage.h \
+    floodfill.h \
     graphicscanvas.h \
+    imagedisplayitem.h \
     imageentry.h \
     imagemanipulator.h \
+    integralimage.h \
+    jpegexif.h \
     mainwindow.h \
+    orientation.h \
+    pixeltraits.h \
     procedure.h \
     project.h \
-    resizedialog.h
+    resampler.h \
+    resizedialog.h \
+    rotatedialog.h \
+    simdkernels.h \
+    tiledimage.h \
+    tilescheduler.h \
+    undohistory.h \
+    warpengine.h
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
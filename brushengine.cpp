@@ -0,0 +1,228 @@
+#include "brushengine.h"
+#include "simdkernels.h"
+
+#include <QColor>
+#include <QtMath>
+#include <algorithm>
+
+namespace {
+
+const int TileSize = TiledImage::TileSize;
+// Dab centers are rounded to a quarter pixel, so each size has 4 x 4 masks.
+const int kPhases = 4;
+// Masks of brushes no longer in use are dropped once the cache grows past this.
+const int kMaxCachedDabs = 1024;
+
+// The painted pixels of Qt::Dense1Pattern to Qt::DiagCrossPattern, as QBrush draws
+// them: one byte per row, the lowest bit being the leftmost pixel.
+const uchar kPatterns[13][8] = {
+    { 0xff, 0xbb, 0xff, 0xff, 0xff, 0xbb, 0xff, 0xff },
+    { 0x77, 0xff, 0xdd, 0xff, 0x77, 0xff, 0xdd, 0xff },
+    { 0x55, 0xbb, 0x55, 0xee, 0x55, 0xbb, 0x55, 0xee },
+    { 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55 },
+    { 0xaa, 0x44, 0xaa, 0x11, 0xaa, 0x44, 0xaa, 0x11 },
+    { 0x88, 0x00, 0x22, 0x00, 0x88, 0x00, 0x22, 0x00 },
+    { 0x00, 0x44, 0x00, 0x00, 0x00, 0x44, 0x00, 0x00 },
+    { 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0x00 },
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },
+    { 0x10, 0x10, 0x10, 0xff, 0x10, 0x10, 0x10, 0x10 },
+    { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 },
+    { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 },
+    { 0x81, 0x42, 0x24, 0x18, 0x18, 0x24, 0x42, 0x81 }
+};
+
+int floorDiv(int value, int divisor){
+    return (value >= 0) ? value / divisor : -((divisor - 1 - value) / divisor);
+}
+
+// Keeps the coverage of the pattern's painted pixels in a buffer whose top left
+// pixel is at origin.
+void applyPattern(QVector<uchar>& coverage, const QPoint& origin, int width, Qt::BrushStyle pattern){
+    const uchar* rows = kPatterns[pattern - Qt::Dense1Pattern];
+    const int height = coverage.size() / width;
+    uchar* line = coverage.data();
+    for(int y = 0; y < height; ++y, line += width){
+        uchar masks[8];
+        const uchar bits = rows[(origin.y() + y) & 7];
+        for(int i = 0; i < 8; ++i){
+            masks[i] = ((bits >> ((origin.x() + i) & 7)) & 1) ? 0xff : 0x00;
+        }
+        for(int x = 0; x < width; ++x){
+            line[x] &= masks[x & 7];
+        }
+    }
+}
+
+bool anyCovered(const uchar* coverage, int stride, const QRect& area){
+    for(int y = 0; y < area.height(); ++y){
+        const uchar* line = coverage + y * stride;
+        if(std::any_of(line, line + area.width(), [](uchar value){ return value != 0; })){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Source-over for tile formats the kernel does not take, in floating point so that
+// 16-bit tiles keep their precision.
+QColor blendColor(const QColor& dst, const QColor& color, qreal alpha){
+    const qreal dstAlpha = dst.alphaF();
+    const qreal outAlpha = alpha + dstAlpha * (1 - alpha);
+    if(outAlpha <= 0){
+        return QColor(Qt::transparent);
+    }
+    const auto mix = [&](qreal s, qreal d){
+        return (s * alpha + d * dstAlpha * (1 - alpha)) / outAlpha;
+    };
+    return QColor::fromRgbF(mix(color.redF(), dst.redF()), mix(color.greenF(), dst.greenF()),
+                            mix(color.blueF(), dst.blueF()), outAlpha);
+}
+
+// Blends color into the part of a tile covered by area, whose coverage starts at
+// coverage with rows stride bytes apart.
+void blendTile(QImage& tile, const QPoint& origin, const QRect& area, const uchar* coverage, int stride, QRgb color){
+    const int tx = area.left() - origin.x();
+    switch(tile.format()){
+    case QImage::Format_ARGB32:
+    case QImage::Format_RGB32:
+        for(int y = 0; y < area.height(); ++y){
+            QRgb* line = reinterpret_cast<QRgb*>(tile.scanLine(area.top() - origin.y() + y)) + tx;
+            SimdKernels::blendCoverage(line, coverage + y * stride, area.width(), color);
+        }
+        break;
+    default:{
+        const QColor source = QColor::fromRgba(color);
+        for(int y = 0; y < area.height(); ++y){
+            const int ty = area.top() - origin.y() + y;
+            const uchar* cover = coverage + y * stride;
+            for(int x = 0; x < area.width(); ++x){
+                if(cover[x]){
+                    const qreal alpha = cover[x] / 255.0 * source.alphaF();
+                    tile.setPixelColor(tx + x, ty, blendColor(tile.pixelColor(tx + x, ty), source, alpha));
+                }
+            }
+        }
+        break;
+    }
+    }
+}
+
+}
+
+BrushEngine::BrushEngine()
+    : m_travelled(0)
+{
+}
+
+QRect BrushEngine::beginStroke(TiledImage& image, const Brush& brush, const QPointF& position)
+{
+    m_brush = brush;
+    m_brush.diameter = qMax(qreal(1), brush.diameter);
+    m_brush.hardness = qBound(qreal(0), brush.hardness, qreal(1));
+    if(m_dabs.size() > kMaxCachedDabs){
+        m_dabs.clear();
+    }
+    m_position = position;
+    m_travelled = 0;
+    return stamp(image, QVector<QPointF>() << position);
+}
+
+QRect BrushEngine::strokeTo(TiledImage& image, const QPointF& position)
+{
+    const qreal step = qMax(qreal(0.5), m_brush.spacing * m_brush.diameter);
+    const QPointF delta = position - m_position;
+    const qreal length = qSqrt(delta.x() * delta.x() + delta.y() * delta.y());
+    QVector<QPointF> centers;
+    qreal along = step - m_travelled;
+    for(; along <= length; along += step){
+        centers.append(m_position + delta * (along / length));
+    }
+    m_travelled = centers.isEmpty() ? m_travelled + length : length - (along - step);
+    m_position = position;
+    return stamp(image, centers);
+}
+
+const BrushEngine::Dab& BrushEngine::dab(int phaseX, int phaseY)
+{
+    const quint64 key = quint64(qRound(m_brush.diameter * kPhases))
+                      | (quint64(qRound(m_brush.hardness * 255)) << 32)
+                      | (quint64(phaseX) << 40) | (quint64(phaseY) << 48);
+    Dab& mask = m_dabs[key];
+    if(!mask.coverage.isEmpty()){
+        return mask;
+    }
+
+    const qreal radius = m_brush.diameter / 2;
+    const qreal fade = radius * (1 - m_brush.hardness) + 1;
+    const int half = qCeil(radius) + 1;
+    mask.size = 2 * half + 1;
+    mask.coverage.resize(mask.size * mask.size);
+    uchar* coverage = mask.coverage.data();
+    // Mask pixel (0, 0) is half pixels left of and above the pixel holding the center.
+    for(int j = 0; j < mask.size; ++j){
+        const qreal dy = j - half + 0.5 - qreal(phaseY) / kPhases;
+        for(int i = 0; i < mask.size; ++i){
+            const qreal dx = i - half + 0.5 - qreal(phaseX) / kPhases;
+            const qreal value = (radius + 0.5 - qSqrt(dx * dx + dy * dy)) / fade;
+            *coverage++ = uchar(qRound(qBound(qreal(0), value, qreal(1)) * 255));
+        }
+    }
+    return mask;
+}
+
+QRect BrushEngine::stamp(TiledImage& image, const QVector<QPointF>& centers)
+{
+    struct Placed{
+        QPoint topLeft;
+        const Dab* dab;
+    };
+    QVector<Placed> placed;
+    QRect bounds;
+    for(const QPointF& center : centers){
+        const int x = qRound(center.x() * kPhases);
+        const int y = qRound(center.y() * kPhases);
+        const QPoint pixel(floorDiv(x, kPhases), floorDiv(y, kPhases));
+        const Dab& mask = dab(x - pixel.x() * kPhases, y - pixel.y() * kPhases);
+        const int half = mask.size / 2;
+        const Placed item = { pixel - QPoint(half, half), &mask };
+        placed.append(item);
+        bounds |= QRect(item.topLeft, QSize(mask.size, mask.size));
+    }
+    bounds &= image.rect();
+    if(bounds.isEmpty()){
+        return QRect();
+    }
+
+    // Overlapping dabs take the larger coverage, so spacing does not darken the edges.
+    const int width = bounds.width();
+    QVector<uchar> coverage(width * bounds.height(), 0);
+    for(const Placed& item : placed){
+        const int size = item.dab->size;
+        const QRect area = QRect(item.topLeft, QSize(size, size)) & bounds;
+        for(int y = area.top(); y <= area.bottom(); ++y){
+            const uchar* in = item.dab->coverage.constData() + (y - item.topLeft.y()) * size
+                            + (area.left() - item.topLeft.x());
+            uchar* out = coverage.data() + (y - bounds.top()) * width + (area.left() - bounds.left());
+            for(int x = 0; x < area.width(); ++x){
+                out[x] = qMax(out[x], in[x]);
+            }
+        }
+    }
+    if(m_brush.pattern >= Qt::Dense1Pattern && m_brush.pattern <= Qt::DiagCrossPattern){
+        applyPattern(coverage, bounds.topLeft(), width, m_brush.pattern);
+    }
+
+    for(int row = bounds.top() / TileSize; row <= bounds.bottom() / TileSize; ++row){
+        for(int column = bounds.left() / TileSize; column <= bounds.right() / TileSize; ++column){
+            const QPoint origin(column * TileSize, row * TileSize);
+            const int index = image.tileIndex(origin);
+            const QRect area = image.tileRect(index) & bounds;
+            const uchar* start = coverage.constData() + (area.top() - bounds.top()) * width + (area.left() - bounds.left());
+            // Tiles the stroke only passes near stay shared with the undo history.
+            if(anyCovered(start, width, area)){
+                blendTile(image.editTile(index), origin, area, start, width, m_brush.color);
+            }
+        }
+    }
+    return bounds;
+}
@@ -0,0 +1,60 @@
+#ifndef BRUSHENGINE_H
+#define BRUSHENGINE_H
+
+#include <QHash>
+#include <QPointF>
+#include <QRect>
+#include <QRgb>
+#include <QVector>
+
+#include "tiledimage.h"
+
+// Paints strokes as a row of dabs, round stamps of the brush spaced evenly along
+// the path. Dab masks depend only on the diameter, the hardness and where the dab
+// center falls within a pixel, so they are built once and cached. The dabs of one
+// segment are merged into a coverage buffer, masked by the fill pattern, and
+// blended with SimdKernels::blendCoverage() into just the tiles they reach.
+class BrushEngine
+{
+public:
+    struct Brush{
+        QRgb color = 0xff000000;
+        qreal diameter = 3;
+        // 1 gives a hard edge, antialiased over one pixel; below that the dab
+        // fades out from hardness * radius to its rim.
+        qreal hardness = 1;
+        // Distance between dabs as a fraction of the diameter.
+        qreal spacing = 0.1;
+        // Qt::SolidPattern or one of the 8x8 patterns Qt::Dense1Pattern to
+        // Qt::DiagCrossPattern, aligned to image coordinates like a QBrush.
+        Qt::BrushStyle pattern = Qt::SolidPattern;
+    };
+
+public:
+    BrushEngine();
+
+    // Starts a stroke with a dab at position, in pixels with pixel (x, y) covering
+    // x..x + 1. Returns the rectangle painted, empty if it missed the image.
+    QRect beginStroke(TiledImage& image, const Brush& brush, const QPointF& position);
+    // Continues the stroke to position. The distance left over after the last dab
+    // carries over to the next segment, so dabs stay evenly spaced.
+    QRect strokeTo(TiledImage& image, const QPointF& position);
+
+private:
+    struct Dab{
+        int size;
+        QVector<uchar> coverage;
+    };
+
+    const Dab& dab(int phaseX, int phaseY);
+    QRect stamp(TiledImage& image, const QVector<QPointF>& centers);
+
+private:
+    Brush m_brush;
+    QPointF m_position;
+    // How far the stroke went since the last dab.
+    qreal m_travelled;
+    QHash<quint64, Dab> m_dabs;
+};
+
+#endif // BRUSHENGINE_H
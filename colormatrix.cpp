@@ -0,0 +1,165 @@
+#include "colormatrix.h"
+
+#include <QtMath>
+
+namespace {
+
+// Rec. 601 luma weights, as used by the saturation filter before.
+const double kLumaRed = 0.299;
+const double kLumaGreen = 0.587;
+const double kLumaBlue = 0.114;
+
+}
+
+ColorMatrix::ColorMatrix()
+{
+    for(int row = 0; row < 4; ++row){
+        for(int column = 0; column < 5; ++column){
+            m_values[row][column] = (row == column) ? 1.0 : 0.0;
+        }
+    }
+}
+
+ColorMatrix ColorMatrix::grayscale()
+{
+    // The qGray() weights 11/32, 16/32 and 5/32, which are exact in fixed point.
+    ColorMatrix matrix;
+    for(int row = Red; row <= Blue; ++row){
+        matrix.m_values[row][Red] = 11.0 / 32.0;
+        matrix.m_values[row][Green] = 16.0 / 32.0;
+        matrix.m_values[row][Blue] = 5.0 / 32.0;
+    }
+    return matrix;
+}
+
+ColorMatrix ColorMatrix::sepia()
+{
+    const double values[3][3] = {
+        { 0.393, 0.769, 0.189 },
+        { 0.349, 0.686, 0.168 },
+        { 0.272, 0.534, 0.131 }
+    };
+    ColorMatrix matrix;
+    for(int row = Red; row <= Blue; ++row){
+        for(int column = Red; column <= Blue; ++column){
+            matrix.m_values[row][column] = values[row][column];
+        }
+    }
+    return matrix;
+}
+
+ColorMatrix ColorMatrix::invert()
+{
+    ColorMatrix matrix;
+    for(int row = Red; row <= Blue; ++row){
+        matrix.m_values[row][row] = -1.0;
+        matrix.m_values[row][Offset] = 255.0;
+    }
+    return matrix;
+}
+
+ColorMatrix ColorMatrix::contrast(double factor)
+{
+    ColorMatrix matrix;
+    for(int row = Red; row <= Blue; ++row){
+        matrix.m_values[row][row] = factor;
+        matrix.m_values[row][Offset] = 128.0 * (1.0 - factor);
+    }
+    return matrix;
+}
+
+ColorMatrix ColorMatrix::saturation(double factor)
+{
+    const double luma[3] = { kLumaRed, kLumaGreen, kLumaBlue };
+    ColorMatrix matrix;
+    for(int row = Red; row <= Blue; ++row){
+        for(int column = Red; column <= Blue; ++column){
+            matrix.m_values[row][column] = (1.0 - factor) * luma[column] + (row == column ? factor : 0.0);
+        }
+    }
+    return matrix;
+}
+
+ColorMatrix ColorMatrix::hueRotation(double degrees)
+{
+    // Rotation in the plane orthogonal to the luma axis, in the form of the SVG
+    // hueRotate matrix: luma is unchanged and grays stay gray.
+    const double c = qCos(qDegreesToRadians(degrees));
+    const double s = qSin(qDegreesToRadians(degrees));
+    const double values[3][3] = {
+        { 0.213 + c * 0.787 - s * 0.213, 0.715 - c * 0.715 - s * 0.715, 0.072 - c * 0.072 + s * 0.928 },
+        { 0.213 - c * 0.213 + s * 0.143, 0.715 + c * 0.285 + s * 0.140, 0.072 - c * 0.072 - s * 0.283 },
+        { 0.213 - c * 0.213 - s * 0.787, 0.715 - c * 0.715 + s * 0.715, 0.072 + c * 0.928 + s * 0.072 }
+    };
+    ColorMatrix matrix;
+    for(int row = Red; row <= Blue; ++row){
+        for(int column = Red; column <= Blue; ++column){
+            matrix.m_values[row][column] = values[row][column];
+        }
+    }
+    return matrix;
+}
+
+double ColorMatrix::at(int row, int column) const
+{
+    return m_values[row][column];
+}
+
+void ColorMatrix::set(int row, int column, double value)
+{
+    m_values[row][column] = value;
+}
+
+bool ColorMatrix::isIdentity() const
+{
+    const ColorMatrix identity;
+    for(int row = 0; row < 4; ++row){
+        for(int column = 0; column < 5; ++column){
+            if(m_values[row][column] != identity.m_values[row][column]){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ColorMatrix::staysInRange() const
+{
+    // An affine map takes its extremes on the corners of the cube: each term
+    // contributes its minimum and maximum independently.
+    const double tolerance = 1e-9;
+    for(int row = 0; row < 4; ++row){
+        double low = m_values[row][Offset];
+        double high = low;
+        for(int column = 0; column < 4; ++column){
+            const double extent = m_values[row][column] * 255.0;
+            low += qMin(0.0, extent);
+            high += qMax(0.0, extent);
+        }
+        if(low < -tolerance || high > 255.0 + tolerance){
+            return false;
+        }
+    }
+    return true;
+}
+
+ColorMatrix ColorMatrix::then(const ColorMatrix& next) const
+{
+    return next * (*this);
+}
+
+ColorMatrix ColorMatrix::operator*(const ColorMatrix& other) const
+{
+    // Both are affine, i.e. 5x5 matrices with an implicit last row (0, 0, 0, 0, 1).
+    ColorMatrix result;
+    for(int row = 0; row < 4; ++row){
+        for(int column = 0; column < 5; ++column){
+            double value = (column == Offset) ? m_values[row][Offset] : 0.0;
+            for(int k = 0; k < 4; ++k){
+                value += m_values[row][k] * other.m_values[k][column];
+            }
+            result.m_values[row][column] = value;
+        }
+    }
+    return result;
+}
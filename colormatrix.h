@@ -0,0 +1,51 @@
+#ifndef COLORMATRIX_H
+#define COLORMATRIX_H
+
+#include <QRgb>
+
+// Affine color transform as a 4x5 matrix: rows produce red, green, blue and
+// alpha from the input (red, green, blue, alpha, 1), the last column being an
+// offset in 0..255 units. Filters expressed this way can be concatenated and
+// applied in one pass with FilterApplyer::applyColorMatrix().
+class ColorMatrix
+{
+public:
+    enum Channel{
+        Red,
+        Green,
+        Blue,
+        Alpha,
+        Offset
+    };
+
+public:
+    // Identity.
+    ColorMatrix();
+
+    static ColorMatrix grayscale();
+    static ColorMatrix sepia();
+    static ColorMatrix invert();
+    static ColorMatrix contrast(double factor);
+    // Moves every color away from (factor > 1) or towards (factor < 1) its luma.
+    static ColorMatrix saturation(double factor);
+    // Rotates the chroma around the gray axis, keeping luma.
+    static ColorMatrix hueRotation(double degrees);
+
+    double at(int row, int column) const;
+    void set(int row, int column, double value);
+    bool isIdentity() const;
+    // True if every input in 0..255 maps to outputs in 0..255, so that clamping
+    // after this matrix never changes anything.
+    bool staysInRange() const;
+
+    // The matrix that applies this one first and then next. Nothing is clamped in
+    // between, so the result differs from two passes where the first one saturates.
+    ColorMatrix then(const ColorMatrix& next) const;
+    // Matrix product: other is applied first.
+    ColorMatrix operator*(const ColorMatrix& other) const;
+
+private:
+    double m_values[4][5];
+};
+
+#endif // COLORMATRIX_H
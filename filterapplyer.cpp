@@ -1,293 +1,956 @@
 #include "filterapplyer.h"
+#include "colormatrix.h"
+#include "floatimage.h"
+#include "integralimage.h"
+#include "pixeltraits.h"
+#include "simdkernels.h"
+#include "tilescheduler.h"
+#include "warpengine.h"
 
 #include <QPainter>
 #include <QtMath>
+#include <QVarLengthArray>
 #include <QVector>
 #include <algorithm>
+#include <climits>
 #include <QRandomGenerator>
 
-FilterApplyer::FilterApplyer()
-{
+namespace {
 
-}
+typedef TileScheduler::Tile Tile;
 
-QImage FilterApplyer::applyGrayscale(const QImage& src){
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 0; y < src.height(); ++y){
-        for(int x = 0; x < src.width(); ++x){
-            QColor color(src.pixel(x, y));
-            int gray = qGray(color.rgb());
-            dst.setPixel(x, y, qRgba(gray, gray, gray, color.alpha()));
+// 256-entry lookup table applied to the three color channels of every pixel. The
+// curve maps a channel value in 0..255 to a double, truncated and clamped here.
+struct ChannelTable{
+    uchar values[256];
+
+    template <typename Curve>
+    void fill(Curve f){
+        for(int v = 0; v < 256; ++v){
+            values[v] = uchar(qBound(0, int(f(v)), 255));
         }
     }
+};
 
-    return dst;
-}
+// The same curve sampled at every 16-bit value, for high bit depth images. Inputs
+// are scaled to 0..255 and results rounded rather than truncated.
+struct WideChannelTable{
+    QVector<quint16> values;
 
-QImage FilterApplyer::applyInvert(const QImage& src){
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 0; y < src.height(); ++y){
-        for(int x = 0; x < src.width(); ++x){
-            QColor color(src.pixel(x, y));
-            color.setRgb(255 - color.red(), 255 - color.green(), 255 - color.blue(), color.alpha());
-            dst.setPixel(x, y, color.rgba());
+    template <typename Curve>
+    void fill(Curve f){
+        values.resize(65536);
+        for(int v = 0; v < 65536; ++v){
+            values[v] = quint16(qBound(0, qRound(f(v / 257.0) * 257.0), 65535));
         }
     }
+};
 
-    return dst;
-}
+// Writable rows of a destination image that worker threads can share: the image
+// is detached once here instead of in every scanLine() call.
+struct Rows{
+    uchar* bits;
+    int stride;
 
-QImage FilterApplyer::applyBrightnessFilter(const QImage& src, int brightness){
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 0; y < src.height(); ++y){
-        for(int x = 0; x < src.width(); ++x){
-            QColor color(src.pixel(x, y));
-            int r = qBound(0, color.red() + brightness, 255);
-            int g = qBound(0, color.green() + brightness, 255);
-            int b = qBound(0, color.blue() + brightness, 255);
-            color.setRgb(r, g, b, color.alpha());
-            dst.setPixel(x, y, color.rgba());
-        }
+    explicit Rows(QImage& image)
+        : bits(image.bits()), stride(image.bytesPerLine())
+    {
     }
 
-    return dst;
-}
+    uchar* bytes(int y) const{
+        return bits + qptrdiff(y) * stride;
+    }
 
-QImage FilterApplyer::applyBlur(const QImage& src){
-    int width = src.width();
-    int height = src.height();
+    QRgb* line(int y) const{
+        return reinterpret_cast<QRgb*>(bytes(y));
+    }
+};
 
-    QImage dstImage = src;
+inline const QRgb* constLine(const QImage& image, int y){
+    return reinterpret_cast<const QRgb*>(image.constScanLine(y));
+}
 
-    static const double kernel[5][5] = {
-        {0.002969016737030329, 0.013306209891221683, 0.02193823125743577,  0.013306209891221683, 0.002969016737030329},
-        {0.013306209891221683, 0.05963429536484059,  0.09832033134846331,  0.05963429536484059,  0.013306209891221683},
-        {0.02193823125743577,  0.09832033134846331,  0.16209986390734045,  0.09832033134846331,  0.02193823125743577 },
-        {0.013306209891221683, 0.05963429536484059,  0.09832033134846331,  0.05963429536484059,  0.013306209891221683},
-        {0.002969016737030329, 0.013306209891221683, 0.02193823125743577,  0.013306209891221683, 0.002969016737030329}
-    };
-    int kernelRadius = 2;
-    if (width < (2 * kernelRadius + 1) || height < (2 * kernelRadius + 1)) {
-        qWarning("Image is smaller than the kernel size. Returning original image.");
-        return dstImage;
+// The neighbourhood filters work on 32-bit pixels; anything else is converted for the pass.
+QImage toWorkingFormat(const QImage& src){
+    const QImage::Format format = src.format();
+    if(format == QImage::Format_ARGB32 || format == QImage::Format_RGB32){
+        return src;
     }
+    return src.convertToFormat(QImage::Format_ARGB32);
+}
 
-    for (int y = kernelRadius; y < height - kernelRadius; ++y) {
-        for (int x = kernelRadius; x < width - kernelRadius; ++x) {
-            double sumR = 0.0, sumG = 0.0, sumB = 0.0, sumA = 0.0;
+// Runs rowOp(in, out, y, width) for every row of an image in the format described
+// by Traits, one row band per task. Rows of QRgb formats are passed through directly;
+// the others are unpacked into a scratch row and packed again. The result keeps the format.
+template <typename Traits, typename RowOp>
+QImage mapRowsAs(const QImage& src, const RowOp& rowOp){
+    const int width = src.width();
+    QImage dst(width, src.height(), src.format());
+    const Rows out(dst);
 
-            for (int j = -kernelRadius; j <= kernelRadius; ++j) {
-                for (int i = -kernelRadius; i <= kernelRadius; ++i) {
-                    QColor neighborPixelColor = src.pixelColor(x + i, y + j);
+    TileScheduler::forEachBand(src.size(), src.bytesPerLine(), 0, [&](const Tile& tile){
+        QVector<QRgb> in(Traits::IsQRgb ? 0 : width);
+        QVector<QRgb> result(Traits::IsQRgb ? 0 : width);
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            const uchar* source = src.constScanLine(y);
+            uchar* target = out.bytes(y);
+            if(Traits::IsQRgb){
+                rowOp(reinterpret_cast<const QRgb*>(source), reinterpret_cast<QRgb*>(target), y, width);
+                continue;
+            }
+            for(int x = 0; x < width; ++x){
+                in[x] = Traits::load(source + x * Traits::BytesPerPixel);
+            }
+            rowOp(in.constData(), result.data(), y, width);
+            for(int x = 0; x < width; ++x){
+                Traits::store(target + x * Traits::BytesPerPixel, result[x]);
+            }
+        }
+    });
 
-                    double kernelWeight = kernel[j + kernelRadius][i + kernelRadius];
+    return dst;
+}
 
-                    sumR += neighborPixelColor.red()   * kernelWeight;
-                    sumG += neighborPixelColor.green() * kernelWeight;
-                    sumB += neighborPixelColor.blue()  * kernelWeight;
+// Picks the mapRowsAs() instantiation for the source format; formats without
+// PixelTraits go through ARGB32.
+template <typename RowOp>
+QImage mapRows(const QImage& src, const RowOp& rowOp){
+    switch(src.format()){
+    case QImage::Format_ARGB32:
+        return mapRowsAs<PixelTraits<QImage::Format_ARGB32>>(src, rowOp);
+    case QImage::Format_RGB32:
+        return mapRowsAs<PixelTraits<QImage::Format_RGB32>>(src, rowOp);
+    case QImage::Format_ARGB32_Premultiplied:
+        return mapRowsAs<PixelTraits<QImage::Format_ARGB32_Premultiplied>>(src, rowOp);
+    case QImage::Format_RGB888:
+        return mapRowsAs<PixelTraits<QImage::Format_RGB888>>(src, rowOp);
+    case QImage::Format_Grayscale8:
+        return mapRowsAs<PixelTraits<QImage::Format_Grayscale8>>(src, rowOp);
+    default:
+        return mapRowsAs<PixelTraits<QImage::Format_ARGB32>>(src.convertToFormat(QImage::Format_ARGB32), rowOp)
+                .convertToFormat(src.format());
+    }
+}
 
-                    if (src.hasAlphaChannel()) {
-                        sumA += neighborPixelColor.alpha() * kernelWeight;
-                    }
+QImage mapChannels(const QImage& src, const ChannelTable& table){
+    // A gray pixel is its own single channel: map the bytes directly.
+    if(src.format() == QImage::Format_Grayscale8){
+        QImage dst(src.width(), src.height(), src.format());
+        const Rows out(dst);
+        TileScheduler::forEachBand(src.size(), src.bytesPerLine(), 0, [&](const Tile& tile){
+            for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+                const uchar* in = src.constScanLine(y);
+                uchar* line = out.bytes(y);
+                for(int x = 0; x < src.width(); ++x){
+                    line[x] = table.values[in[x]];
                 }
             }
+        });
+        return dst;
+    }
 
+    return mapRows(src, [&table](const QRgb* in, QRgb* out, int, int width){
+        SimdKernels::lookup(in, out, width, table.values);
+    });
+}
 
-            int finalR = qBound(0, static_cast<int>(std::round(sumR)), 255);
-            int finalG = qBound(0, static_cast<int>(std::round(sumG)), 255);
-            int finalB = qBound(0, static_cast<int>(std::round(sumB)), 255);
-            int finalA;
-
-            if (src.hasAlphaChannel()) {
-                finalA = qBound(0, static_cast<int>(std::round(sumA)), 255);
-                dstImage.setPixelColor(x, y, QColor(finalR, finalG, finalB, finalA));
-            } else {
-                dstImage.setPixelColor(x, y, QColor(finalR, finalG, finalB));
+// mapChannels() for high bit depth formats, on RGBA64 rows.
+QImage mapWideChannels(const QImage& src, const WideChannelTable& table){
+    const QImage in = (src.format() == QImage::Format_RGBA64) ? src : src.convertToFormat(QImage::Format_RGBA64);
+    QImage dst(in.width(), in.height(), in.format());
+    const Rows out(dst);
+    const quint16* values = table.values.constData();
+    TileScheduler::forEachBand(in.size(), in.bytesPerLine(), 0, [&](const Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            const quint16* line = reinterpret_cast<const quint16*>(in.constScanLine(y));
+            quint16* result = reinterpret_cast<quint16*>(out.bytes(y));
+            for(int i = 0; i < 4 * in.width(); i += 4){
+                result[i] = values[line[i]];
+                result[i + 1] = values[line[i + 1]];
+                result[i + 2] = values[line[i + 2]];
+                result[i + 3] = line[i + 3];
             }
         }
+    });
+    return dst.convertToFormat(src.format());
+}
+
+// Runs rowOp(planes, width) on every row of a high bit depth image, unpacked to
+// four float planes of one row and packed back in place; the result keeps the format.
+template <typename RowOp>
+QImage mapWideRows(const QImage& src, const RowOp& rowOp){
+    const QImage in = (src.format() == QImage::Format_RGBA64) ? src : src.convertToFormat(QImage::Format_RGBA64);
+    const int width = in.width();
+    QImage dst(width, in.height(), in.format());
+    const Rows out(dst);
+    TileScheduler::forEachBand(in.size(), in.bytesPerLine(), 0, [&](const Tile& tile){
+        QVector<float> scratch(4 * width);
+        float* const planes[4] = { scratch.data(), scratch.data() + width, scratch.data() + 2 * width, scratch.data() + 3 * width };
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            SimdKernels::unpackRgba64(reinterpret_cast<const quint16*>(in.constScanLine(y)), width, planes);
+            rowOp(planes, width);
+            SimdKernels::packRgba64(planes, width, reinterpret_cast<quint16*>(out.bytes(y)));
+        }
+    });
+    return dst.convertToFormat(src.format());
+}
+
+// Applies a tone curve over 0..255 to the color channels through the table that
+// matches the bit depth of src.
+template <typename Curve>
+QImage mapCurve(const QImage& src, Curve f){
+    if(FloatImage::isHighBitDepth(src.format())){
+        WideChannelTable table;
+        table.fill(f);
+        return mapWideChannels(src, table);
     }
+    ChannelTable table;
+    table.fill(f);
+    return mapChannels(src, table);
+}
 
-    return dstImage;
+// Whether fixedPoint() can hold matrix: coefficients of magnitude below 8, with room
+// for the row sum correction, and offsets that keep the kernel's 32-bit sums clear
+// of overflow.
+bool fitsFixedPoint(const ColorMatrix& matrix){
+    const double one = 1 << SimdKernels::ColorMatrixShift;
+    for(int row = 0; row < 4; ++row){
+        for(int column = 0; column < 4; ++column){
+            if(qAbs(matrix.at(row, column) * one) > 32765.0){
+                return false;
+            }
+        }
+        if(qAbs(matrix.at(row, ColorMatrix::Offset) * one) > 1e9){
+            return false;
+        }
+    }
+    return true;
 }
 
-QImage FilterApplyer::applySepia(const QImage& src){
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 0; y < src.height(); ++y){
-        for(int x = 0; x < src.width(); ++x){
-            QColor color(src.pixel(x, y));
-            int tr = 0.393 * color.red() + 0.769 * color.green() + 0.189 * color.blue();
-            int tg = 0.349 * color.red() + 0.686 * color.green() + 0.168 * color.blue();
-            int tb = 0.272 * color.red() + 0.534 * color.green() + 0.131 * color.blue();
-            color.setRgb(qBound(0, tr, 255), qBound(0, tg, 255), qBound(0, tb, 255), color.alpha());
-            dst.setPixel(x, y, color.rgba());
+// The color matrix kernel's result for one pixel, computed in double precision for
+// matrices that do not fit its fixed point: rounded down and clamped to 0..255.
+QRgb colorMatrixPixel(const ColorMatrix& matrix, QRgb pixel){
+    const double in[4] = { double(qRed(pixel)), double(qGreen(pixel)), double(qBlue(pixel)), double(qAlpha(pixel)) };
+    int out[4];
+    for(int row = 0; row < 4; ++row){
+        double value = matrix.at(row, ColorMatrix::Offset);
+        for(int column = 0; column < 4; ++column){
+            value += matrix.at(row, column) * in[column];
         }
+        // The epsilon keeps exact integers that picked up rounding error from flooring one lower.
+        out[row] = qFloor(qBound(0.0, value + 1e-9, 255.0));
     }
+    return qRgba(out[ColorMatrix::Red], out[ColorMatrix::Green], out[ColorMatrix::Blue], out[ColorMatrix::Alpha]);
+}
 
-    return dst;
+// Converts a color matrix to the fixed-point form of the SIMD kernel. Each row's
+// color coefficients are rounded so that their sum is exact: a row summing to one
+// keeps white white and grays gray.
+SimdKernels::FixedColorMatrix fixedPoint(const ColorMatrix& matrix){
+    // Kernel rows and columns are in QRgb byte order: blue, green, red, alpha.
+    const int channel[4] = { ColorMatrix::Blue, ColorMatrix::Green, ColorMatrix::Red, ColorMatrix::Alpha };
+    const double one = 1 << SimdKernels::ColorMatrixShift;
+
+    SimdKernels::FixedColorMatrix fixed;
+    for(int row = 0; row < 4; ++row){
+        const int r = channel[row];
+        int sum = 0;
+        double exactSum = 0.0;
+        int largest = 0;
+        for(int column = 0; column < 4; ++column){
+            const double value = matrix.at(r, channel[column]);
+            const int coefficient = qBound(-32768, qRound(value * one), 32767);
+            fixed.coefficients[row][column] = qint16(coefficient);
+            if(column < 3){
+                sum += coefficient;
+                exactSum += value;
+                if(qAbs(coefficient) > qAbs(int(fixed.coefficients[row][largest]))){
+                    largest = column;
+                }
+            }
+        }
+        const int correction = qRound(exactSum * one) - sum;
+        fixed.coefficients[row][largest] = qint16(qBound(-32768, fixed.coefficients[row][largest] + correction, 32767));
+        fixed.offsets[row] = qint32(qBound(-1e9, matrix.at(r, ColorMatrix::Offset) * one, 1e9));
+    }
+    return fixed;
 }
 
-QImage FilterApplyer::applyContrast(const QImage& src, double factor){
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 0; y < src.height(); ++y){
-        for(int x = 0; x < src.width(); ++x){
-            QColor color(src.pixel(x, y));
-            int r = qBound(0, int((color.red() - 128) * factor + 128),255);
-            int g = qBound(0, int((color.green() - 128) * factor + 128),255);
-            int b = qBound(0, int((color.blue() - 128) * factor + 128),255);
-            color.setRgb(r, g, b, color.alpha());
-            dst.setPixel(x, y, color.rgba());
+// A color matrix for float planes in 0..1: the offsets, in 0..255 units, are scaled down.
+struct FloatMatrix{
+    float values[20];
+
+    explicit FloatMatrix(const ColorMatrix& matrix){
+        for(int row = 0; row < 4; ++row){
+            for(int column = 0; column < 5; ++column){
+                const double scale = (column == ColorMatrix::Offset) ? 1.0 / 255.0 : 1.0;
+                values[5 * row + column] = float(matrix.at(row, column) * scale);
+            }
         }
     }
+};
 
-    return dst;
+// Fixed-point scale of the convolution weights: the taps of a kernel sum to exactly this.
+const int kWeightShift = SimdKernels::WeightShift;
+const int kWeightOne = 1 << kWeightShift;
+
+// Maps a coordinate outside [0, size) back into the image according to the border mode.
+// Mirror reflects around the edge pixel without repeating it.
+int borderIndex(int i, int size, FilterApplyer::BorderMode border){
+    if(i >= 0 && i < size){
+        return i;
+    }
+    if(border == FilterApplyer::BorderMode::Clamp || size == 1){
+        return qBound(0, i, size - 1);
+    }
+    const int period = 2 * size - 2;
+    i = qAbs(i) % period;
+    return (i < size) ? i : period - i;
 }
 
-QImage FilterApplyer::applySaturation(const QImage& src, bool saturation){
-    double saturationFactor = (saturation ? 1.3 : 0.7);
-    QImage dst(src.width(), src.height(), src.format());
+// Sampled 1-D Gaussian with 2 * radius + 1 taps, normalized to sum to 1.
+QVector<double> gaussianKernel(double sigma, int radius){
+    QVector<double> kernel(2 * radius + 1);
+    double total = 0.0;
+    for(int k = -radius; k <= radius; ++k){
+        kernel[k + radius] = qExp(-(k * k) / (2.0 * sigma * sigma));
+        total += kernel[k + radius];
+    }
+    for(double& value : kernel){
+        value /= total;
+    }
+    return kernel;
+}
+
+// gaussianKernel() in fixed point.
+QVector<int> gaussianWeights(double sigma, int radius){
+    const QVector<double> exact = gaussianKernel(sigma, radius);
+
+    QVector<int> weights(2 * radius + 1);
+    int sum = 0;
+    for(int k = 0; k < weights.size(); ++k){
+        weights[k] = qRound(exact[k] * kWeightOne);
+        sum += weights[k];
+    }
+    // Put the rounding error on the center tap so flat areas stay exactly flat.
+    weights[radius] += kWeightOne - sum;
 
-    for(int y = 0; y < src.height(); ++y){
-        for(int x = 0; x < src.width(); ++x){
-            QColor color = QColor(src.pixel(x, y));
-            double p = sqrt(color.red() * color.red() * 0.299 +
-                            color.green() * color.green() * 0.587 +
-                            color.blue() * color.blue() * 0.114);
-            int r = qBound(0, int(p + (color.red() - p) * saturationFactor), 255);
-            int g = qBound(0, int(p + (color.green() - p) * saturationFactor), 255);
-            int b = qBound(0, int(p + (color.blue() - p) * saturationFactor), 255);
-            dst.setPixel(x, y, qRgb(r, g, b));
+    return weights;
+}
+
+// Horizontal pass over the rows of a tile: convolves them with the weights and
+// stores the four channels as 8.7 fixed point, interleaved in QRgb byte order.
+void convolveRows(const QImage& src, const QVector<int>& weights, FilterApplyer::BorderMode border,
+                  quint16* out, const QRect& rows){
+    const int width = src.width();
+    const int taps = weights.size();
+    const int radius = taps / 2;
+
+    QVector<int> columnIndex(width + 2 * radius);
+    for(int i = 0; i < columnIndex.size(); ++i){
+        columnIndex[i] = borderIndex(i - radius, width, border);
+    }
+
+    QVector<QRgb> padded(columnIndex.size());
+    for(int y = rows.top(); y <= rows.bottom(); ++y){
+        const QRgb* line = constLine(src, y);
+        for(int i = 0; i < padded.size(); ++i){
+            padded[i] = line[columnIndex[i]];
         }
+        SimdKernels::convolveRow(padded.constData(), width, weights.constData(), taps, out + qptrdiff(y) * width * 4);
     }
+}
 
-    return dst;
+// Vertical pass over the rows of a tile: convolves the 8.7 rows produced by
+// convolveRows() and writes the rounded 8-bit result.
+void convolveColumns(const quint16* in, int width, int height, const QVector<int>& weights,
+                     FilterApplyer::BorderMode border, const Rows& dst, const QRect& rows){
+    const int rowLength = width * 4;
+    const int taps = weights.size();
+    const int radius = taps / 2;
+
+    QVarLengthArray<const quint16*, 64> window(taps);
+    for(int y = rows.top(); y <= rows.bottom(); ++y){
+        for(int k = 0; k < taps; ++k){
+            window[k] = in + qptrdiff(borderIndex(y - radius + k, height, border)) * rowLength;
+        }
+        SimdKernels::convolveColumn(window.constData(), weights.constData(), taps, rowLength, dst.bytes(y));
+    }
 }
 
-QImage FilterApplyer::applyHue(const QImage& src, int hueShift){
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 0; y < src.height(); ++y){
-        for(int x = 0; x < src.width(); ++x){
-            QColor color(src.pixel(x, y));
-            int h, s, v;
-            color.getHsv(&h, &s, &v);
-            h = (h + hueShift) % 360;
-            color.setHsv(h, s, v);
-            dst.setPixel(x, y, color.rgba());
+// Divides a window sum by a fixed count with one multiply: (sum * scale) >> 32, rounded.
+inline quint32 divideByScale(quint32 sum, quint64 scale){
+    return quint32((quint64(sum) * scale + (quint64(1) << 31)) >> 32);
+}
+
+inline quint64 reciprocalScale(quint32 count){
+    return ((quint64(1) << 32) + count / 2) / count;
+}
+
+// Running-sum box pass along the rows of a tile: every output pixel is the mean of
+// the 2 * radius + 1 pixels around it, edges clamped. Cost does not depend on radius.
+void boxBlurRows(const QImage& src, const Rows& dst, int radius, const QRect& rows){
+    const int width = src.width();
+    const quint64 scale = reciprocalScale(quint32(2 * radius + 1));
+
+    for(int y = rows.top(); y <= rows.bottom(); ++y){
+        const QRgb* in = constLine(src, y);
+        QRgb* out = dst.line(y);
+
+        quint32 sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+        for(int k = -radius; k <= radius; ++k){
+            const QRgb p = in[qBound(0, k, width - 1)];
+            sum0 += p & 0xff;
+            sum1 += (p >> 8) & 0xff;
+            sum2 += (p >> 16) & 0xff;
+            sum3 += p >> 24;
+        }
+
+        for(int x = 0; x < width; ++x){
+            out[x] = divideByScale(sum0, scale) | (divideByScale(sum1, scale) << 8)
+                   | (divideByScale(sum2, scale) << 16) | (divideByScale(sum3, scale) << 24);
+
+            const QRgb added = in[qMin(x + radius + 1, width - 1)];
+            const QRgb removed = in[qMax(x - radius, 0)];
+            sum0 += (added & 0xff) - (removed & 0xff);
+            sum1 += ((added >> 8) & 0xff) - ((removed >> 8) & 0xff);
+            sum2 += ((added >> 16) & 0xff) - ((removed >> 16) & 0xff);
+            sum3 += (added >> 24) - (removed >> 24);
         }
     }
-    return dst;
 }
 
-QImage FilterApplyer::applySolarize(const QImage& src, int threshold){
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 0; y < src.height(); ++y){
-        for(int x = 0; x < src.width(); ++x){
-            QColor color = QColor(src.pixel(x, y));
-            int r = (color.red() > threshold) ? 255 - color.red() : color.red();
-            int g = (color.green() > threshold) ? 255 - color.green() : color.green();
-            int b = (color.blue() > threshold) ? 255 - color.blue() : color.blue();
-            dst.setPixel(x, y, qRgba(r, g, b, color.alpha()));
+// Running-sum box pass down the columns of a full-height strip. The column sums of
+// the strip are kept in one accumulator so the strip is still read row by row.
+void boxBlurColumns(const QImage& src, const Rows& dst, int radius, const QRect& strip){
+    const int height = src.height();
+    const int first = 4 * strip.left();
+    const int count = 4 * strip.width();
+    const quint64 scale = reciprocalScale(quint32(2 * radius + 1));
+
+    QVector<quint32> accumulator(count, 0);
+    quint32* acc = accumulator.data();
+    for(int k = -radius; k <= radius; ++k){
+        const uchar* line = src.constScanLine(qBound(0, k, height - 1)) + first;
+        for(int i = 0; i < count; ++i){
+            acc[i] += line[i];
+        }
+    }
+
+    for(int y = 0; y < height; ++y){
+        uchar* out = dst.bytes(y) + first;
+        for(int i = 0; i < count; ++i){
+            out[i] = uchar(divideByScale(acc[i], scale));
+        }
+
+        const uchar* added = src.constScanLine(qMin(y + radius + 1, height - 1)) + first;
+        const uchar* removed = src.constScanLine(qMax(y - radius, 0)) + first;
+        for(int i = 0; i < count; ++i){
+            acc[i] += added[i] - removed[i];
         }
     }
-    return dst;
 }
 
-QImage FilterApplyer::applyPosterize(const QImage& src, int levels){
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 0; y < src.height(); ++y){
-        for(int x = 0; x < src.width(); ++x){
-            QColor color = QColor(src.pixel(x, y));
-            int r = (color.red() / (256 / levels)) * (256 / levels);
-            int g = (color.green() / (256 / levels)) * (256 / levels);
-            int b = (color.blue() / (256 / levels)) * (256 / levels);
-            dst.setPixel(x, y, qRgba(r, g, b, color.alpha()));
+// Radii of `passes` successive box filters whose combined variance matches a
+// Gaussian of the given sigma (box widths w and w + 2, split to fit).
+QVector<int> boxRadiiForGaussian(double sigma, int passes){
+    const double idealWidth = qSqrt(12.0 * sigma * sigma / passes + 1.0);
+    int lower = qFloor(idealWidth);
+    if(lower % 2 == 0){
+        --lower;
+    }
+    const int upper = lower + 2;
+
+    const double idealCount = (12.0 * sigma * sigma - passes * lower * lower - 4.0 * passes * lower - 3.0 * passes)
+                            / (-4.0 * lower - 4.0);
+    const int lowerCount = qRound(idealCount);
+
+    QVector<int> radii(passes);
+    for(int i = 0; i < passes; ++i){
+        radii[i] = ((i < lowerCount ? lower : upper) - 1) / 2;
+    }
+    return radii;
+}
+
+// Sliding-histogram median (Perreault-Hebert) over one tile of output pixels.
+// Every column keeps a histogram of its 2 * radius + 1 rows for each color channel,
+// with a 16-bucket coarse level over its 256 fine bins. Moving one pixel right adds
+// the entering column to the coarse kernel histogram and subtracts the leaving one;
+// the 16 fine bins of a bucket are brought up to date only when the median search
+// lands in that bucket, so each pixel costs a constant number of bin updates. Edges
+// are clamped and the source alpha is copied through. The counts are 16-bit, so
+// radius must be <= 127.
+void medianFilterTile(const QImage& src, const Rows& dst, int radius, const QRect& rect){
+    const int bins = 256;
+    const int coarseBins = 16;
+    const int histogramSize = 3 * bins;
+    const int coarseSize = 3 * coarseBins;
+
+    const int width = src.width();
+    const int height = src.height();
+    const int window = 2 * radius + 1;
+    const int half = (window * window) / 2;
+
+    // Column histograms cover the tile plus its halo columns.
+    const int firstColumn = rect.left() - radius;
+    const int columns = rect.width() + 2 * radius;
+    QVector<quint16> columnFine(columns * histogramSize, 0);
+    QVector<quint16> columnCoarse(columns * coarseSize, 0);
+
+    auto updateColumns = [&](int row, int delta){
+        const QRgb* line = constLine(src, qBound(0, row, height - 1));
+        for(int i = 0; i < columns; ++i){
+            const QRgb p = line[qBound(0, firstColumn + i, width - 1)];
+            quint16* fine = columnFine.data() + i * histogramSize;
+            quint16* coarse = columnCoarse.data() + i * coarseSize;
+            const int values[3] = { qBlue(p), qGreen(p), qRed(p) };
+            for(int c = 0; c < 3; ++c){
+                fine[c * bins + values[c]] += delta;
+                coarse[c * coarseBins + (values[c] >> 4)] += delta;
+            }
+        }
+    };
+
+    QVector<quint16> kernelFine(histogramSize);
+    QVector<quint16> kernelCoarse(coarseSize);
+    // The output column each fine bucket of the kernel was last brought up to date for.
+    QVector<int> fineColumn(coarseSize);
+    const int stale = INT_MIN;
+
+    auto updateKernel = [&](int column, int delta){
+        const quint16* coarse = columnCoarse.constData() + (column - firstColumn) * coarseSize;
+        quint16* kCoarse = kernelCoarse.data();
+        if(delta > 0){
+            for(int i = 0; i < coarseSize; ++i) kCoarse[i] += coarse[i];
+        } else {
+            for(int i = 0; i < coarseSize; ++i) kCoarse[i] -= coarse[i];
+        }
+    };
+
+    // Fine bins of one bucket for the window centered on column x, catching up
+    // column by column, or summed afresh when that would touch more columns.
+    auto updateFine = [&](int channel, int bucket, int x){
+        int& at = fineColumn[channel * coarseBins + bucket];
+        if(at == x){
+            return;
+        }
+        const int offset = channel * bins + bucket * coarseBins;
+        quint16* kFine = kernelFine.data() + offset;
+        const auto segment = [&](int column){
+            return columnFine.constData() + (column - firstColumn) * histogramSize + offset;
+        };
+        if(at == stale || 2 * (x - at) >= window){
+            std::fill(kFine, kFine + coarseBins, quint16(0));
+            for(int column = x - radius; column <= x + radius; ++column){
+                const quint16* fine = segment(column);
+                for(int i = 0; i < coarseBins; ++i) kFine[i] += fine[i];
+            }
+        } else {
+            for(int step = at + 1; step <= x; ++step){
+                const quint16* entering = segment(step + radius);
+                const quint16* leaving = segment(step - radius - 1);
+                for(int i = 0; i < coarseBins; ++i) kFine[i] += entering[i] - leaving[i];
+            }
+        }
+        at = x;
+    };
+
+    auto median = [&](int channel, int x){
+        const quint16* coarse = kernelCoarse.constData() + channel * coarseBins;
+        int count = 0;
+        int bucket = 0;
+        while(count + coarse[bucket] <= half){
+            count += coarse[bucket];
+            ++bucket;
+        }
+        updateFine(channel, bucket, x);
+        const quint16* fine = kernelFine.constData() + channel * bins;
+        int bin = bucket * coarseBins;
+        while(count + fine[bin] <= half){
+            count += fine[bin];
+            ++bin;
         }
+        return bin;
+    };
+
+    for(int k = -radius; k <= radius; ++k){
+        updateColumns(rect.top() + k, 1);
     }
+
+    for(int y = rect.top(); y <= rect.bottom(); ++y){
+        kernelCoarse.fill(0);
+        fineColumn.fill(stale);
+        for(int k = -radius; k <= radius; ++k){
+            updateKernel(rect.left() + k, 1);
+        }
+
+        const QRgb* in = constLine(src, y);
+        QRgb* out = dst.line(y);
+        for(int x = rect.left(); x <= rect.right(); ++x){
+            out[x] = (in[x] & 0xff000000u) | (quint32(median(2, x)) << 16) | (quint32(median(1, x)) << 8) | quint32(median(0, x));
+            if(x < rect.right()){
+                updateKernel(x + radius + 1, 1);
+                updateKernel(x - radius, -1);
+            }
+        }
+
+        if(y < rect.bottom()){
+            updateColumns(y + radius + 1, 1);
+            updateColumns(y - radius, -1);
+        }
+    }
+}
+
+}
+
+FilterApplyer::FilterApplyer()
+{
+
+}
+
+QImage FilterApplyer::applyGrayscale(const QImage& src){
+    return applyColorMatrix(src, ColorMatrix::grayscale());
+}
+
+QImage FilterApplyer::applyInvert(const QImage& src){
+    return mapCurve(src, [](double v){ return 255.0 - v; });
+}
+
+QImage FilterApplyer::applyBrightnessFilter(const QImage& src, int brightness){
+    return mapCurve(src, [brightness](double v){ return v + brightness; });
+}
+
+QImage FilterApplyer::applyBlur(const QImage& src, double sigma, BorderMode border){
+    if(src.isNull() || sigma <= 0.0){
+        return src;
+    }
+    if(FloatImage::isHighBitDepth(src.format())){
+        return applyBlur(FloatImage(src), sigma, border).toImage(src.format());
+    }
+
+    const int radius = qCeil(3.0 * sigma);
+    const QVector<int> weights = gaussianWeights(sigma, radius);
+    const QImage in = toWorkingFormat(src);
+    const int width = in.width();
+    const int height = in.height();
+
+    // The vertical pass of a band reads `radius` rows of horizontal results above and
+    // below it, so the horizontal pass finishes for the whole image first.
+    QVector<quint16> horizontal(width * height * 4);
+    quint16* horizontalData = horizontal.data();
+    TileScheduler::forEachBand(in.size(), in.bytesPerLine(), 0, [&](const Tile& tile){
+        convolveRows(in, weights, border, horizontalData, tile.rect);
+    });
+
+    QImage dst(width, height, in.format());
+    const Rows out(dst);
+    TileScheduler::forEachBand(in.size(), in.bytesPerLine(), radius, [&](const Tile& tile){
+        convolveColumns(horizontalData, width, height, weights, border, out, tile.rect);
+    });
+
+    return dst.convertToFormat(src.format());
+}
+
+FloatImage FilterApplyer::applyBlur(const FloatImage& src, double sigma, BorderMode border){
+    if(src.isNull() || sigma <= 0.0){
+        return src;
+    }
+
+    const int radius = qCeil(3.0 * sigma);
+    const int taps = 2 * radius + 1;
+    const QVector<double> kernel = gaussianKernel(sigma, radius);
+    QVector<float> weights(taps);
+    for(int k = 0; k < taps; ++k){
+        weights[k] = float(kernel[k]);
+    }
+    const int width = src.width();
+    const int height = src.height();
+    const int bytesPerLine = 4 * width * int(sizeof(float));
+
+    QVector<int> columnIndex(width + 2 * radius);
+    for(int i = 0; i < columnIndex.size(); ++i){
+        columnIndex[i] = borderIndex(i - radius, width, border);
+    }
+
+    // Same two passes as the 8-bit blur, plane by plane; the horizontal one runs the
+    // column kernel over one padded row at successive offsets.
+    FloatImage horizontal(width, height);
+    TileScheduler::forEachBand(src.size(), bytesPerLine, 0, [&](const Tile& tile){
+        QVector<float> padded(columnIndex.size());
+        QVarLengthArray<const float*, 64> window(taps);
+        for(int k = 0; k < taps; ++k){
+            window[k] = padded.constData() + k;
+        }
+        for(int c = FloatImage::Red; c <= FloatImage::Alpha; ++c){
+            const FloatImage::Channel channel = FloatImage::Channel(c);
+            for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+                const float* line = src.constLine(channel, y);
+                for(int i = 0; i < padded.size(); ++i){
+                    padded[i] = line[columnIndex[i]];
+                }
+                SimdKernels::convolveFloat(window.constData(), weights.constData(), taps, width, horizontal.line(channel, y));
+            }
+        }
+    });
+
+    FloatImage dst(width, height);
+    TileScheduler::forEachBand(src.size(), bytesPerLine, radius, [&](const Tile& tile){
+        QVarLengthArray<const float*, 64> window(taps);
+        for(int c = FloatImage::Red; c <= FloatImage::Alpha; ++c){
+            const FloatImage::Channel channel = FloatImage::Channel(c);
+            for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+                for(int k = 0; k < taps; ++k){
+                    window[k] = horizontal.constLine(channel, borderIndex(y - radius + k, height, border));
+                }
+                SimdKernels::convolveFloat(window.constData(), weights.constData(), taps, width, dst.line(channel, y));
+            }
+        }
+    });
+
     return dst;
 }
 
-QImage FilterApplyer::applyPixelate(const QImage& src, int blockSize){
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 0; y < src.height() - blockSize; ++y){
-        for(int x = 0; x < src.width() - blockSize; ++x){
-            QColor color = QColor(src.pixel(x, y));
-            for(int dy = 0; dy < blockSize; ++dy){
-                for(int dx = 0; dx < blockSize; ++dx){
-                    if(x + dx < src.width() && y + dy < src.height()){
-                        dst.setPixel(x + dx, y + dy, color.rgba());
-                    }
+QImage FilterApplyer::applyBoxBlur(const QImage& src, int radius){
+    if(src.isNull() || radius <= 0){
+        return src;
+    }
+    return applyBoxBlur(IntegralImage(src), radius);
+}
+
+QImage FilterApplyer::applyBoxBlur(const IntegralImage& table, int radius){
+    if(table.isNull()){
+        return QImage();
+    }
+    const int width = table.width();
+    const int height = table.height();
+    QImage dst(width, height, QImage::Format_ARGB32);
+    const Rows out(dst);
+
+    const int stride = table.stride();
+    TileScheduler::forEachBand(dst.size(), dst.bytesPerLine(), radius, [&](const Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            const int top = qMax(y - radius, 0);
+            const int bottom = qMin(y + radius + 1, height);
+            const quint32* topRow = table.constData() + qptrdiff(top) * stride;
+            const quint32* bottomRow = table.constData() + qptrdiff(bottom) * stride;
+
+            QRgb* line = out.line(y);
+            for(int x = 0; x < width; ++x){
+                const int left = 4 * qMax(x - radius, 0);
+                const int right = 4 * qMin(x + radius + 1, width);
+                const quint32 area = quint32((right - left) / 4) * quint32(bottom - top);
+                const quint64 scale = reciprocalScale(area);
+
+                QRgb p = 0;
+                for(int c = 0; c < 4; ++c){
+                    const quint32 sum = bottomRow[right + c] - bottomRow[left + c] - topRow[right + c] + topRow[left + c];
+                    p |= divideByScale(sum, scale) << (8 * c);
                 }
+                line[x] = p;
             }
         }
+    });
+
+    return dst.convertToFormat(table.format());
+}
+
+QImage FilterApplyer::applyFastGaussianBlur(const QImage& src, double sigma){
+    if(src.isNull() || sigma <= 0.0){
+        return src;
     }
-    return dst;
+
+    QImage current = toWorkingFormat(src);
+    QImage scratch(current.width(), current.height(), current.format());
+    const Rows scratchRows(scratch);
+    const QVector<int> radii = boxRadiiForGaussian(sigma, 3);
+    for(int radius : radii){
+        if(radius <= 0){
+            continue;
+        }
+        QImage next(current.width(), current.height(), current.format());
+        const Rows nextRows(next);
+        TileScheduler::forEachBand(current.size(), current.bytesPerLine(), 0, [&](const Tile& tile){
+            boxBlurRows(current, scratchRows, radius, tile.rect);
+        });
+        TileScheduler::forEachStrip(current.size(), 0, [&](const Tile& tile){
+            boxBlurColumns(scratch, nextRows, radius, tile.rect);
+        });
+        current = next;
+    }
+
+    return current.convertToFormat(src.format());
 }
 
-QImage FilterApplyer::applyVignete(const QImage& src){
-    int centerX = src.width() / 2;
-    int centerY = src.height() / 2;
-    int maxDistance = qMax(centerX, centerY);
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 0; y < src.height(); ++y){
-        for(int x = 0; x < src.width(); ++x){
-            QColor color = QColor(src.pixel(x, y));
-            int dist = qSqrt(qPow(x - centerX, 2) + qPow(y - centerY, 2));
-            double factor = 1.0 - (double(dist) / maxDistance) * 0.6;
-            color.setRed(qBound(0, int(color.red() * factor), 255));
-            color.setGreen(qBound(0, int(color.green() * factor), 255));
-            color.setBlue(qBound(0, int(color.blue() * factor), 255));
-            dst.setPixel(x, y, color.rgba());
+QImage FilterApplyer::applySepia(const QImage& src){
+    return applyColorMatrix(src, ColorMatrix::sepia());
+}
+
+QImage FilterApplyer::applyContrast(const QImage& src, double factor){
+    return mapCurve(src, [factor](double v){ return (v - 128) * factor + 128; });
+}
+
+QImage FilterApplyer::applySaturation(const QImage& src, bool saturation){
+    return applyColorMatrix(src, ColorMatrix::saturation(saturation ? 1.3 : 0.7));
+}
+
+QImage FilterApplyer::applyHue(const QImage& src, int hueShift){
+    return applyColorMatrix(src, ColorMatrix::hueRotation(hueShift));
+}
+
+QImage FilterApplyer::applyColorMatrix(const QImage& src, const ColorMatrix& matrix){
+    if(matrix.isIdentity()){
+        return src;
+    }
+    if(FloatImage::isHighBitDepth(src.format())){
+        const FloatMatrix coefficients(matrix);
+        return mapWideRows(src, [&coefficients](float* const* planes, int width){
+            SimdKernels::colorMatrixFloat(planes, planes, width, coefficients.values);
+        });
+    }
+    if(!fitsFixedPoint(matrix)){
+        // E.g. a contrast of 8 or more, or several strong steps fused into one.
+        return mapRows(src, [&matrix](const QRgb* in, QRgb* out, int, int width){
+            for(int x = 0; x < width; ++x){
+                out[x] = colorMatrixPixel(matrix, in[x]);
+            }
+        });
+    }
+    const SimdKernels::FixedColorMatrix fixed = fixedPoint(matrix);
+    return mapRows(src, [&fixed](const QRgb* in, QRgb* out, int, int width){
+        SimdKernels::colorMatrix(in, out, width, fixed);
+    });
+}
+
+QImage FilterApplyer::applyColorMatrices(const QImage& src, const QVector<ColorMatrix>& matrices){
+    // A run is applied as soon as its output can leave 0..255: separate passes clamp
+    // there, so the next matrix must see the clamped values.
+    QImage current = src;
+    ColorMatrix run;
+    for(const ColorMatrix& matrix : matrices){
+        run = run.then(matrix);
+        if(!run.staysInRange()){
+            current = applyColorMatrix(current, run);
+            run = ColorMatrix();
         }
     }
+    return applyColorMatrix(current, run);
+}
+
+FloatImage FilterApplyer::applyColorMatrix(const FloatImage& src, const ColorMatrix& matrix){
+    if(src.isNull() || matrix.isIdentity()){
+        return src;
+    }
 
+    const FloatMatrix coefficients(matrix);
+    FloatImage dst(src.width(), src.height());
+    TileScheduler::forEachBand(src.size(), 4 * src.width() * int(sizeof(float)), 0, [&](const Tile& tile){
+        const int top = tile.rect.top();
+        const float* const in[4] = { src.constLine(FloatImage::Red, top), src.constLine(FloatImage::Green, top),
+                                     src.constLine(FloatImage::Blue, top), src.constLine(FloatImage::Alpha, top) };
+        float* const out[4] = { dst.line(FloatImage::Red, top), dst.line(FloatImage::Green, top),
+                                dst.line(FloatImage::Blue, top), dst.line(FloatImage::Alpha, top) };
+        SimdKernels::colorMatrixFloat(in, out, tile.rect.height() * src.width(), coefficients.values);
+    });
     return dst;
 }
-void FilterApplyer::convolveDoubleKernel(const QImage& inputImg, QImage& outputImg){
-    double kernel[7][7] = {
-        {0, 0, 0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0, 0, 0},
-        {0.143, 0.143, 0.143, 0.143, 0.143, 0.143, 0.143},
-        {0, 0, 0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0, 0, 0},
-    };
-
-    int imgWidth = inputImg.width();
-    int imgHeight = inputImg.height();
 
-    int kernelHeight = 7;
-    int kernelWidth = 7;
-    int kh_half = kernelHeight / 2;
-    int kw_half = kernelWidth / 2;
+QImage FilterApplyer::applySolarize(const QImage& src, int threshold){
+    return mapCurve(src, [threshold](double v){ return (v > threshold) ? 255.0 - v : v; });
+}
 
-    outputImg = inputImg.copy();
-    for (int y = kh_half; y < imgHeight - kh_half; ++y) {
-        for (int x = kw_half; x < imgWidth - kw_half; ++x) {
-            double sumR = 0.0, sumG = 0.0, sumB = 0.0;
+QImage FilterApplyer::applyPosterize(const QImage& src, int levels){
+    const int step = 256 / qBound(1, levels, 256);
+    return mapCurve(src, [step](double v){ return qFloor(v / step) * double(step); });
+}
 
-            for (int j_k = 0; j_k < kernelHeight; ++j_k) { // kernel y
-                for (int i_k = 0; i_k < kernelWidth; ++i_k) { // kernel x
-                    // Image pixel coordinates
-                    int ix = x - kw_half + i_k;
-                    int iy = y - kh_half + j_k;
+QImage FilterApplyer::applyPixelate(const QImage& src, int blockSize){
+    if(src.isNull() || blockSize <= 1){
+        return src;
+    }
+    return applyPixelate(IntegralImage(src), blockSize);
+}
 
-                    QColor currentPixelColor(inputImg.pixel(ix, iy));
-                    double weight = kernel[j_k][i_k];
+QImage FilterApplyer::applyPixelate(const IntegralImage& table, int blockSize){
+    if(table.isNull()){
+        return QImage();
+    }
+    blockSize = qMax(1, blockSize);
+    QImage dst(table.width(), table.height(), QImage::Format_ARGB32);
+    const Rows out(dst);
 
-                    sumR += currentPixelColor.red() * weight;
-                    sumG += currentPixelColor.green() * weight;
-                    sumB += currentPixelColor.blue() * weight;
+    TileScheduler::forEachBand(dst.size(), dst.bytesPerLine(), 0, [&](const Tile& tile){
+        for(int top = tile.rect.top(); top <= tile.rect.bottom(); top += blockSize){
+            const int rows = qMin(blockSize, table.height() - top);
+            for(int left = 0; left < table.width(); left += blockSize){
+                const int columns = qMin(blockSize, table.width() - left);
+                const QRgb color = table.mean(QRect(left, top, columns, rows));
+                for(int y = top; y < top + rows; ++y){
+                    QRgb* line = out.line(y) + left;
+                    std::fill(line, line + columns, color);
                 }
             }
-            QColor originalCenterColor(inputImg.pixel(x, y));
-            outputImg.setPixel(x, y, qRgba(
-                qBound(0, static_cast<int>(std::round(sumR)), 255),
-                qBound(0, static_cast<int>(std::round(sumG)), 255),
-                qBound(0, static_cast<int>(std::round(sumB)), 255),
-                originalCenterColor.alpha()
-            ));
         }
+    }, blockSize);
+
+    return dst.convertToFormat(table.format());
+}
+
+QImage FilterApplyer::applyVignete(const QImage& src){
+    // The distances from the center are cached per image size; the falloff is a
+    // table over those whole-pixel distances.
+    const QSharedPointer<const RadialTable> radial = WarpEngine::radialTable(src.size());
+    const int centerX = radial->center().x();
+    const int maxDistance = qMax(1, qMax(centerX, radial->center().y()));
+    QVector<double> factors(radial->maxDistance() + 1);
+    for(int dist = 0; dist < factors.size(); ++dist){
+        factors[dist] = 1.0 - (double(dist) / maxDistance) * 0.6;
     }
+    return mapRows(src, [=](const QRgb* in, QRgb* out, int y, int width){
+        const quint16* distances = radial->distances(y);
+        for(int x = 0; x < width; ++x){
+            const QRgb p = in[x];
+            const double factor = factors[distances[qAbs(x - centerX)]];
+            out[x] = qRgba(qBound(0, int(qRed(p) * factor), 255),
+                           qBound(0, int(qGreen(p) * factor), 255),
+                           qBound(0, int(qBlue(p) * factor), 255),
+                           qAlpha(p));
+        }
+    });
+}
+
+void FilterApplyer::convolveDoubleKernel(const QImage& inputImg, QImage& outputImg){
+    // Only the middle row of the 7x7 kernel is non-zero: a horizontal 7-tap mean.
+    const double weight = 0.143;
+    const int kw_half = 3;
+    const int kh_half = 3;
+
+    const QImage in = toWorkingFormat(inputImg);
+    const int imgWidth = in.width();
+    const int imgHeight = in.height();
+
+    outputImg = in.copy();
+    const Rows out(outputImg);
+    TileScheduler::forEachBand(in.size(), in.bytesPerLine(), 0, [&](const Tile& tile){
+        const int first = qMax(tile.rect.top(), kh_half);
+        const int last = qMin(tile.rect.bottom(), imgHeight - kh_half - 1);
+        for(int y = first; y <= last; ++y){
+            const QRgb* line = constLine(in, y);
+            QRgb* outLine = out.line(y);
+            for(int x = kw_half; x < imgWidth - kw_half; ++x){
+                double sumR = 0.0, sumG = 0.0, sumB = 0.0;
+                for(int i = -kw_half; i <= kw_half; ++i){
+                    const QRgb p = line[x + i];
+                    sumR += qRed(p) * weight;
+                    sumG += qGreen(p) * weight;
+                    sumB += qBlue(p) * weight;
+                }
+                outLine[x] = qRgba(qBound(0, static_cast<int>(std::round(sumR)), 255),
+                                   qBound(0, static_cast<int>(std::round(sumG)), 255),
+                                   qBound(0, static_cast<int>(std::round(sumB)), 255),
+                                   qAlpha(line[x]));
+            }
+        }
+    });
 }
 
 QImage FilterApplyer::applyDeBlur(const QImage& src){
@@ -299,106 +962,73 @@ QImage FilterApplyer::applyDeBlur(const QImage& src){
 //    };
     int beta = 1;
 
-    QImage currentEstimate = src.copy();
-    QImage reblurredEstimate(src.width(), src.height(), src.format());
+    const QImage original = toWorkingFormat(src);
+    QImage currentEstimate = original;
+    QImage reblurredEstimate;
 
     for(int i = 0; i < iterations; ++i){
         convolveDoubleKernel(currentEstimate, reblurredEstimate);
 
-        QImage nextEstimate = currentEstimate.copy();
-        for(int y = 0; y < src.height(); ++y){
-            for(int x = 0; x < src.width(); ++x){
-                QColor originalBlurredPixel(src.pixel(x, y));
-                QColor currentEstimatePixel(currentEstimate.pixel(x, y));
-                QColor reblurredCurrentPixel(reblurredEstimate.pixel(x, y));
-
-                double diffR = originalBlurredPixel.red()   - reblurredCurrentPixel.red();
-                double diffG = originalBlurredPixel.green() - reblurredCurrentPixel.green();
-                double diffB = originalBlurredPixel.blue()  - reblurredCurrentPixel.blue();
-
-                double newR = currentEstimatePixel.red()   + beta * diffR;
-                double newG = currentEstimatePixel.green() + beta * diffG;
-                double newB = currentEstimatePixel.blue()  + beta * diffB;
-
-                nextEstimate.setPixel(x, y, qRgba(
-                    qBound(0, static_cast<int>(std::round(newR)), 255),
-                    qBound(0, static_cast<int>(std::round(newG)), 255),
-                    qBound(0, static_cast<int>(std::round(newB)), 255),
-                    originalBlurredPixel.alpha()
-                ));
+        QImage nextEstimate(original.width(), original.height(), original.format());
+        const Rows next(nextEstimate);
+        TileScheduler::forEachBand(original.size(), original.bytesPerLine(), 0, [&](const Tile& tile){
+            for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+                const QRgb* originalLine = constLine(original, y);
+                const QRgb* currentLine = constLine(currentEstimate, y);
+                const QRgb* reblurredLine = constLine(reblurredEstimate, y);
+                QRgb* nextLine = next.line(y);
+                for(int x = 0; x < original.width(); ++x){
+                    const QRgb o = originalLine[x];
+                    const QRgb c = currentLine[x];
+                    const QRgb r = reblurredLine[x];
+                    const int newR = qRed(c) + beta * (qRed(o) - qRed(r));
+                    const int newG = qGreen(c) + beta * (qGreen(o) - qGreen(r));
+                    const int newB = qBlue(c) + beta * (qBlue(o) - qBlue(r));
+                    nextLine[x] = qRgba(qBound(0, newR, 255), qBound(0, newG, 255), qBound(0, newB, 255), qAlpha(o));
+                }
             }
-        }
+        });
 
         currentEstimate = nextEstimate;
     }
 
-    return currentEstimate;
+    return currentEstimate.convertToFormat(src.format());
 }
 
-QImage FilterApplyer::applyNoiseReduction(const QImage &src){
-    QImage dst(src.width(), src.height(), src.format());
-    for(int y = 3; y < src.height() - 3; ++y){
-        for(int x = 3; x < src.width() - 3; ++x){
-            QVector<int> reds, greens, blues;
-            for (int j = -3; j <= 3; ++j) {
-                for (int i = -3; i <= 3; ++i) {
-                    QColor color = QColor(src.pixel(x + i, y + j));
-                    reds.append(color.red());
-                    greens.append(color.green());
-                    blues.append(color.blue());
-                }
-            }
-
-            std::sort(reds.begin(), reds.end());
-            std::sort(greens.begin(), greens.end());
-            std::sort(blues.begin(), blues.end());
-            dst.setPixel(x, y, qRgb(reds[24], greens[24], blues[24]));
-        }
+QImage FilterApplyer::applyNoiseReduction(const QImage &src, int radius){
+    if(src.isNull() || radius <= 0){
+        return src;
     }
 
-    return dst;
+    const QImage in = toWorkingFormat(src);
+    QImage dst(in.width(), in.height(), in.format());
+    const Rows out(dst);
+    const int clampedRadius = qMin(radius, 127);
+
+    // Tiles rather than full-width bands keep each task's column histograms small.
+    TileScheduler::forEachTile(in.size(), QSize(256, 64), clampedRadius, [&](const Tile& tile){
+        medianFilterTile(in, out, clampedRadius, tile.rect);
+    });
+
+    return dst.convertToFormat(src.format());
 }
 
 QImage FilterApplyer::applyEdgeDetection(const QImage &src){
-    QImage dst(src.width(), src.height(), src.format());
-    int Gx[3][3] = { { -1, 0, 1 },
-                     { -2, 0, 2 },
-                     { -1, 0, 1 } };
-
-    int Gy[3][3] = { { -1, -2, -1 },
-                     { 0, 0, 0 },
-                     { 1, 2, 1 } };
-
-    for(int y = 1; y < src.height() - 1; ++y){
-        for(int x = 1; x < src.width() - 1; ++x){
-            int sumRx = 0, sumGx = 0, sumBx = 0;
-            int sumRy = 0, sumGy = 0, sumBy = 0;
-
-            for(int j = -1; j <= 1; ++j){
-                for(int i = -1; i <= 1; ++i){
-                    QColor color = QColor(src.pixel(x + i, y + j));
-                    int weightX = Gx[j + 1][i + 1];
-                    int weightY = Gy[j + 1][i + 1];
-
-                    sumRx += color.red() * weightX;
-                    sumGx += color.green() * weightX;
-                    sumBx += color.blue() * weightX;
-
-                    sumRy += color.red() * weightY;
-                    sumGy += color.green() * weightY;
-                    sumBy += color.blue() * weightY;
-                }
-            }
+    const QImage in = toWorkingFormat(src);
+    const int width = in.width();
+    const int height = in.height();
+    QImage dst(width, height, in.format());
+    const Rows out(dst);
 
-            int r = qBound(0, int(qSqrt(sumRx * sumRx + sumRy * sumRy)), 255);
-            int g = qBound(0, int(qSqrt(sumGx * sumGx + sumGy * sumGy)), 255);
-            int b = qBound(0, int(qSqrt(sumBx * sumBx + sumBy * sumBy)), 255);
-
-            dst.setPixel(x, y, qRgb(r, g, b));
+    // Edges are clamped, so the one pixel border gets gradients too.
+    TileScheduler::forEachBand(in.size(), in.bytesPerLine(), 1, [&](const Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            const QRgb* above = constLine(in, qMax(y - 1, 0));
+            const QRgb* row = constLine(in, y);
+            const QRgb* below = constLine(in, qMin(y + 1, height - 1));
+            SimdKernels::sobelRow(above, row, below, width, out.line(y));
         }
-    }
+    });
 
-    return dst;
+    return dst.convertToFormat(src.format());
 }
-
-
@@ -2,29 +2,62 @@
 #define FILTERAPPLYER_H
 
 #include <QImage>
+#include <QVector>
 
+class ColorMatrix;
+class FloatImage;
+class IntegralImage;
+
+// Every filter accepts any QImage format and returns the same format. High bit
+// depth images (see FloatImage::isHighBitDepth()) keep 16 bits per channel through
+// the tone curves, color matrices and the Gaussian blur; the other filters work
+// on an 8-bit copy.
 class FilterApplyer
 {
+public:
+    // How the convolutions sample pixels that fall outside the image.
+    enum class BorderMode{
+        Clamp,
+        Mirror
+    };
+
 public:
     FilterApplyer();
 public:
     static QImage applyGrayscale(const QImage& src);
     static QImage applyInvert(const QImage& src);
     static QImage applyBrightnessFilter(const QImage& src, int brightness);
-    static QImage applyBlur(const QImage& src);
+    // Separable Gaussian blur; the kernel radius is 3 * sigma, so cost grows linearly with sigma.
+    static QImage applyBlur(const QImage& src, double sigma = 1.0, BorderMode border = BorderMode::Clamp);
+    static FloatImage applyBlur(const FloatImage& src, double sigma = 1.0, BorderMode border = BorderMode::Clamp);
+    // Box and box-approximated Gaussian blurs whose per-pixel cost does not depend on the radius.
+    // The IntegralImage overload lets several radii share one summed-area table.
+    static QImage applyBoxBlur(const QImage& src, int radius);
+    static QImage applyBoxBlur(const IntegralImage& table, int radius);
+    static QImage applyFastGaussianBlur(const QImage& src, double sigma);
     static QImage applySepia(const QImage& src);
     static QImage applyContrast(const QImage& src, double factor);
     static QImage applySaturation(const QImage& src, bool saturation);
     static QImage applyHue(const QImage& src, int hueShift);
+    // Applies an affine color transform in one pass. Grayscale, sepia, saturation and
+    // hue are color matrices, so chains of them can be concatenated and applied once.
+    static QImage applyColorMatrix(const QImage& src, const ColorMatrix& matrix);
+    // Applies matrices in order like separate applyColorMatrix() calls, but fuses
+    // consecutive ones into one pass as long as nothing in between could saturate.
+    static QImage applyColorMatrices(const QImage& src, const QVector<ColorMatrix>& matrices);
+    // Float version without clamping, for chains that quantize only at the end.
+    static FloatImage applyColorMatrix(const FloatImage& src, const ColorMatrix& matrix);
     static QImage applySolarize(const QImage& src, int treshold);
     static QImage applyPosterize(const QImage& src, int levels);
     static QImage applyPixelate(const QImage& src, int blockSize);
+    static QImage applyPixelate(const IntegralImage& table, int blockSize);
     static QImage applyVignete(const QImage& src);
 
     static void convolveDoubleKernel(const QImage& inputImg, QImage& outImg);
     static QImage applyDeBlur(const QImage& src);
 
-    static QImage applyNoiseReduction(const QImage& src);
+    // Median filter over a (2 * radius + 1)^2 window; radius is limited to 127.
+    static QImage applyNoiseReduction(const QImage& src, int radius = 3);
     static QImage applyEdgeDetection(const QImage& src);
 };
 
@@ -1,12 +1,59 @@
 #include "filterdialog.h"
+#include "filterapplyer.h"
 #include <QListWidget>
 #include <QVBoxLayout>
+#include <QHBoxLayout>
 #include <QDialogButtonBox>
 #include <QPushButton>
+#include <QtConcurrent>
+#include <QtMath>
 
-FilterDialog::FilterDialog(QWidget *parent)
+namespace {
+
+// Filters with an adjustable parameter: slider label, range and default value.
+struct FilterParameter {
+    const char *filter;
+    const char *label;
+    int minimum;
+    int maximum;
+    int value;
+};
+
+const FilterParameter kParameters[] = {
+    { "Blur",       "Sigma (x10):",  1,   50,  10 },
+    { "Brightness", "Brightness:",   -100, 100, 30 },
+    { "Contrast",   "Contrast (%):", 10,  300, 120 },
+    { "Hue",        "Angle:",        -180, 180, 30 },
+    { "Posterize",  "Levels:",       2,   32,  5 },
+    { "Solarize",   "Threshold:",    0,   255, 128 },
+    { "Pixelate",   "Block size:",   2,   100, 30 }
+};
+
+const FilterParameter *parameterOf(const QString &filter)
+{
+    for (const FilterParameter &parameter : kParameters) {
+        if (filter == QLatin1String(parameter.filter)) {
+            return &parameter;
+        }
+    }
+    return nullptr;
+}
+
+const QSize kPreviewSize(480, 360);
+
+}
+
+FilterDialog::FilterDialog(const QImage &proxy, double proxyScale, QWidget *parent)
     : QDialog(parent)
     , m_listWidget(new QListWidget(this))
+    , m_parameterLabel(new QLabel(this))
+    , m_parameterSlider(new QSlider(Qt::Horizontal, this))
+    , m_previewLabel(new QLabel(this))
+    , m_proxy(proxy)
+    , m_proxyScale(proxyScale)
+    , m_previewTimer(new QTimer(this))
+    , m_previewWatcher(new QFutureWatcher<QImage>(this))
+    , m_previewOutdated(false)
 {
     setWindowTitle("Choose a filter");
 
@@ -50,9 +97,28 @@ FilterDialog::FilterDialog(QWidget *parent)
         m_listWidget->addItem(item);
     }
 
+    m_previewLabel->setFixedSize(kPreviewSize);
+    m_previewLabel->setAlignment(Qt::AlignCenter);
+    showPreview(m_proxy);
+
+    m_previewTimer->setSingleShot(true);
+    m_previewTimer->setInterval(30);
+
     // Layout
+    QHBoxLayout *parameterLayout = new QHBoxLayout();
+    parameterLayout->addWidget(m_parameterLabel);
+    parameterLayout->addWidget(m_parameterSlider);
+
+    QVBoxLayout *controlsLayout = new QVBoxLayout();
+    controlsLayout->addWidget(m_listWidget);
+    controlsLayout->addLayout(parameterLayout);
+
+    QHBoxLayout *contentLayout = new QHBoxLayout();
+    contentLayout->addLayout(controlsLayout);
+    contentLayout->addWidget(m_previewLabel);
+
     QVBoxLayout *mainLayout = new QVBoxLayout(this);
-    mainLayout->addWidget(m_listWidget);
+    mainLayout->addLayout(contentLayout);
 
     // OK/Cancel buttons
     QDialogButtonBox *buttons = new QDialogButtonBox(
@@ -64,11 +130,18 @@ FilterDialog::FilterDialog(QWidget *parent)
 
     connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
     connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    connect(m_listWidget, &QListWidget::currentItemChanged, this, &FilterDialog::onSelectionChanged);
+    connect(m_parameterSlider, &QSlider::valueChanged, this, &FilterDialog::onParameterChanged);
+    connect(m_previewTimer, &QTimer::timeout, this, &FilterDialog::startPreview);
+    connect(m_previewWatcher, &QFutureWatcher<QImage>::finished, this, &FilterDialog::onPreviewFinished);
+
+    onSelectionChanged();
 }
 
 FilterDialog::~FilterDialog()
 {
-    // nothing special needed
+    // The preview job only holds copies, but finish it before the watcher goes away
+    m_previewWatcher->waitForFinished();
 }
 
 QString FilterDialog::selectedFilter() const
@@ -78,3 +151,111 @@ QString FilterDialog::selectedFilter() const
     QListWidgetItem *current = m_listWidget->currentItem();
     return current ? current->text() : QString();
 }
+
+int FilterDialog::parameter() const
+{
+    return parameterOf(selectedFilter()) ? m_parameterSlider->value() : 0;
+}
+
+QImage FilterDialog::apply(const QImage &src, const QString &filter, int parameter, double scale)
+{
+    if (filter == "Grayscale") {
+        return FilterApplyer::applyGrayscale(src);
+    } else if (filter == "Sepia") {
+        return FilterApplyer::applySepia(src);
+    } else if (filter == "Invert") {
+        return FilterApplyer::applyInvert(src);
+    } else if (filter == "Blur") {
+        return FilterApplyer::applyBlur(src, parameter / 10.0 * scale);
+    } else if (filter == "Brightness") {
+        return FilterApplyer::applyBrightnessFilter(src, parameter);
+    } else if (filter == "Contrast") {
+        return FilterApplyer::applyContrast(src, parameter / 100.0);
+    } else if (filter == "Saturation") {
+        return FilterApplyer::applySaturation(src, true);
+    } else if (filter == "Desaturation") {
+        return FilterApplyer::applySaturation(src, false);
+    } else if (filter == "Hue") {
+        return FilterApplyer::applyHue(src, parameter);
+    } else if (filter == "Posterize") {
+        return FilterApplyer::applyPosterize(src, parameter);
+    } else if (filter == "Solarize") {
+        return FilterApplyer::applySolarize(src, parameter);
+    } else if (filter == "Pixelate") {
+        return FilterApplyer::applyPixelate(src, qMax(1, qRound(parameter * scale)));
+    } else if (filter == "Vignette") {
+        return FilterApplyer::applyVignete(src);
+    } else if (filter == "Sharpen") {
+        return FilterApplyer::applyDeBlur(src);
+    }
+    return src;
+}
+
+bool FilterDialog::isSelfInverse(const QString &filter, QImage::Format format)
+{
+    if (filter != "Invert") {
+        return false;
+    }
+    // Premultiplied pixels are unpremultiplied to invert them, which rounds
+    switch (format) {
+    case QImage::Format_ARGB32:
+    case QImage::Format_RGB32:
+    case QImage::Format_RGB888:
+    case QImage::Format_Grayscale8:
+    case QImage::Format_RGBA64:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void FilterDialog::onSelectionChanged()
+{
+    const FilterParameter *parameter = parameterOf(selectedFilter());
+    m_parameterLabel->setVisible(parameter != nullptr);
+    m_parameterSlider->setVisible(parameter != nullptr);
+    if (parameter) {
+        // Setting the range and value may emit valueChanged; the timer coalesces it
+        m_parameterLabel->setText(parameter->label);
+        m_parameterSlider->setRange(parameter->minimum, parameter->maximum);
+        m_parameterSlider->setValue(parameter->value);
+        m_parameterSlider->setToolTip(QString::number(parameter->value));
+    }
+    m_previewTimer->start();
+}
+
+void FilterDialog::onParameterChanged(int value)
+{
+    m_parameterSlider->setToolTip(QString::number(value));
+    m_previewTimer->start();
+}
+
+void FilterDialog::startPreview()
+{
+    if (m_previewWatcher->isRunning()) {
+        m_previewOutdated = true;
+        return;
+    }
+    m_previewOutdated = false;
+    m_previewWatcher->setFuture(QtConcurrent::run(&FilterDialog::apply, m_proxy, selectedFilter(),
+                                                  parameter(), m_proxyScale));
+}
+
+void FilterDialog::onPreviewFinished()
+{
+    if (m_previewOutdated) {
+        startPreview();
+        return;
+    }
+    showPreview(m_previewWatcher->result());
+}
+
+void FilterDialog::showPreview(const QImage &image)
+{
+    if (image.isNull()) {
+        m_previewLabel->setText("No preview");
+        return;
+    }
+    m_previewLabel->setPixmap(QPixmap::fromImage(image).scaled(kPreviewSize, Qt::KeepAspectRatio,
+                                                               Qt::SmoothTransformation));
+}
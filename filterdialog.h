@@ -4,18 +4,54 @@
 #include <QDialog>
 #include <QWidget>
 #include <QListWidget>
+#include <QLabel>
+#include <QSlider>
+#include <QTimer>
+#include <QFutureWatcher>
+#include <QImage>
 
 class FilterDialog : public QDialog
 {
     Q_OBJECT
 public:
-    explicit FilterDialog(QWidget *parent = nullptr);
+    // proxy is a downscaled copy of the image that the live preview is rendered
+    // from; proxyScale is its size relative to the full image.
+    explicit FilterDialog(const QImage& proxy, double proxyScale, QWidget *parent = nullptr);
     ~FilterDialog();
 
     QString selectedFilter() const;
+    // Value of the selected filter's parameter slider, or 0 if it has none
+    int parameter() const;
+
+    // Runs one of the dialog's filters by name. scale is the size of src relative
+    // to the image it stands for, so blur radii and pixel blocks shrink with a proxy.
+    static QImage apply(const QImage& src, const QString& filter, int parameter, double scale = 1.0);
+    // Whether applying filter twice to an image in format gives back its exact
+    // pixels, so undoing it can apply it again instead of keeping the old image.
+    static bool isSelfInverse(const QString& filter, QImage::Format format);
+
+private slots:
+    void onSelectionChanged();
+    void onParameterChanged(int value);
+    void startPreview();
+    void onPreviewFinished();
+
+private:
+    void showPreview(const QImage& image);
 
 private:
     QListWidget *m_listWidget;
+    QLabel      *m_parameterLabel;
+    QSlider     *m_parameterSlider;
+    QLabel      *m_previewLabel;
+
+    QImage m_proxy;
+    double m_proxyScale;
+    // Coalesces slider drags into one render; a render requested while another
+    // runs starts when that one finishes.
+    QTimer *m_previewTimer;
+    QFutureWatcher<QImage> *m_previewWatcher;
+    bool m_previewOutdated;
 };
 
 #endif // FILTERDIALOG_H
@@ -0,0 +1,87 @@
+#include "filterjob.h"
+
+#include <QtConcurrent>
+
+FilterJob::FilterJob(const QString &name, const Filter &filter, QObject *parent)
+    : QObject(parent),
+      m_name(name),
+      m_filter(filter)
+{
+    // The counters are polled rather than signalled from the workers, which would
+    // queue one event per tile.
+    m_pollTimer.setInterval(100);
+    connect(&m_pollTimer, &QTimer::timeout, this, &FilterJob::onPollProgress);
+    connect(&m_watcher, &QFutureWatcher<QImage>::finished, this, &FilterJob::onWatcherFinished);
+}
+
+FilterJob::~FilterJob()
+{
+    m_control.cancelled.store(true);
+    m_watcher.waitForFinished();
+}
+
+QString FilterJob::name() const
+{
+    return m_name;
+}
+
+FilterJob::Filter FilterJob::filter() const
+{
+    return m_filter;
+}
+
+QImage FilterJob::source() const
+{
+    return m_source;
+}
+
+void FilterJob::start(const QImage &source)
+{
+    if (isRunning()) {
+        return;
+    }
+    m_source = source;
+    m_control.cancelled.store(false);
+    m_control.passes.store(0);
+    m_control.tilesDone.store(0);
+    m_control.tilesTotal.store(0);
+
+    TileScheduler::Control *control = &m_control;
+    const Filter filter = m_filter;
+    m_watcher.setFuture(QtConcurrent::run([control, filter, source]() {
+        TileScheduler::setControl(control);
+        const QImage result = filter(source);
+        TileScheduler::setControl(nullptr);
+        return result;
+    }));
+    m_pollTimer.start();
+    emit progressChanged(1, 0);
+}
+
+void FilterJob::cancel()
+{
+    m_control.cancelled.store(true);
+}
+
+bool FilterJob::isRunning() const
+{
+    return m_watcher.isRunning();
+}
+
+void FilterJob::onPollProgress()
+{
+    const int total = m_control.tilesTotal.load(std::memory_order_relaxed);
+    const int done = m_control.tilesDone.load(std::memory_order_relaxed);
+    const int pass = qMax(1, m_control.passes.load(std::memory_order_relaxed));
+    emit progressChanged(pass, total > 0 ? qMin(100, 100 * done / total) : 0);
+}
+
+void FilterJob::onWatcherFinished()
+{
+    m_pollTimer.stop();
+    if (m_control.cancelled.load()) {
+        emit cancelled();
+        return;
+    }
+    emit finished(m_watcher.result());
+}
@@ -0,0 +1,57 @@
+#ifndef FILTERJOB_H
+#define FILTERJOB_H
+
+#include <QObject>
+#include <QImage>
+#include <QString>
+#include <QTimer>
+#include <QFutureWatcher>
+#include <functional>
+
+#include "tilescheduler.h"
+
+// Runs a filter on the thread pool, reporting progress and allowing it to be
+// cancelled. Progress comes from the TileScheduler passes the filter makes, so
+// filters that do not go through TileScheduler only report completion.
+class FilterJob : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<QImage(const QImage&)> Filter;
+
+public:
+    FilterJob(const QString& name, const Filter& filter, QObject *parent = nullptr);
+    // Cancels a running filter and waits for it to stop.
+    ~FilterJob();
+
+    QString name() const;
+    Filter filter() const;
+    // The image the job was last started on.
+    QImage source() const;
+
+    // Starts the filter on source. A job can be started again once it is no longer
+    // running, e.g. on an image that was edited meanwhile.
+    void start(const QImage& source);
+    void cancel();
+    bool isRunning() const;
+
+signals:
+    // pass counts the filter's parallel passes from 1; percent is that pass's progress.
+    void progressChanged(int pass, int percent);
+    void finished(const QImage& result);
+    void cancelled();
+
+private slots:
+    void onPollProgress();
+    void onWatcherFinished();
+
+private:
+    QString m_name;
+    Filter m_filter;
+    QImage m_source;
+    TileScheduler::Control m_control;
+    QFutureWatcher<QImage> m_watcher;
+    QTimer m_pollTimer;
+};
+
+#endif // FILTERJOB_H
@@ -0,0 +1,101 @@
+#include "floatimage.h"
+#include "simdkernels.h"
+#include "tilescheduler.h"
+
+FloatImage::FloatImage()
+    : m_width(0), m_height(0)
+{
+}
+
+FloatImage::FloatImage(int width, int height)
+    : m_width(qMax(0, width)), m_height(qMax(0, height)), m_data(4 * m_width * m_height)
+{
+}
+
+FloatImage::FloatImage(const QImage& image)
+    : FloatImage(image.width(), image.height())
+{
+    if(image.isNull()){
+        return;
+    }
+    // Every format converts to RGBA64 exactly, 8-bit channels v becoming v * 257.
+    const QImage source = (image.format() == QImage::Format_RGBA64) ? image : image.convertToFormat(QImage::Format_RGBA64);
+    TileScheduler::forEachBand(source.size(), source.bytesPerLine(), 0, [&](const TileScheduler::Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            float* const planes[4] = { line(Red, y), line(Green, y), line(Blue, y), line(Alpha, y) };
+            SimdKernels::unpackRgba64(reinterpret_cast<const quint16*>(source.constScanLine(y)), m_width, planes);
+        }
+    });
+}
+
+bool FloatImage::isHighBitDepth(QImage::Format format)
+{
+    switch(format){
+    case QImage::Format_RGBA64:
+    case QImage::Format_RGBX64:
+    case QImage::Format_RGBA64_Premultiplied:
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    case QImage::Format_Grayscale16:
+#endif
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool FloatImage::isNull() const
+{
+    return m_data.isEmpty();
+}
+
+int FloatImage::width() const
+{
+    return m_width;
+}
+
+int FloatImage::height() const
+{
+    return m_height;
+}
+
+QSize FloatImage::size() const
+{
+    return QSize(m_width, m_height);
+}
+
+float* FloatImage::plane(Channel channel)
+{
+    return m_data.data() + qptrdiff(channel) * m_width * m_height;
+}
+
+const float* FloatImage::constPlane(Channel channel) const
+{
+    return m_data.constData() + qptrdiff(channel) * m_width * m_height;
+}
+
+float* FloatImage::line(Channel channel, int y)
+{
+    return plane(channel) + qptrdiff(y) * m_width;
+}
+
+const float* FloatImage::constLine(Channel channel, int y) const
+{
+    return constPlane(channel) + qptrdiff(y) * m_width;
+}
+
+QImage FloatImage::toImage(QImage::Format format) const
+{
+    if(isNull()){
+        return QImage();
+    }
+    QImage image(m_width, m_height, QImage::Format_RGBA64);
+    uchar* bits = image.bits();
+    const int stride = image.bytesPerLine();
+    TileScheduler::forEachBand(image.size(), stride, 0, [&](const TileScheduler::Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            const float* const planes[4] = { constLine(Red, y), constLine(Green, y), constLine(Blue, y), constLine(Alpha, y) };
+            SimdKernels::packRgba64(planes, m_width, reinterpret_cast<quint16*>(bits + qptrdiff(y) * stride));
+        }
+    });
+    return (format == QImage::Format_RGBA64) ? image : image.convertToFormat(format);
+}
@@ -0,0 +1,51 @@
+#ifndef FLOATIMAGE_H
+#define FLOATIMAGE_H
+
+#include <QImage>
+#include <QSize>
+#include <QVector>
+
+// Planar float working buffer for high bit depth images: one row-major plane per
+// channel, values nominally in 0..1 (not premultiplied). Values are not clamped
+// between filters, so a chain of them only quantizes once, in toImage().
+class FloatImage
+{
+public:
+    enum Channel{
+        Red,
+        Green,
+        Blue,
+        Alpha
+    };
+
+public:
+    FloatImage();
+    FloatImage(int width, int height);
+    // Unpacks any format; the 16-bit ones keep their full precision.
+    explicit FloatImage(const QImage& image);
+
+    // Formats with more than 8 bits per channel, which the filters process without
+    // going through 8 bits.
+    static bool isHighBitDepth(QImage::Format format);
+
+    bool isNull() const;
+    int width() const;
+    int height() const;
+    QSize size() const;
+
+    // A plane holds width() * height() values; lines are width() apart.
+    float* plane(Channel channel);
+    const float* constPlane(Channel channel) const;
+    float* line(Channel channel, int y);
+    const float* constLine(Channel channel, int y) const;
+
+    // Clamps and rounds to Format_RGBA64, then converts to format if it differs.
+    QImage toImage(QImage::Format format = QImage::Format_RGBA64) const;
+
+private:
+    int m_width;
+    int m_height;
+    QVector<float> m_data;
+};
+
+#endif // FLOATIMAGE_H
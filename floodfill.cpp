@@ -0,0 +1,195 @@
+#include "floodfill.h"
+
+#include <QBitArray>
+#include <QVector>
+
+namespace {
+
+const int TileSize = TiledImage::TileSize;
+
+struct Span{
+    int y;
+    int left;
+    int right;
+};
+
+// Reads the pixels of a TiledImage as ARGB32, a row of one tile at a time.
+// Tiles in other formats are converted once, when the fill first reaches them.
+class Reader
+{
+public:
+    explicit Reader(const TiledImage& image)
+        : m_image(image), m_views(image.tileCount())
+    {
+    }
+
+    // The pixels begin..end - 1 of row y, in the tile that holds pixel x; the
+    // result points at pixel begin.
+    const QRgb* row(int x, int y, int* begin, int* end){
+        const int index = m_image.tileIndex(QPoint(x, y));
+        QImage& view = m_views[index];
+        if(view.isNull()){
+            const QImage& tile = m_image.tile(index);
+            const bool direct = tile.format() == QImage::Format_ARGB32 || tile.format() == QImage::Format_RGB32;
+            view = direct ? tile : tile.convertToFormat(QImage::Format_ARGB32);
+        }
+        *begin = x - x % TileSize;
+        *end = *begin + view.width();
+        return reinterpret_cast<const QRgb*>(view.constScanLine(y % TileSize));
+    }
+
+private:
+    const TiledImage& m_image;
+    QVector<QImage> m_views;
+};
+
+class Matcher
+{
+public:
+    Matcher(QRgb seed, int tolerance)
+        : m_seed(seed), m_tolerance(qBound(0, tolerance, 255))
+    {
+    }
+
+    bool operator()(QRgb pixel) const{
+        if(m_tolerance == 0){
+            return pixel == m_seed;
+        }
+        return qAbs(qRed(pixel) - qRed(m_seed)) <= m_tolerance
+            && qAbs(qGreen(pixel) - qGreen(m_seed)) <= m_tolerance
+            && qAbs(qBlue(pixel) - qBlue(m_seed)) <= m_tolerance
+            && qAbs(qAlpha(pixel) - qAlpha(m_seed)) <= m_tolerance;
+    }
+
+private:
+    QRgb m_seed;
+    int m_tolerance;
+};
+
+// Writes color over the part of span in a tile whose top left pixel is origin.
+void writeSpan(QImage& tile, const QPoint& origin, int y, int left, int right, QRgb color){
+    const int ty = y - origin.y();
+    switch(tile.format()){
+    case QImage::Format_ARGB32:
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32_Premultiplied:{
+        QRgb* line = reinterpret_cast<QRgb*>(tile.scanLine(ty)) - origin.x();
+        const QRgb value = (tile.format() == QImage::Format_ARGB32) ? color
+                         : (tile.format() == QImage::Format_RGB32) ? (color | 0xff000000u)
+                         : qPremultiply(color);
+        for(int x = left; x <= right; ++x){
+            line[x] = value;
+        }
+        break;
+    }
+    default:
+        for(int x = left; x <= right; ++x){
+            tile.setPixel(x - origin.x(), ty, color);
+        }
+        break;
+    }
+}
+
+
+// The runs of pixels connected to seed that match it. Empty if filling them with
+// color would change nothing.
+QVector<Span> findRegion(const TiledImage& image, const QPoint& seed, QRgb color, int tolerance, int reach){
+    const int width = image.width();
+    const int height = image.height();
+    Reader reader(image);
+    int begin = 0, end = 0;
+    const QRgb seedColor = reader.row(seed.x(), seed.y(), &begin, &end)[seed.x() - begin];
+    if(tolerance <= 0 && seedColor == color){
+        return QVector<Span>();
+    }
+    const Matcher matches(seedColor, tolerance);
+    QBitArray taken(width * height);
+    QVector<Span> spans;
+    QVector<QPoint> pending;
+    pending.append(seed);
+
+    while(!pending.isEmpty()){
+        const QPoint start = pending.takeLast();
+        const int y = start.y();
+        const int row = y * width;
+        if(taken.testBit(row + start.x())){
+            continue;
+        }
+        // Grow the run both ways along the row, a tile at a time; pending points match
+        int first = start.x();
+        while(first > 0){
+            const QRgb* pixels = reader.row(first - 1, y, &begin, &end);
+            int x = first - 1;
+            while(x >= begin && !taken.testBit(row + x) && matches(pixels[x - begin])){
+                --x;
+            }
+            first = x + 1;
+            if(x >= begin){
+                break;
+            }
+        }
+        int last = start.x();
+        while(last < width - 1){
+            const QRgb* pixels = reader.row(last + 1, y, &begin, &end);
+            int x = last + 1;
+            while(x < end && !taken.testBit(row + x) && matches(pixels[x - begin])){
+                ++x;
+            }
+            last = x - 1;
+            if(x < end){
+                break;
+            }
+        }
+        taken.fill(true, row + first, row + last + 1);
+        spans.append(Span{y, first, last});
+
+        // One pending point per run of open pixels next to this one, above and below
+        for(int ny = y - 1; ny <= y + 1; ny += 2){
+            if(ny < 0 || ny >= height){
+                continue;
+            }
+            const int nrow = ny * width;
+            const int to = qMin(width - 1, last + reach);
+            bool inRun = false;
+            int x = qMax(0, first - reach);
+            while(x <= to){
+                const QRgb* pixels = reader.row(x, ny, &begin, &end);
+                const int stop = qMin(end - 1, to);
+                for(; x <= stop; ++x){
+                    const bool open = !taken.testBit(nrow + x) && matches(pixels[x - begin]);
+                    if(open && !inRun){
+                        pending.append(QPoint(x, ny));
+                    }
+                    inRun = open;
+                }
+            }
+        }
+    }
+    return spans;
+}
+
+}
+
+QRect FloodFill::fill(TiledImage& image, const QPoint& seed, QRgb color, int tolerance, Connectivity connectivity){
+    if(!image.rect().contains(seed)){
+        return QRect();
+    }
+    const int reach = (connectivity == Connectivity::Eight) ? 1 : 0;
+    // The reader of findRegion() is gone by now, so writing does not detach tiles from its views
+    const QVector<Span> spans = findRegion(image, seed, color, tolerance, reach);
+
+    QRect filled;
+    QVector<QImage*> tiles(image.tileCount(), nullptr);
+    for(const Span& span : spans){
+        filled |= QRect(span.left, span.y, span.right - span.left + 1, 1);
+        for(int column = span.left / TileSize; column <= span.right / TileSize; ++column){
+            const int index = image.tileIndex(QPoint(column * TileSize, span.y));
+            if(!tiles[index]){
+                tiles[index] = &image.editTile(index);
+            }
+            const QRect rect = image.tileRect(index);
+            writeSpan(*tiles[index], rect.topLeft(), span.y, qMax(span.left, rect.left()), qMin(span.right, rect.right()), color);
+        }
+    }
+    return filled;
+}
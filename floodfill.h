@@ -0,0 +1,29 @@
+#ifndef FLOODFILL_H
+#define FLOODFILL_H
+
+#include <QPoint>
+#include <QRect>
+#include <QRgb>
+
+#include "tiledimage.h"
+
+// Scanline flood fill on the tiles of a TiledImage. The region is found first,
+// a whole run of pixels at a time, with a bitmap of the pixels already taken,
+// and then written only into the tiles it covers.
+class FloodFill
+{
+public:
+    enum class Connectivity{
+        Four,   // Pixels connect through their edges.
+        Eight   // Diagonal neighbors connect too.
+    };
+
+public:
+    // Fills the pixels connected to seed whose channels, alpha included, differ
+    // from the seed's by at most tolerance (0 matches the exact color) with color.
+    // Returns the bounding rectangle of the filled pixels, empty if none changed.
+    static QRect fill(TiledImage& image, const QPoint& seed, QRgb color, int tolerance = 0,
+                      Connectivity connectivity = Connectivity::Four);
+};
+
+#endif // FLOODFILL_H
@@ -1,8 +1,39 @@
 
 #include "graphicscanvas.h"
-#include <QQueue>
+#include "floatimage.h"
+#include "imagemanipulator.h"
+#include "jpegexif.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
 #include <QtMath>
 
+namespace {
+
+// The transformations a reader found in the file, e.g. in EXIF data, as an Orientation.
+Orientation orientationOf(QImageIOHandler::Transformations transformations)
+{
+    Orientation orientation;
+    if (transformations & QImageIOHandler::TransformationMirror) {
+        orientation = orientation.then(Orientation::flipHorizontal());
+    }
+    if (transformations & QImageIOHandler::TransformationFlip) {
+        orientation = orientation.then(Orientation::flipVertical());
+    }
+    if (transformations & QImageIOHandler::TransformationRotate90) {
+        orientation = orientation.then(Orientation::rotateRight());
+    }
+    return orientation;
+}
+
+bool isJpeg(const QString &filePath)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    return suffix == "jpg" || suffix == "jpeg";
+}
+
+}
+
 GraphicsCanvas::GraphicsCanvas(QWidget* parent)
     : QGraphicsView(parent),
       m_scene(new QGraphicsScene(this)),
@@ -21,38 +52,138 @@ GraphicsCanvas::GraphicsCanvas(QWidget* parent)
 
 void GraphicsCanvas::createBlank(){
     m_filename.clear();
-    m_image = QImage(800, 600, QImage::Format::Format_ARGB32);
-    m_image.fill(Qt::white);
+    QImage blank(800, 600, QImage::Format::Format_ARGB32);
+    blank.fill(Qt::white);
+    m_image = TiledImage(blank);
+    m_orientation = Orientation();
+    m_sourcePath.clear();
+    m_sourceKey = 0;
     this->updateBackground();
 }
 
 void GraphicsCanvas::loadImage(const QString &filePath)
 {
+    QImageReader reader(filePath);
+    reader.setAutoTransform(false);
     QImage temp;
-    if (!temp.load(filePath)) {
+    if (!reader.read(&temp)) {
         return;
     }
-    m_image = temp.convertToFormat(QImage::Format_ARGB32);
-    setMinimumSize(m_image.size());
-    m_backgroundItem->update();
+    // 16-bit scans stay 16-bit; they are only quantized for display and 8-bit exports.
+    const bool highBitDepth = FloatImage::isHighBitDepth(temp.format());
+    m_image = TiledImage(temp.convertToFormat(highBitDepth ? QImage::Format_RGBA64 : QImage::Format_ARGB32));
+    m_orientation = orientationOf(reader.transformation());
+    m_sourcePath = filePath;
+    m_sourceKey = m_image.cacheKey();
+    setMinimumSize(imageSize());
     this->updateBackground();
 }
 
-void GraphicsCanvas::saveImage()
+void GraphicsCanvas::saveImage(bool eightBit)
+{
+    if (m_image.cacheKey() == m_sourceKey && isJpeg(m_sourcePath) && isJpeg(m_filename) && saveOrientationOnly()) {
+        return;
+    }
+    const QImage image = ImageManipulator::transform(m_image.toImage(), m_orientation);
+    if (eightBit && FloatImage::isHighBitDepth(image.format())) {
+        image.convertToFormat(QImage::Format_ARGB32).save(m_filename);
+        return;
+    }
+    image.save(m_filename);
+}
+
+bool GraphicsCanvas::saveOrientationOnly() const
 {
-    m_image.save(m_filename);
+    QFile source(m_sourcePath);
+    if (!source.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray jpeg = JpegExif::withOrientation(source.readAll(), m_orientation.toExif());
+    source.close();
+    if (jpeg.isEmpty()) {
+        return false;
+    }
+    QFile target(m_filename);
+    return target.open(QIODevice::WriteOnly) && target.write(jpeg) == jpeg.size();
 }
 
-QImage GraphicsCanvas::getImage() const
+QImage GraphicsCanvas::getImage()
 {
-    return m_image;
+    bakeOrientation();
+    return m_image.toImage();
+}
+
+qint64 GraphicsCanvas::imageKey() const
+{
+    // getImage() bakes a pending orientation into a new key, so until then no key
+    // taken after getImage() can match.
+    return m_orientation.isIdentity() ? m_image.cacheKey() : -1;
+}
+
+QSize GraphicsCanvas::imageSize() const
+{
+    return m_orientation.mapSize(m_image.size());
 }
 
 void GraphicsCanvas::setImage(const QImage &image)
 {
     pushUndoState();
-    m_image = image;
-    m_backgroundItem->update();
+    replaceImage(image);
+}
+
+void GraphicsCanvas::setImage(const QImage &image, const UndoHistory::Command &command)
+{
+    m_history.push(command, UndoHistory::State{m_image, m_orientation});
+    m_orientationChainKey = 0;
+    replaceImage(image);
+}
+
+void GraphicsCanvas::replaceImage(const QImage &image)
+{
+    m_image = TiledImage(image);
+    m_orientation = Orientation();
+    updateBackground();
+}
+
+QImage GraphicsCanvas::previewProxy(const QSize &bound) const
+{
+    // cacheKey() changes whenever m_image is modified
+    if (m_previewProxyKey != m_image.cacheKey() || m_previewProxyOrientation != m_orientation || m_previewProxyBound != bound) {
+        // Scaled first, so only the small proxy is rotated
+        const QSize rawBound = m_orientation.mapSize(bound);
+        const QImage image = m_image.toImage();
+        const bool fits = image.width() <= rawBound.width() && image.height() <= rawBound.height();
+        const QImage scaled = fits ? image : image.scaled(rawBound, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        m_previewProxy = ImageManipulator::transform(scaled, m_orientation);
+        m_previewProxyKey = m_image.cacheKey();
+        m_previewProxyOrientation = m_orientation;
+        m_previewProxyBound = bound;
+    }
+    return m_previewProxy;
+}
+
+void GraphicsCanvas::orient(const Orientation &orientation)
+{
+    if (m_image.isNull()) {
+        return;
+    }
+    if (m_orientationChainKey != m_image.cacheKey()) {
+        pushUndoState();
+    }
+    m_orientation = m_orientation.then(orientation);
+    m_orientationChainKey = m_image.cacheKey();
+    setMinimumSize(imageSize());
+    // Only the view transform changes; the uploaded pixels stay valid
+    updateSceneGeometry();
+}
+
+void GraphicsCanvas::bakeOrientation()
+{
+    if (m_orientation.isIdentity()) {
+        return;
+    }
+    m_image = TiledImage(ImageManipulator::transform(m_image.toImage(), m_orientation));
+    m_orientation = Orientation();
     updateBackground();
 }
 
@@ -97,7 +228,7 @@ void GraphicsCanvas::setZoomFactor(double factor)
     if (factor > 10.0) factor = 10.0;
     m_zoomFactor = factor;
 
-    this->updateBackground();
+    this->updateSceneGeometry();
 }
 
 double GraphicsCanvas::getZoomFactor() const
@@ -122,9 +253,8 @@ void GraphicsCanvas::cropSelection()
         return;
     }
     pushUndoState();
-    QImage newImg = m_image.copy(validRect);
-    m_image = newImg;
-    setMinimumSize(m_image.size());
+    m_image = TiledImage(m_image.copy(validRect));
+    setMinimumSize(imageSize());
 
     if (m_rubberBand) {
         m_rubberBand->hide();
@@ -133,9 +263,19 @@ void GraphicsCanvas::cropSelection()
     this->updateBackground();
 }
 
-void GraphicsCanvas::resizeImage(int width, int height){
+void GraphicsCanvas::resizeImage(int width, int height, Resampler::Filter filter, bool linearLight){
+    pushUndoState();
+    // width and height are as shown
+    m_image = TiledImage(Resampler::resize(m_image.toImage(), m_orientation.mapSize(QSize(width, height)), filter, linearLight));
+
+    this->updateBackground();
+}
+
+void GraphicsCanvas::rotateImage(qreal degrees, ImageManipulator::RotationBounds bounds, ImageManipulator::Interpolation interpolation){
     pushUndoState();
-    m_image = m_image.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    // The angle is about the image as shown
+    bakeOrientation();
+    m_image = TiledImage(ImageManipulator::rotate(m_image.toImage(), degrees, bounds, interpolation));
 
     this->updateBackground();
 }
@@ -143,8 +283,12 @@ void GraphicsCanvas::resizeImage(int width, int height){
 void GraphicsCanvas::paintEvent(QPaintEvent *event)
 {
     QGraphicsView::paintEvent(event); // no manual painting here
-    m_backgroundItem->update();
-    updateBackground();
+}
+
+void GraphicsCanvas::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+    fitInView(m_scene->sceneRect(), Qt::KeepAspectRatio);
 }
 
 void GraphicsCanvas::mousePressEvent(QMouseEvent *event)
@@ -169,7 +313,7 @@ void GraphicsCanvas::mousePressEvent(QMouseEvent *event)
                 pushUndoState();
             }
             m_drawingInProgress = true;
-            m_lastPoint = widgetToImage(event->pos());
+            beginStroke(widgetToImage(event->pos()), /*eraser=*/false);
             break;
         }
         case GraphicsCanvas::Tool::Fill:
@@ -187,7 +331,7 @@ void GraphicsCanvas::mousePressEvent(QMouseEvent *event)
                 pushUndoState();
             }
             m_drawingInProgress = true;
-            m_lastPoint = widgetToImage(event->pos());
+            beginStroke(widgetToImage(event->pos()), /*eraser=*/true);
             break;
         }
         case GraphicsCanvas::Tool::Pick:
@@ -201,7 +345,6 @@ void GraphicsCanvas::mousePressEvent(QMouseEvent *event)
         }
         case Tool::Magnify:
         {
-            pushUndoState();
             setZoomFactor(m_zoomFactor * 1.25);
             break;
         }
@@ -239,14 +382,14 @@ void GraphicsCanvas::mouseMoveEvent(QMouseEvent *event)
     case GraphicsCanvas::Tool::Pen:
         if (m_drawingInProgress && (event->buttons() & Qt::LeftButton)) {
             QPoint pt = widgetToImage(event->pos());
-            drawLineTo(pt, /*eraser=*/false);
+            drawLineTo(pt);
         }
         break;
 
     case GraphicsCanvas::Tool::Erase:
         if (m_drawingInProgress && (event->buttons() & Qt::LeftButton)) {
             QPoint pt = widgetToImage(event->pos());
-            drawLineTo(pt, /*eraser=*/true);
+            drawLineTo(pt);
         }
         break;
 
@@ -254,7 +397,7 @@ void GraphicsCanvas::mouseMoveEvent(QMouseEvent *event)
         if (m_pastingInProgress && (event->buttons() & Qt::LeftButton)) {
             // Move pasted image
             m_pastePosition = widgetToImage(event->pos()) - m_pasteOffset;
-            this->updateBackground();
+            viewport()->update();
         }
         break;
 
@@ -283,21 +426,21 @@ void GraphicsCanvas::mouseReleaseEvent(QMouseEvent *event)
         case GraphicsCanvas::Tool::Pen:
             if (m_drawingInProgress) {
                 QPoint pt = widgetToImage(event->pos());
-                drawLineTo(pt, (m_currentTool == GraphicsCanvas::Tool::Erase));
+                drawLineTo(pt);
                 m_drawingInProgress = false;
             }
             break;
         case GraphicsCanvas::Tool::Erase:
             if (m_drawingInProgress) {
                 QPoint pt = widgetToImage(event->pos());
-                drawLineTo(pt, (m_currentTool == GraphicsCanvas::Tool::Erase));
+                drawLineTo(pt);
                 m_drawingInProgress = false;
             }
             break;
         case GraphicsCanvas::Tool::None:
             if (m_pastingInProgress) {
                 m_pastingInProgress = false;
-                this->updateBackground();
+                viewport()->update();
             }
             break;
 
@@ -309,123 +452,26 @@ void GraphicsCanvas::mouseReleaseEvent(QMouseEvent *event)
     QWidget::mouseReleaseEvent(event);
 }
 
-void GraphicsCanvas::drawLineTo(const QPoint &endPoint, bool eraser)
+void GraphicsCanvas::beginStroke(const QPoint &point, bool eraser)
 {
-    if (!m_image.rect().contains(endPoint)) {
-        m_lastPoint = endPoint;
-        return;
-    }
+    BrushEngine::Brush brush;
+    brush.color = eraser ? QColor(Qt::white).rgba() : m_currentColor.rgba();
+    brush.diameter = eraser ? m_eraserSize : m_penSize;
+    // BrushStyle lists the same patterns in the same order as Qt::BrushStyle.
+    brush.pattern = Qt::BrushStyle(int(Qt::SolidPattern) + int(m_brushStyle));
 
-    QPainter painter(&m_image);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-
-    QPen pen;
-    QBrush brush;
-    brush.setColor(eraser ? Qt::white : m_currentColor);
-    pen.setWidth(eraser ? m_eraserSize : m_penSize);
-    pen.setColor(eraser ? Qt::white : m_currentColor);
-
-    // Apply selected brush style
-    switch (m_brushStyle)
-    {
-    case BrushStyle::Solid:
-        pen.setStyle(Qt::SolidLine);
-        break;
-    case BrushStyle::Dense1:
-        brush.setStyle(Qt::Dense1Pattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::Dense2:
-        brush.setStyle(Qt::Dense2Pattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::Dense3:
-        brush.setStyle(Qt::Dense3Pattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::Dense4:
-        brush.setStyle(Qt::Dense4Pattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::Dense5:
-        brush.setStyle(Qt::Dense5Pattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::Dense6:
-        brush.setStyle(Qt::Dense6Pattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::Dense7:
-        brush.setStyle(Qt::Dense7Pattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::Hor:
-        brush.setStyle(Qt::HorPattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::Ver:
-        brush.setStyle(Qt::VerPattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::Cross:
-        brush.setStyle(Qt::CrossPattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::BDiag:
-        brush.setStyle(Qt::BDiagPattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::FDiag:
-        brush.setStyle(Qt::FDiagPattern);
-        pen.setBrush(brush);
-        break;
-    case BrushStyle::DiagCross:
-        brush.setStyle(Qt::DiagCrossPattern);
-        pen.setBrush(brush);
-        break;
-    }
-
-    painter.setPen(pen);
-    painter.drawLine(m_lastPoint, endPoint);
-    m_lastPoint = endPoint;
-
-    int rad = (eraser ? m_eraserSize : m_penSize) / 2 + 2;
-    QRect updateRect = QRect(m_lastPoint, endPoint).normalized().adjusted(-rad, -rad, rad, rad);
+    // Dabs are centered on the pixel under the cursor.
+    markDirty(m_brushEngine.beginStroke(m_image, brush, QPointF(point) + QPointF(0.5, 0.5)));
+}
 
-    m_lastPoint = endPoint;
-    update(updateRect);
+void GraphicsCanvas::drawLineTo(const QPoint &endPoint)
+{
+    markDirty(m_brushEngine.strokeTo(m_image, QPointF(endPoint) + QPointF(0.5, 0.5)));
 }
 
 void GraphicsCanvas::floodFill(const QPoint &start, const QColor &fillColor)
 {
-    if (!m_image.rect().contains(start)) return;
-
-    QRgb oldColor = m_image.pixel(start);
-    QRgb newColor = fillColor.rgba();
-    if (oldColor == newColor) {
-        return;
-    }
-
-    QQueue<QPoint> queue;
-    queue.enqueue(start);
-
-    while (!queue.isEmpty()) {
-        QPoint p = queue.dequeue();
-        if (!m_image.rect().contains(p)) continue;
-
-        if (m_image.pixel(p) == oldColor) {
-            // set new color
-            m_image.setPixel(p, newColor);
-
-            // enqueue neighbors (4-direction)
-            queue.enqueue(QPoint(p.x() + 1, p.y()));
-            queue.enqueue(QPoint(p.x() - 1, p.y()));
-            queue.enqueue(QPoint(p.x(), p.y() + 1));
-            queue.enqueue(QPoint(p.x(), p.y() - 1));
-        }
-    }
-
-    this->updateBackground();
+    markDirty(FloodFill::fill(m_image, start, fillColor.rgba(), m_fillTolerance, m_fillConnectivity));
 }
 
 QPoint GraphicsCanvas::widgetToImage(const QPoint &widgetPos) const
@@ -453,7 +499,7 @@ void GraphicsCanvas::copy(){
         return;
     }
 
-    m_clipboardImage = m_image.copy(validRect);
+    m_clipboardImage = ImageManipulator::transform(m_image.copy(validRect), m_orientation);
 }
 
 void GraphicsCanvas::cut() {
@@ -472,18 +518,18 @@ void GraphicsCanvas::cut() {
     }
 
     pushUndoState();
-    m_clipboardImage = m_image.copy(validRect);
+    m_clipboardImage = ImageManipulator::transform(m_image.copy(validRect), m_orientation);
 
-    QPainter painter(&m_image);
-    painter.setCompositionMode(QPainter::CompositionMode_Clear);
-    painter.fillRect(validRect, Qt::transparent);
-    painter.end();
+    m_image.paint(validRect, [&](QPainter &painter) {
+        painter.setCompositionMode(QPainter::CompositionMode_Clear);
+        painter.fillRect(validRect, Qt::transparent);
+    });
 
     if (m_rubberBand) {
         m_rubberBand->hide();
     }
     m_selectionRect = QRect(); // reset
-    update();
+    markDirty(validRect);
 }
 
 void GraphicsCanvas::paste(){
@@ -491,42 +537,61 @@ void GraphicsCanvas::paste(){
         return;
 
     pushUndoState();
-    QPainter painter(&m_image);
-    painter.drawImage(0, 0, m_clipboardImage);
-    update();
+    bakeOrientation();
+    m_image.paint(QRect(QPoint(0, 0), m_clipboardImage.size()), [&](QPainter &painter) {
+        painter.drawImage(0, 0, m_clipboardImage);
+    });
+    markDirty(QRect(QPoint(0, 0), m_clipboardImage.size()));
 }
 
 void GraphicsCanvas::pushUndoState(){
-    m_undoStack.push(m_image);
-    m_redoStack.clear();
+    m_history.push(UndoHistory::State{m_image, m_orientation}, m_image);
+    m_orientationChainKey = 0;
 }
 
-void GraphicsCanvas::undo(){
-    if (m_undoStack.isEmpty()) {
-        return;
+bool GraphicsCanvas::undo(){
+    if (!m_history.canUndo()) {
+        return true;
     }
 
-    m_redoStack.push(m_image);
-    m_image = m_undoStack.pop();
+    bool ok = false;
+    const UndoHistory::State state = m_history.undo(UndoHistory::State{m_image, m_orientation}, &ok);
+    if (!ok) {
+        return false;
+    }
+    m_image = state.image;
+    m_orientation = state.orientation;
+    m_orientationChainKey = 0;
     this->updateBackground();
+    return true;
 }
 
 void GraphicsCanvas::redo(){
-    if (m_redoStack.isEmpty()) {
+    if (!m_history.canRedo()) {
         return;
     }
 
-    m_undoStack.push(m_image);
-    m_image = m_redoStack.pop();
+    const UndoHistory::State state = m_history.redo(UndoHistory::State{m_image, m_orientation});
+    m_image = state.image;
+    m_orientation = state.orientation;
+    m_orientationChainKey = 0;
     this->updateBackground();
 }
 
 bool GraphicsCanvas::canUndo() const{
-    return !m_undoStack.isEmpty();
+    return m_history.canUndo();
 }
 
 bool GraphicsCanvas::canRedo() const{
-    return !m_redoStack.isEmpty();
+    return m_history.canRedo();
+}
+
+void GraphicsCanvas::setUndoMemoryLimit(qint64 bytes){
+    m_history.setMemoryLimit(bytes);
+}
+
+void GraphicsCanvas::setUndoSpillDirectory(const QString &path){
+    m_history.setSpillDirectory(path);
 }
 
 void GraphicsCanvas::setBrushStyle(BrushStyle style)
@@ -539,14 +604,39 @@ GraphicsCanvas::BrushStyle GraphicsCanvas::getBrushStyle() const
     return m_brushStyle;
 }
 
+void GraphicsCanvas::setFillTolerance(int tolerance)
+{
+    m_fillTolerance = tolerance;
+}
+
+void GraphicsCanvas::setFillConnectivity(FloodFill::Connectivity connectivity)
+{
+    m_fillConnectivity = connectivity;
+}
+
 void GraphicsCanvas::updateBackground(){
     if (!m_backgroundItem) {
-        m_backgroundItem = new QGraphicsPixmapItem(QPixmap::fromImage(m_image));
+        m_backgroundItem = new ImageDisplayItem(&m_image);
         m_scene->addItem(m_backgroundItem);
-    } else {
-        m_backgroundItem->setPixmap(QPixmap::fromImage(m_image));
     }
-    m_scene->setSceneRect(0, 0, m_image.width(), m_image.height());
+    m_backgroundItem->reset();
+    updateSceneGeometry();
+}
+
+void GraphicsCanvas::markDirty(const QRect &rect)
+{
+    m_backgroundItem->updateArea(rect.intersected(m_image.rect()));
+}
+
+void GraphicsCanvas::updateSceneGeometry()
+{
+    if (!m_backgroundItem) {
+        return;
+    }
+    // The pixels are shown through the pending orientation
+    m_backgroundItem->setTransform(m_orientation.toTransform(m_image.size()));
+    const QSize size = imageSize();
+    m_scene->setSceneRect(0, 0, size.width(), size.height());
     fitInView(m_scene->sceneRect(), Qt::KeepAspectRatio);
 }
 
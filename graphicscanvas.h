@@ -3,14 +3,21 @@
 
 #include <QGraphicsView>
 #include <QGraphicsScene>
-#include <QGraphicsPixmapItem>
 #include <QString>
 #include <QColor>
 #include <QImage>
 #include <QRubberBand>
-#include <QStack>
 #include <QMouseEvent>
 
+#include "brushengine.h"
+#include "floodfill.h"
+#include "imagedisplayitem.h"
+#include "imagemanipulator.h"
+#include "orientation.h"
+#include "resampler.h"
+#include "tiledimage.h"
+#include "undohistory.h"
+
 class GraphicsCanvas : public QGraphicsView
 {
     Q_OBJECT
@@ -46,13 +53,36 @@ public:
 public:
     explicit GraphicsCanvas(QWidget *parent = nullptr);
 
+    // Applies the orientation recorded in the file, e.g. by a camera, lazily (see orient()).
     void loadImage(const QString& filePath);
-    void saveImage();
+    // 16-bit images are written with 16 bits per channel where the format allows
+    // it, unless eightBit asks for an 8-bit file. A JPEG whose pixels did not change
+    // since it was loaded is copied with only its EXIF orientation updated.
+    void saveImage(bool eightBit = false);
 
 public:
     void createBlank();
-    QImage getImage() const;
+    // The image as shown, with a pending orientation baked into its pixels.
+    QImage getImage();
+    // Identifies the image as shown without copying it: it changes whenever the
+    // pixels or the pending orientation do. getImage() cannot serve for this, as
+    // every QImage it returns has a new cacheKey().
+    qint64 imageKey() const;
+    QSize imageSize() const;
     void setImage(const QImage& image);
+    // Like setImage(), for an image that command produced from the current one:
+    // the undo history keeps the command instead of the current pixels.
+    void setImage(const QImage& image, const UndoHistory::Command& command);
+    // Shows image without taking an undo snapshot, for edits that replace the
+    // result of an earlier one.
+    void replaceImage(const QImage& image);
+    // Copy of the image scaled down to fit bound, for previews. It is cached until
+    // the image changes, so reopening a preview costs nothing.
+    QImage previewProxy(const QSize& bound) const;
+    // Rotates or flips the image as shown without touching its pixels: the view
+    // applies the orientation, and it is baked in only once an operation needs the
+    // pixels. Consecutive calls share one undo snapshot.
+    void orient(const Orientation& orientation);
 
     QString getFilePath() const;
     void setFilePath(const QString& filePath);
@@ -62,6 +92,9 @@ public:
     void setEraserWidth(int width);
     void setBrushStyle(BrushStyle style);
     BrushStyle getBrushStyle() const;
+    // How far a color may be from the clicked one, per channel, to be filled too.
+    void setFillTolerance(int tolerance);
+    void setFillConnectivity(FloodFill::Connectivity connectivity);
 
     void setCurrentTool(GraphicsCanvas::Tool tool);
 
@@ -69,18 +102,26 @@ public:
     double getZoomFactor() const;
 
     void cropSelection();
-    void resizeImage(int width, int heigth);
+    void resizeImage(int width, int heigth, Resampler::Filter filter = Resampler::Filter::Lanczos3,
+                     bool linearLight = false);
+    void rotateImage(qreal degrees, ImageManipulator::RotationBounds bounds, ImageManipulator::Interpolation interpolation);
 
     void copy();
     void cut();
     void paste();
 
     void pushUndoState();
-    void undo();
+    // Returns false if the state to restore could not be read back from the undo
+    // spill file; the image and the history then stay as they are.
+    bool undo();
     void redo();
 
     bool canUndo() const;
     bool canRedo() const;
+    // Memory the undo history may take, see UndoHistory::setMemoryLimit().
+    void setUndoMemoryLimit(qint64 bytes);
+    // Where older undo states go once they exceed that memory, e.g. the project folder.
+    void setUndoSpillDirectory(const QString& path);
 
     QRect getSelectionRect() const{
         QRect imageRect;
@@ -94,26 +135,43 @@ protected:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
 
 private:
-    void drawLineTo(const QPoint &endPoint, bool eraser);
+    void beginStroke(const QPoint &point, bool eraser);
+    void drawLineTo(const QPoint &endPoint);
     void floodFill(const QPoint &p, const QColor &targetColor);
     QPoint widgetToImage(const QPoint &widgetPos) const;
+    // The whole image changed, e.g. it was replaced or resized.
     void updateBackground();
+    // Only rect of m_image changed; just the tiles it touches are repainted.
+    void markDirty(const QRect &rect);
+    // Orientation, scene rect and fit to the view, for changes that keep the pixels.
+    void updateSceneGeometry();
+    void bakeOrientation();
+    bool saveOrientationOnly() const;
 
 private:
     QGraphicsScene         *m_scene;
-    QGraphicsPixmapItem    *m_backgroundItem;
-    QImage m_image;
+    ImageDisplayItem       *m_backgroundItem;
+    TiledImage m_image;
+    // Pending rotation/flip of m_image, see orient().
+    Orientation m_orientation;
+    qint64 m_orientationChainKey = 0;
     QString m_filename;
+    // The file m_image was loaded from and the cache key it had then.
+    QString m_sourcePath;
+    qint64 m_sourceKey = 0;
     GraphicsCanvas::Tool m_currentTool;
     QColor    m_currentColor;
     QColor    m_pickedColor;
     int       m_penSize;
     int       m_eraserSize;
     BrushStyle m_brushStyle;  // Stores selected brush style
+    int m_fillTolerance = 0;
+    FloodFill::Connectivity m_fillConnectivity = FloodFill::Connectivity::Four;
     bool   m_drawingInProgress;
-    QPoint m_lastPoint;
+    BrushEngine m_brushEngine;
 
     QRubberBand *m_rubberBand;
     bool         m_selecting;
@@ -131,8 +189,13 @@ private:
     QPoint m_pasteOffset;
     bool m_pastingInProgress;
 
-    QStack<QImage> m_undoStack;
-    QStack<QImage> m_redoStack;
+    // Undo states keep the pixels together with the orientation they were shown in.
+    UndoHistory m_history;
+
+    mutable QImage m_previewProxy;
+    mutable qint64 m_previewProxyKey = 0;
+    mutable QSize  m_previewProxyBound;
+    mutable Orientation m_previewProxyOrientation;
 };
 
 #endif // GRAPHICSCANVAS_H
@@ -0,0 +1,91 @@
+#include "imagedisplayitem.h"
+
+#include <QPainter>
+#include <QPixmap>
+#include <QPixmapCache>
+
+namespace {
+
+// Enough for the tiles of a full screen view, which are painted on every scroll.
+const int kMinPixmapCacheKiB = 64 * 1024;
+
+class TileItem : public QGraphicsItem
+{
+public:
+    TileItem(const TiledImage *image, int index, QGraphicsItem *parent)
+        : QGraphicsItem(parent), m_image(image), m_index(index)
+    {
+        setPos(m_image->tileRect(m_index).topLeft());
+    }
+
+    QRectF boundingRect() const override
+    {
+        return QRectF(QPointF(0, 0), m_image->tileRect(m_index).size());
+    }
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override
+    {
+        Q_UNUSED(option);
+        Q_UNUSED(widget);
+        // The tile's cache key changes with every edit, and an undo brings back a tile with its old key
+        const QImage &tile = m_image->tile(m_index);
+        const QString key = QLatin1String("ImageDisplayItem:") + QString::number(tile.cacheKey());
+        QPixmap pixmap;
+        if (!QPixmapCache::find(key, &pixmap)) {
+            pixmap = QPixmap::fromImage(tile);
+            QPixmapCache::insert(key, pixmap);
+        }
+        painter->drawPixmap(0, 0, pixmap);
+    }
+
+private:
+    const TiledImage *m_image;
+    int m_index;
+};
+
+}
+
+ImageDisplayItem::ImageDisplayItem(const TiledImage *image, QGraphicsItem *parent)
+    : QGraphicsItem(parent), m_image(image)
+{
+    setFlag(QGraphicsItem::ItemHasNoContents, true);
+    if (QPixmapCache::cacheLimit() < kMinPixmapCacheKiB) {
+        QPixmapCache::setCacheLimit(kMinPixmapCacheKiB);
+    }
+}
+
+void ImageDisplayItem::reset()
+{
+    if (m_size == m_image->size() && m_tiles.size() == m_image->tileCount()) {
+        updateArea(m_image->rect());
+        return;
+    }
+    prepareGeometryChange();
+    qDeleteAll(m_tiles);
+    m_tiles.clear();
+    m_size = m_image->size();
+    for (int index = 0; index < m_image->tileCount(); ++index) {
+        m_tiles.append(new TileItem(m_image, index, this));
+    }
+}
+
+void ImageDisplayItem::updateArea(const QRect &rect)
+{
+    for (int index = 0; index < m_tiles.size(); ++index) {
+        if (m_image->tileRect(index).intersects(rect)) {
+            m_tiles[index]->update();
+        }
+    }
+}
+
+QRectF ImageDisplayItem::boundingRect() const
+{
+    return QRectF(QPointF(0, 0), m_size);
+}
+
+void ImageDisplayItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(painter);
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+}
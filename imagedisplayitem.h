@@ -0,0 +1,34 @@
+#ifndef IMAGEDISPLAYITEM_H
+#define IMAGEDISPLAYITEM_H
+
+#include <QGraphicsItem>
+#include <QVector>
+
+#include "tiledimage.h"
+
+// Shows a TiledImage on a scene with one child item per tile. The scene index
+// only paints the tiles in view, and a tile converts its pixels to a pixmap
+// when it is painted after they changed, so tiles never scrolled into view are
+// never converted. The pixmaps live in QPixmapCache, so the tiles least recently
+// painted give their memory back once the cache is full.
+class ImageDisplayItem : public QGraphicsItem
+{
+public:
+    explicit ImageDisplayItem(const TiledImage *image, QGraphicsItem *parent = nullptr);
+
+    // Call after the image was replaced: recreates the tile items if the image
+    // size changed and repaints all of them.
+    void reset();
+    // Repaints the tiles that intersect rect, in image coordinates.
+    void updateArea(const QRect &rect);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+private:
+    const TiledImage *m_image;
+    QSize m_size;
+    QVector<QGraphicsItem*> m_tiles;
+};
+
+#endif // IMAGEDISPLAYITEM_H
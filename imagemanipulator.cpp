@@ -1,76 +1,525 @@
 #include "imagemanipulator.h"
+#include "floatimage.h"
+#include "orientation.h"
+#include "simdkernels.h"
+#include "tilescheduler.h"
 
-ImageManipulator::ImageManipulator()
-{
+#include <QtMath>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+struct Pixel24{
+    uchar bytes[3];
+};
+
+// Rows addressed through a base pointer and a signed stride in bytes, so that a
+// negative stride walks the image bottom-up.
+struct RowView{
+    uchar* bits;
+    qptrdiff stride;
+
+    RowView(uchar* first, int height, qptrdiff bytesPerLine, bool bottomUp)
+        : bits(bottomUp ? first + (height - 1) * bytesPerLine : first),
+          stride(bottomUp ? -bytesPerLine : bytesPerLine)
+    {
+    }
+};
 
+// Transposes the pixels of one destination block: dst(x, y) = src(y, x).
+template <typename Pixel>
+void transposeBlock(const RowView& src, const RowView& dst, const QRect& rect){
+    for(int y = rect.top(); y <= rect.bottom(); ++y){
+        Pixel* out = reinterpret_cast<Pixel*>(dst.bits + y * dst.stride);
+        const uchar* column = src.bits + y * qptrdiff(sizeof(Pixel));
+        for(int x = rect.left(); x <= rect.right(); ++x){
+            out[x] = *reinterpret_cast<const Pixel*>(column + x * src.stride);
+        }
+    }
 }
 
-QImage ImageManipulator::rotateLeft(const QImage& src){
-    int image_height = src.height();
-    int image_width = src.width();
+void transposeBlock32(const RowView& src, const RowView& dst, const QRect& rect){
+    const qptrdiff srcStride = src.stride / 4;
+    const qptrdiff dstStride = dst.stride / 4;
+    const quint32* in = reinterpret_cast<const quint32*>(src.bits) + rect.left() * srcStride + rect.top();
+    quint32* out = reinterpret_cast<quint32*>(dst.bits) + rect.top() * dstStride + rect.left();
+    SimdKernels::transpose32(in, srcStride, out, dstStride, rect.width(), rect.height());
+}
 
-    QImage dst(image_height, image_width, src.format());
-    for(int y = 0; y < image_height; ++y){
-        for(int x = 0; x < image_width; ++x){
-            dst.setPixel(y, image_width - x - 1, src.pixel(x, y));
+// Transposed copy of src, optionally reading its rows bottom-up and writing the
+// result's rows bottom-up: reversing the source gives a clockwise rotation, reversing
+// the result a counterclockwise one. The image is cut into blocks whose source and
+// destination fit in L1 together, and the blocks run in parallel.
+QImage transposed(const QImage& src, bool reverseSource, bool reverseResult){
+    if(src.isNull()){
+        return src;
+    }
+    // Formats with pixels smaller than a byte take a detour through 8-bit indices.
+    if(src.depth() < 8){
+        const QImage indexed = src.convertToFormat(QImage::Format_Indexed8, src.colorTable());
+        return transposed(indexed, reverseSource, reverseResult).convertToFormat(src.format(), src.colorTable());
+    }
+
+    const int bytesPerPixel = src.depth() / 8;
+    QImage dst(src.height(), src.width(), src.format());
+    dst.setColorTable(src.colorTable());
+    dst.setDotsPerMeterX(src.dotsPerMeterY());
+    dst.setDotsPerMeterY(src.dotsPerMeterX());
+
+    const RowView in(const_cast<uchar*>(src.constBits()), src.height(), src.bytesPerLine(), reverseSource);
+    const RowView out(dst.bits(), dst.height(), dst.bytesPerLine(), reverseResult);
+    const int block = (bytesPerPixel > 4) ? 32 : 64;
+    TileScheduler::forEachTile(dst.size(), QSize(block, block), 0, [&](const TileScheduler::Tile& tile){
+        switch(bytesPerPixel){
+        case 1:
+            transposeBlock<quint8>(in, out, tile.rect);
+            break;
+        case 2:
+            transposeBlock<quint16>(in, out, tile.rect);
+            break;
+        case 3:
+            transposeBlock<Pixel24>(in, out, tile.rect);
+            break;
+        case 4:
+            transposeBlock32(in, out, tile.rect);
+            break;
+        default:
+            transposeBlock<quint64>(in, out, tile.rect);
+            break;
         }
+    });
+    return dst;
+}
+
+// Writes the count pixels of in to out in reverse order; in == out reverses in place.
+template <typename Pixel>
+void reverseRow(const uchar* in, uchar* out, int count){
+    Pixel* target = reinterpret_cast<Pixel*>(out);
+    if(in == out){
+        std::reverse(target, target + count);
+        return;
+    }
+    const Pixel* first = reinterpret_cast<const Pixel*>(in);
+    std::reverse_copy(first, first + count, target);
+}
+
+void reversePixels(const uchar* in, uchar* out, int count, int bytesPerPixel){
+    switch(bytesPerPixel){
+    case 1:
+        reverseRow<quint8>(in, out, count);
+        break;
+    case 2:
+        reverseRow<quint16>(in, out, count);
+        break;
+    case 3:
+        reverseRow<Pixel24>(in, out, count);
+        break;
+    case 4:
+        SimdKernels::reverse32(reinterpret_cast<const quint32*>(in), reinterpret_cast<quint32*>(out), count);
+        break;
+    default:
+        reverseRow<quint64>(in, out, count);
+        break;
+    }
+}
+
+// Copy of src with the pixels of every row reversed and, with reverseRows, the rows
+// in reverse order too: a horizontal flip or a half turn.
+QImage mirroredRows(const QImage& src, bool reverseRows){
+    if(src.isNull()){
+        return src;
+    }
+    // Pixels smaller than a byte cannot be reversed as whole bytes.
+    if(src.depth() < 8){
+        return src.mirrored(true, reverseRows);
     }
 
+    const int bytesPerPixel = src.depth() / 8;
+    const int height = src.height();
+    QImage dst(src.size(), src.format());
+    dst.setColorTable(src.colorTable());
+    dst.setDotsPerMeterX(src.dotsPerMeterX());
+    dst.setDotsPerMeterY(src.dotsPerMeterY());
+
+    const uchar* in = src.constBits();
+    uchar* out = dst.bits();
+    const qptrdiff inStride = src.bytesPerLine();
+    const qptrdiff outStride = dst.bytesPerLine();
+    TileScheduler::forEachBand(src.size(), src.bytesPerLine(), 0, [&](const TileScheduler::Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            const int target = reverseRows ? height - 1 - y : y;
+            reversePixels(in + y * inStride, out + target * outStride, src.width(), bytesPerPixel);
+        }
+    });
     return dst;
 }
 
-QImage ImageManipulator::rotateRight(const QImage& src){
-    int image_height = src.height();
-    int image_width = src.width();
+// In-place counterpart of mirroredRows(). With reverseRows, each band handles pairs
+// of rows from the top and bottom halves and swaps them through a one-row buffer.
+void mirrorRowsInPlace(QImage& image, bool reverseRows){
+    if(image.isNull()){
+        return;
+    }
+    if(image.depth() < 8){
+        image = image.mirrored(true, reverseRows);
+        return;
+    }
+
+    const int bytesPerPixel = image.depth() / 8;
+    const int width = image.width();
+    const int height = image.height();
+    const qptrdiff stride = image.bytesPerLine();
+    uchar* bits = image.bits();
+    if(!reverseRows){
+        TileScheduler::forEachBand(image.size(), image.bytesPerLine(), 0, [&](const TileScheduler::Tile& tile){
+            for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+                uchar* row = bits + y * stride;
+                reversePixels(row, row, width, bytesPerPixel);
+            }
+        });
+        return;
+    }
 
-    QImage dst(image_height, image_width, src.format());
-    for(int y = 0; y < image_height; ++y){
-        for(int x = 0; x < image_width; ++x){
-            dst.setPixel(image_height - y - 1, x, src.pixel(x, y));
+    const int rowBytes = width * bytesPerPixel;
+    const int pairs = (height + 1) / 2;
+    TileScheduler::forEachBand(QSize(width, pairs), image.bytesPerLine(), 0, [&](const TileScheduler::Tile& tile){
+        QVector<uchar> scratch(rowBytes);
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            uchar* top = bits + y * stride;
+            uchar* bottom = bits + (height - 1 - y) * stride;
+            if(top == bottom){
+                reversePixels(top, top, width, bytesPerPixel);
+                continue;
+            }
+            reversePixels(top, scratch.data(), width, bytesPerPixel);
+            reversePixels(bottom, top, width, bytesPerPixel);
+            memcpy(bottom, scratch.constData(), size_t(rowBytes));
         }
+    });
+}
+
+// Source positions of count output pixels for the remap kernels, starting at (x, y)
+// and stepping by (dx, dy). The steps are exact in 32.32 fixed point, so positions at
+// the far end of a row are as accurate as the first one.
+void remapCoordinates(qreal x, qreal y, qreal dx, qreal dy, int count, qint32* xs, qint32* ys){
+    const qreal scale = 4294967296.0;
+    const int shift = 32 - SimdKernels::RemapFractionBits;
+    const qint64 half = qint64(1) << (shift - 1);
+    const qint64 startX = qRound64(x * scale) + half;
+    const qint64 startY = qRound64(y * scale) + half;
+    const qint64 stepX = qRound64(dx * scale);
+    const qint64 stepY = qRound64(dy * scale);
+    for(int i = 0; i < count; ++i){
+        xs[i] = qint32((startX + i * stepX) >> shift);
+        ys[i] = qint32((startY + i * stepY) >> shift);
     }
+}
 
-    return dst;
+// Format of a rotated src, whose uncovered corners are transparent: the source
+// format if it has alpha, otherwise the nearest one that does. Indexed images
+// cannot hold the blended colors and come back as ARGB32.
+QImage::Format rotatedFormat(const QImage& src){
+    if(src.colorCount() > 0){
+        return QImage::Format_ARGB32;
+    }
+    if(src.hasAlphaChannel()){
+        return src.format();
+    }
+    switch(src.format()){
+    case QImage::Format_RGBX8888:
+        return QImage::Format_RGBA8888;
+    case QImage::Format_BGR30:
+        return QImage::Format_A2BGR30_Premultiplied;
+    case QImage::Format_RGB30:
+        return QImage::Format_A2RGB30_Premultiplied;
+    case QImage::Format_RGBX64:
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    case QImage::Format_Grayscale16:
+#endif
+        return QImage::Format_RGBA64;
+    default:
+        return QImage::Format_ARGB32;
+    }
 }
 
-QImage ImageManipulator::rotate180(const QImage& src){
-    int image_height = src.height();
-    int image_width = src.width();
+// Keys' cubic with a = -0.5, as SimdKernels::remapBicubic() uses.
+float keysWeight(float x){
+    const float a = -0.5f;
+    x = qAbs(x);
+    if(x < 1){
+        return ((a + 2) * x - (a + 3)) * x * x + 1;
+    }
+    if(x < 2){
+        return ((a * x - 5 * a) * x + 8 * a) * x - 4 * a;
+    }
+    return 0;
+}
 
-    QImage dst(image_width, image_height, src.format());
-    for(int y = 0; y < image_height; ++y){
-        for(int x = 0; x < image_width; ++x){
-            dst.setPixel(image_width - x - 1, image_height - y - 1, src.pixel(x, y));
+// Samples the premultiplied planes of src at (x, y), pixel centers on whole numbers
+// and pixels outside src transparent: the float counterpart of the remap kernels,
+// for sources with more than 8 bits per channel.
+void sampleFloat(const FloatImage& src, qreal x, qreal y, ImageManipulator::Interpolation interpolation, float* values){
+    const int width = src.width();
+    const int height = src.height();
+    const auto pixel = [&](int c, int px, int py){
+        return (px < 0 || py < 0 || px >= width || py >= height)
+                ? 0.0f : src.constLine(FloatImage::Channel(c), py)[px];
+    };
+    switch(interpolation){
+    case ImageManipulator::Interpolation::Nearest:{
+        const int px = qFloor(x + 0.5);
+        const int py = qFloor(y + 0.5);
+        for(int c = 0; c < 4; ++c){
+            values[c] = pixel(c, px, py);
+        }
+        break;
+    }
+    case ImageManipulator::Interpolation::Bicubic:{
+        const int x0 = qFloor(x);
+        const int y0 = qFloor(y);
+        float wx[4], wy[4];
+        for(int k = 0; k < 4; ++k){
+            wx[k] = keysWeight(float(x - (x0 - 1 + k)));
+            wy[k] = keysWeight(float(y - (y0 - 1 + k)));
+        }
+        for(int c = 0; c < 4; ++c){
+            float sum = 0;
+            for(int j = 0; j < 4; ++j){
+                float row = 0;
+                for(int k = 0; k < 4; ++k){
+                    row += wx[k] * pixel(c, x0 - 1 + k, y0 - 1 + j);
+                }
+                sum += wy[j] * row;
+            }
+            values[c] = sum;
+        }
+        // Ringing is clamped so that the color channels stay below alpha.
+        values[3] = qBound(0.0f, values[3], 1.0f);
+        for(int c = 0; c < 3; ++c){
+            values[c] = qBound(0.0f, values[c], values[3]);
         }
+        break;
+    }
+    default:{
+        const int x0 = qFloor(x);
+        const int y0 = qFloor(y);
+        const float fx = float(x - x0);
+        const float fy = float(y - y0);
+        for(int c = 0; c < 4; ++c){
+            const float top = pixel(c, x0, y0) * (1 - fx) + pixel(c, x0 + 1, y0) * fx;
+            const float bottom = pixel(c, x0, y0 + 1) * (1 - fx) + pixel(c, x0 + 1, y0 + 1) * fx;
+            values[c] = top * (1 - fy) + bottom * fy;
+        }
+        break;
+    }
     }
+}
+
+// Float path of ImageManipulator::rotate(): each output row starts at (x, y) in the
+// source and steps by (dx, dy) per pixel.
+QImage rotateFloat(const QImage& src, const QSize& size, qreal startX, qreal startY, qreal rowX, qreal rowY,
+                   qreal dx, qreal dy, ImageManipulator::Interpolation interpolation){
+    FloatImage in(src);
+    const int inWidth = in.width();
+    TileScheduler::forEachBand(in.size(), inWidth * 4 * int(sizeof(float)), 0, [&](const TileScheduler::Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            const float* alpha = in.constLine(FloatImage::Alpha, y);
+            for(int c = FloatImage::Red; c <= FloatImage::Blue; ++c){
+                float* line = in.line(FloatImage::Channel(c), y);
+                for(int x = 0; x < inWidth; ++x){
+                    line[x] *= alpha[x];
+                }
+            }
+        }
+    });
 
+    FloatImage out(size.width(), size.height());
+    const int width = size.width();
+    TileScheduler::forEachBand(size, width * 4 * int(sizeof(float)), 0, [&](const TileScheduler::Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            float* const lines[4] = {
+                out.line(FloatImage::Red, y), out.line(FloatImage::Green, y),
+                out.line(FloatImage::Blue, y), out.line(FloatImage::Alpha, y)
+            };
+            const qreal x0 = startX + rowX * y;
+            const qreal y0 = startY + rowY * y;
+            for(int x = 0; x < width; ++x){
+                float values[4];
+                sampleFloat(in, x0 + dx * x, y0 + dy * x, interpolation, values);
+                const float alpha = values[3];
+                for(int c = 0; c < 3; ++c){
+                    lines[c][x] = (alpha > 0.0f) ? values[c] / alpha : 0.0f;
+                }
+                lines[3][x] = alpha;
+            }
+        }
+    });
+    QImage dst = out.toImage(rotatedFormat(src));
+    dst.setDotsPerMeterX(src.dotsPerMeterX());
+    dst.setDotsPerMeterY(src.dotsPerMeterY());
     return dst;
 }
 
+}
+
+ImageManipulator::ImageManipulator()
+{
+
+}
+
+QImage ImageManipulator::rotateLeft(const QImage& src){
+    return transposed(src, false, true);
+}
+
+QImage ImageManipulator::rotateRight(const QImage& src){
+    return transposed(src, true, false);
+}
+
+QImage ImageManipulator::rotate180(const QImage& src){
+    return mirroredRows(src, true);
+}
+
 QImage ImageManipulator::flipHorizontally(const QImage& src){
-    int image_height = src.height();
-    int image_width = src.width();
+    return mirroredRows(src, false);
+}
 
-    QImage dst(image_width, image_height, src.format());
-    for(int y = 0; y < image_height; ++y){
-        for(int x = 0; x < image_width; ++x){
-            dst.setPixel(image_width - x - 1, y, src.pixel(x, y));
-        }
+QImage ImageManipulator::flipVertically(const QImage& src){
+    if(src.isNull()){
+        return src;
     }
 
+    const int height = src.height();
+    QImage dst(src.size(), src.format());
+    dst.setColorTable(src.colorTable());
+    dst.setDotsPerMeterX(src.dotsPerMeterX());
+    dst.setDotsPerMeterY(src.dotsPerMeterY());
+
+    const uchar* in = src.constBits();
+    uchar* out = dst.bits();
+    const qptrdiff stride = src.bytesPerLine();
+    TileScheduler::forEachBand(src.size(), src.bytesPerLine(), 0, [&](const TileScheduler::Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            memcpy(out + (height - 1 - y) * stride, in + y * stride, size_t(stride));
+        }
+    });
     return dst;
 }
 
-QImage ImageManipulator::flipVertically(const QImage& src){
-    int image_height = src.height();
-    int image_width = src.width();
+QImage ImageManipulator::transform(const QImage& src, const Orientation& orientation){
+    if(orientation.swapsAxes()){
+        // A mirrored x reads the source bottom-up, a mirrored y writes the result bottom-up.
+        return transposed(src, orientation.mirrorsX(), orientation.mirrorsY());
+    }
+    if(orientation.mirrorsX()){
+        return mirroredRows(src, orientation.mirrorsY());
+    }
+    if(orientation.mirrorsY()){
+        return flipVertically(src);
+    }
+    return src;
+}
+
+QImage ImageManipulator::rotate(const QImage& src, qreal degrees, RotationBounds bounds, Interpolation interpolation){
+    if(src.isNull()){
+        return src;
+    }
+    qreal angle = std::fmod(degrees, qreal(360));
+    if(angle < 0){
+        angle += 360;
+    }
 
-    QImage dst(image_width, image_height, src.format());
-    for(int y = 0; y < image_height; ++y){
-        for(int x = 0; x < image_width; ++x){
-            dst.setPixel(x,image_height - y - 1, src.pixel(x, y));
+    const int quarterTurns = qRound(angle / 90);
+    if(qAbs(angle - 90 * quarterTurns) < 1e-9){
+        switch(quarterTurns % 4){
+        case 0:
+            return src;
+        case 2:
+            return rotate180(src);
+        default:
+            // Cropping a non-square image to its own size needs the general path.
+            if(bounds == RotationBounds::Expand || src.width() == src.height()){
+                return (quarterTurns % 4 == 1) ? rotateRight(src) : rotateLeft(src);
+            }
         }
     }
 
-    return dst;
+    const qreal radians = qDegreesToRadians(angle);
+    const qreal c = qCos(radians);
+    const qreal s = qSin(radians);
+    QSize size = src.size();
+    if(bounds == RotationBounds::Expand){
+        // The slack keeps rounding noise from adding a row or column.
+        size = QSize(qCeil(qAbs(c) * src.width() + qAbs(s) * src.height() - 1e-6),
+                     qCeil(qAbs(s) * src.width() + qAbs(c) * src.height() - 1e-6));
+    }
+
+    // Inverse mapping: every output pixel is rotated back by -angle about the centers.
+    const qreal sourceCenterX = (src.width() - 1) / 2.0;
+    const qreal sourceCenterY = (src.height() - 1) / 2.0;
+    const qreal centerX = (size.width() - 1) / 2.0;
+    const qreal centerY = (size.height() - 1) / 2.0;
+    if(FloatImage::isHighBitDepth(src.format())){
+        return rotateFloat(src, size, sourceCenterX - c * centerX - s * centerY, sourceCenterY + s * centerX - c * centerY,
+                           s, c, c, -s, interpolation);
+    }
+
+    const QImage source = src.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const SimdKernels::RemapSource remapSource = {
+        reinterpret_cast<const QRgb*>(source.constBits()), source.bytesPerLine() / 4, source.width(), source.height(), false
+    };
+    QImage dst(size, QImage::Format_ARGB32_Premultiplied);
+    dst.setDotsPerMeterX(src.dotsPerMeterX());
+    dst.setDotsPerMeterY(src.dotsPerMeterY());
+
+    uchar* bits = dst.bits();
+    const qptrdiff stride = dst.bytesPerLine();
+    const int width = size.width();
+    TileScheduler::forEachBand(size, dst.bytesPerLine(), 0, [&](const TileScheduler::Tile& tile){
+        QVector<qint32> xs(width), ys(width);
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            const qreal dy = y - centerY;
+            remapCoordinates(sourceCenterX - c * centerX + s * dy, sourceCenterY + s * centerX + c * dy,
+                             c, -s, width, xs.data(), ys.data());
+            QRgb* out = reinterpret_cast<QRgb*>(bits + y * stride);
+            switch(interpolation){
+            case Interpolation::Nearest:
+                SimdKernels::remapNearest(remapSource, xs.constData(), ys.constData(), width, out);
+                break;
+            case Interpolation::Bicubic:
+                SimdKernels::remapBicubic(remapSource, xs.constData(), ys.constData(), width, out);
+                break;
+            default:
+                SimdKernels::remapBilinear(remapSource, xs.constData(), ys.constData(), width, out);
+                break;
+            }
+        }
+    });
+    return dst.convertToFormat(rotatedFormat(src));
+}
+
+void ImageManipulator::rotate180InPlace(QImage& image){
+    mirrorRowsInPlace(image, true);
+}
+
+void ImageManipulator::flipHorizontallyInPlace(QImage& image){
+    mirrorRowsInPlace(image, false);
+}
+
+void ImageManipulator::flipVerticallyInPlace(QImage& image){
+    if(image.isNull()){
+        return;
+    }
+
+    const int height = image.height();
+    const qptrdiff stride = image.bytesPerLine();
+    uchar* bits = image.bits();
+    TileScheduler::forEachBand(QSize(image.width(), height / 2), image.bytesPerLine(), 0, [&](const TileScheduler::Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            uchar* top = bits + y * stride;
+            std::swap_ranges(top, top + stride, bits + (height - 1 - y) * stride);
+        }
+    });
 }
@@ -3,8 +3,24 @@
 
 #include <QImage>
 
+class Orientation;
+
 class ImageManipulator
 {
+public:
+    enum class Interpolation{
+        Nearest,
+        Bilinear,
+        Bicubic
+    };
+
+    // Size of a rotated image: the bounding box of the whole rotated source, or the
+    // source size with the corners that leave it cut off.
+    enum class RotationBounds{
+        Expand,
+        Crop
+    };
+
 public:
     ImageManipulator();
 public:
@@ -13,6 +29,20 @@ public:
     static QImage rotate180(const QImage& src);
     static QImage flipHorizontally(const QImage& src);
     static QImage flipVertically(const QImage& src);
+    // Any rotation or reflection in one pass; the identity returns src itself.
+    static QImage transform(const QImage& src, const Orientation& orientation);
+    // Clockwise rotation by any angle about the image center. Areas the source does
+    // not cover are transparent, so opaque formats come back as the nearest format
+    // with alpha; 16-bit sources are sampled without going through 8 bits. Quarter
+    // turns that keep every pixel are done exactly.
+    static QImage rotate(const QImage& src, qreal degrees, RotationBounds bounds = RotationBounds::Expand,
+                         Interpolation interpolation = Interpolation::Bilinear);
+
+    // Same as above on the caller's buffer, without allocating a second image. The
+    // image detaches first if its data is shared.
+    static void rotate180InPlace(QImage& image);
+    static void flipHorizontallyInPlace(QImage& image);
+    static void flipVerticallyInPlace(QImage& image);
 };
 
 #endif // IMAGEMANIPULATOR_H
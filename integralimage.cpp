@@ -0,0 +1,140 @@
+#include "integralimage.h"
+#include "tilescheduler.h"
+
+IntegralImage::IntegralImage()
+    : m_width(0), m_height(0), m_format(QImage::Format_Invalid)
+{
+}
+
+IntegralImage::IntegralImage(const QImage& src)
+    : m_width(src.width()), m_height(src.height()), m_format(src.format())
+{
+    if(src.isNull()){
+        m_width = 0;
+        m_height = 0;
+        m_format = QImage::Format_Invalid;
+        return;
+    }
+    const QImage in = (m_format == QImage::Format_ARGB32 || m_format == QImage::Format_RGB32)
+            ? src : src.convertToFormat(QImage::Format_ARGB32);
+
+    const int tableStride = stride();
+    m_table.fill(0, tableStride * (m_height + 1));
+    quint32* table = m_table.data();
+
+    // Each band first sums its own rows as if it started at the top of the image.
+    TileScheduler::forEachBand(in.size(), in.bytesPerLine(), 0, [&](const TileScheduler::Tile& band){
+        for(int y = band.rect.top(); y <= band.rect.bottom(); ++y){
+            const QRgb* line = reinterpret_cast<const QRgb*>(in.constScanLine(y));
+            const quint32* above = table + y * tableStride;
+            quint32* row = table + (y + 1) * tableStride;
+            const bool firstRow = (y == band.rect.top());
+
+            quint32 sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+            for(int x = 0; x < m_width; ++x){
+                const QRgb p = line[x];
+                sum0 += p & 0xff;
+                sum1 += (p >> 8) & 0xff;
+                sum2 += (p >> 16) & 0xff;
+                sum3 += p >> 24;
+
+                const int i = 4 * (x + 1);
+                row[i]     = (firstRow ? 0 : above[i])     + sum0;
+                row[i + 1] = (firstRow ? 0 : above[i + 1]) + sum1;
+                row[i + 2] = (firstRow ? 0 : above[i + 2]) + sum2;
+                row[i + 3] = (firstRow ? 0 : above[i + 3]) + sum3;
+            }
+        }
+    });
+
+    // Then the sums above each band are carried down: the last row of every band
+    // sequentially, the remaining rows of all bands in parallel.
+    const int bandHeight = TileScheduler::bandHeight(in.bytesPerLine());
+    QVector<int> bandEnds;
+    for(int y = 0; y < m_height; y += bandHeight){
+        bandEnds.append(qMin(y + bandHeight, m_height));
+    }
+    for(int b = 1; b < bandEnds.size(); ++b){
+        const quint32* carry = table + bandEnds[b - 1] * tableStride;
+        quint32* last = table + bandEnds[b] * tableStride;
+        for(int i = 0; i < tableStride; ++i){
+            last[i] += carry[i];
+        }
+    }
+    TileScheduler::forEachBand(in.size(), in.bytesPerLine(), 0, [&](const TileScheduler::Tile& band){
+        if(band.rect.top() == 0){
+            return;
+        }
+        const quint32* carry = table + band.rect.top() * tableStride;
+        for(int y = band.rect.top(); y < band.rect.bottom(); ++y){
+            quint32* row = table + (y + 1) * tableStride;
+            for(int i = 0; i < tableStride; ++i){
+                row[i] += carry[i];
+            }
+        }
+    });
+}
+
+bool IntegralImage::isNull() const
+{
+    return m_width <= 0 || m_height <= 0;
+}
+
+int IntegralImage::width() const
+{
+    return m_width;
+}
+
+int IntegralImage::height() const
+{
+    return m_height;
+}
+
+QImage::Format IntegralImage::format() const
+{
+    return m_format;
+}
+
+quint32 IntegralImage::sum(const QRect& rect, Channel channel) const
+{
+    const QRect r = rect.intersected(QRect(0, 0, m_width, m_height));
+    if(r.isEmpty()){
+        return 0;
+    }
+
+    const int tableStride = stride();
+    const int c = static_cast<int>(channel);
+    const quint32* top = m_table.constData() + r.top() * tableStride;
+    const quint32* bottom = m_table.constData() + (r.bottom() + 1) * tableStride;
+    const int left = 4 * r.left() + c;
+    const int right = 4 * (r.right() + 1) + c;
+
+    return bottom[right] - bottom[left] - top[right] + top[left];
+}
+
+QRgb IntegralImage::mean(const QRect& rect) const
+{
+    const QRect r = rect.intersected(QRect(0, 0, m_width, m_height));
+    if(r.isEmpty()){
+        return 0;
+    }
+
+    const quint32 area = quint32(r.width()) * quint32(r.height());
+    const quint32 half = area / 2;
+    QRgb result = 0;
+    for(int c = 0; c < 4; ++c){
+        const quint32 value = (sum(r, static_cast<Channel>(c)) + half) / area;
+        result |= value << (8 * c);
+    }
+    return result;
+}
+
+const quint32* IntegralImage::constData() const
+{
+    return m_table.constData();
+}
+
+int IntegralImage::stride() const
+{
+    return 4 * (m_width + 1);
+}
@@ -0,0 +1,51 @@
+#ifndef INTEGRALIMAGE_H
+#define INTEGRALIMAGE_H
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+// Summed-area table of a 32-bit image: any axis-aligned rectangle sum of a
+// channel is available in four lookups, independent of the rectangle size.
+//
+// The entries are 32-bit and allowed to wrap; rectangle sums stay exact as long
+// as the rectangle holds fewer than 2^32 / 255 (about 16.8 million) pixels.
+class IntegralImage
+{
+public:
+    // Channels in QRgb byte order.
+    enum class Channel{
+        Blue,
+        Green,
+        Red,
+        Alpha
+    };
+
+public:
+    IntegralImage();
+    explicit IntegralImage(const QImage& src);
+
+    // True for a table of a null image; the filters taking a table return a null image for it.
+    bool isNull() const;
+    int width() const;
+    int height() const;
+    QImage::Format format() const;
+
+    // Sum of a channel over rect, clipped to the image.
+    quint32 sum(const QRect& rect, Channel channel) const;
+    // Average color over rect, clipped to the image. Returns 0 for an empty rect.
+    QRgb mean(const QRect& rect) const;
+
+    // Raw table: (width() + 1) x (height() + 1) entries of four channel sums,
+    // entry (x, y) holding the sums over [0, x) x [0, y).
+    const quint32* constData() const;
+    int stride() const;
+
+private:
+    int m_width;
+    int m_height;
+    QImage::Format m_format;
+    QVector<quint32> m_table;
+};
+
+#endif // INTEGRALIMAGE_H
@@ -0,0 +1,152 @@
+#include "jpegexif.h"
+
+namespace {
+
+const int kOrientationTag = 0x0112;
+const int kShortType = 3;
+
+struct Reader{
+    const QByteArray& data;
+    bool bigEndian;
+
+    int read16(int offset) const{
+        const uchar a = uchar(data.at(offset));
+        const uchar b = uchar(data.at(offset + 1));
+        return bigEndian ? (a << 8) | b : (b << 8) | a;
+    }
+
+    quint32 read32(int offset) const{
+        const quint32 a = quint32(read16(offset));
+        const quint32 b = quint32(read16(offset + 2));
+        return bigEndian ? (a << 16) | b : (b << 16) | a;
+    }
+};
+
+int readBigEndian16(const QByteArray& data, int offset){
+    return (uchar(data.at(offset)) << 8) | uchar(data.at(offset + 1));
+}
+
+// Offset of the value of the Orientation entry in IFD0 of the EXIF segment at
+// segment, or -1. bigEndian receives the byte order of the TIFF data.
+int orientationOffset(const QByteArray& jpeg, int segment, int length, bool& bigEndian){
+    const int tiff = segment + 10;
+    const int end = segment + 2 + length;
+    if(length < 16 || jpeg.mid(segment + 4, 6) != QByteArray("Exif\0\0", 6)){
+        return -1;
+    }
+    const QByteArray order = jpeg.mid(tiff, 2);
+    if(order != "MM" && order != "II"){
+        return -1;
+    }
+    bigEndian = (order == "MM");
+    const Reader reader{jpeg, bigEndian};
+    const qint64 ifd = qint64(tiff) + reader.read32(tiff + 4);
+    if(ifd + 2 > end){
+        return -1;
+    }
+    const int entries = reader.read16(int(ifd));
+    for(int i = 0; i < entries; ++i){
+        const qint64 entry = ifd + 2 + 12 * qint64(i);
+        if(entry + 12 > end){
+            return -1;
+        }
+        if(reader.read16(int(entry)) == kOrientationTag){
+            return reader.read16(int(entry) + 2) == kShortType ? int(entry) + 8 : -1;
+        }
+    }
+    return -1;
+}
+
+// Walks the marker segments before the image data; calls visit(marker, offset,
+// length) for each until it returns false. Returns false if the file is malformed.
+template <typename Visitor>
+bool forEachSegment(const QByteArray& jpeg, Visitor visit){
+    if(jpeg.size() < 4 || uchar(jpeg.at(0)) != 0xff || uchar(jpeg.at(1)) != 0xd8){
+        return false;
+    }
+    int offset = 2;
+    while(offset + 4 <= jpeg.size()){
+        if(uchar(jpeg.at(offset)) != 0xff){
+            return false;
+        }
+        const int marker = uchar(jpeg.at(offset + 1));
+        // Start of scan: the entropy-coded data follows.
+        if(marker == 0xda || marker == 0xd9){
+            return true;
+        }
+        const int length = readBigEndian16(jpeg, offset + 2);
+        if(length < 2 || offset + 2 + length > jpeg.size()){
+            return false;
+        }
+        if(!visit(marker, offset, length)){
+            return true;
+        }
+        offset += 2 + length;
+    }
+    return false;
+}
+
+}
+
+int JpegExif::orientation(const QByteArray& jpeg)
+{
+    int value = 1;
+    forEachSegment(jpeg, [&](int marker, int offset, int length){
+        bool bigEndian = true;
+        const int position = (marker == 0xe1) ? orientationOffset(jpeg, offset, length, bigEndian) : -1;
+        if(position < 0){
+            return true;
+        }
+        value = Reader{jpeg, bigEndian}.read16(position);
+        return false;
+    });
+    return value;
+}
+
+QByteArray JpegExif::withOrientation(const QByteArray& jpeg, int value)
+{
+    int exifSegment = -1;
+    int position = -1;
+    bool bigEndian = true;
+    // A new EXIF segment goes after the JFIF header, which has to come first.
+    int insertAt = 2;
+    const bool valid = forEachSegment(jpeg, [&](int marker, int offset, int length){
+        if(marker == 0xe0 && offset == 2){
+            insertAt = offset + 2 + length;
+        }
+        if(marker == 0xe1 && jpeg.mid(offset + 4, 6) == QByteArray("Exif\0\0", 6)){
+            exifSegment = offset;
+            position = orientationOffset(jpeg, offset, length, bigEndian);
+            return false;
+        }
+        return true;
+    });
+    if(!valid){
+        return QByteArray();
+    }
+
+    QByteArray result = jpeg;
+    if(exifSegment >= 0){
+        // Adding an entry would move the offsets of everything after IFD0.
+        if(position < 0){
+            return QByteArray();
+        }
+        result[position] = char(bigEndian ? 0 : value);
+        result[position + 1] = char(bigEndian ? value : 0);
+        return result;
+    }
+
+    // APP1 with a big-endian TIFF header and an IFD0 holding only the orientation.
+    static const char segment[] = {
+        '\xff', '\xe1', 0, 34,
+        'E', 'x', 'i', 'f', 0, 0,
+        'M', 'M', 0, 42, 0, 0, 0, 8,
+        0, 1,
+        0x01, 0x12, 0, kShortType, 0, 0, 0, 1, 0, 0, 0, 0,
+        0, 0, 0, 0
+    };
+    QByteArray exif(segment, sizeof(segment));
+    exif[29] = char(value);
+    result.insert(insertAt, exif);
+    return result;
+}
@@ -0,0 +1,19 @@
+#ifndef JPEGEXIF_H
+#define JPEGEXIF_H
+
+#include <QByteArray>
+
+// Edits the EXIF metadata of JPEG files without touching the compressed image
+// data, so rotating or flipping a photo costs no generation loss.
+class JpegExif
+{
+public:
+    // The EXIF Orientation tag stored in jpeg, or 1 when there is none.
+    static int orientation(const QByteArray& jpeg);
+    // jpeg with its Orientation tag set to value (1 to 8). A file without EXIF
+    // data gets a minimal EXIF segment. Returns an empty array if jpeg is not a
+    // JPEG file or its EXIF data has no Orientation tag that could be patched.
+    static QByteArray withOrientation(const QByteArray& jpeg, int value);
+};
+
+#endif // JPEGEXIF_H
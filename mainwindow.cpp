@@ -1,9 +1,11 @@
 #include "mainwindow.h"
 #include "filterdialog.h"
 #include "resizedialog.h"
+#include "rotatedialog.h"
 //#include "canvas.h"
 #include "graphicscanvas.h"
 #include "imagemanipulator.h"
+#include "orientation.h"
 #include "filterapplyer.h"
 #include "databasemanager.h"
 
@@ -25,6 +27,8 @@
 #include <QCoreApplication>
 #include <fstream>
 #include <QCryptographicHash>
+#include <QGuiApplication>
+#include <QScreen>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -37,6 +41,10 @@ MainWindow::MainWindow(QWidget *parent)
     , m_currentColorButton{nullptr}
 //    , m_canvas{new Canvas(this)}
     , m_canvas{new GraphicsCanvas}
+    , m_activeJob{nullptr}
+    , m_activeJobKey{0}
+    , m_jobProgress{nullptr}
+    , m_cancelJobButton{nullptr}
 {
     buildMenuBar();
     createMainToolBar();
@@ -48,6 +56,7 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Optionally show a status bar
     this->statusBar()->showMessage("Ready");
+    buildJobIndicator();
 
     auto db = DatabaseManager::instance();
     db->openDatabase("projects_library");
@@ -114,6 +123,7 @@ void MainWindow::createMainToolBar(){
     buildGeometricOperationsSection();
     buildSizeSelector();
     buildToolsSection();
+    buildFillOptions();
     buildBrushMenu();
     buildColorMenu();
     buildFilterMenu();
@@ -141,7 +151,11 @@ void MainWindow::buildGeometricOperationsSection()
 
     rotateMenu->addAction(rotateLeft);
     rotateMenu->addAction(rotateRight);
+    QAction *rotateByAngle = new QAction("Custom angle...", rotateMenu);
+    connect(rotateByAngle, &QAction::triggered, this, &MainWindow::onRotateByAngleClicked);
+
     rotateMenu->addAction(rotate180);
+    rotateMenu->addAction(rotateByAngle);
     rotateBtn->setMenu(rotateMenu);
     rotateBtn->setPopupMode(QToolButton::MenuButtonPopup);
 
@@ -242,6 +256,26 @@ void MainWindow::buildToolsSection()
     m_toolBar->addSeparator();
 }
 
+void MainWindow::buildFillOptions()
+{
+    QSpinBox *toleranceSelector = new QSpinBox(this);
+    toleranceSelector->setRange(0, 255);
+    toleranceSelector->setValue(0);
+    toleranceSelector->setToolTip("Fill tolerance");
+
+    QComboBox *connectivitySelector = new QComboBox(this);
+    connectivitySelector->addItem("4-way");
+    connectivitySelector->addItem("8-way");
+    connectivitySelector->setToolTip("Fill through edges only, or through corners too");
+
+    connect(toleranceSelector, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::onFillToleranceChanged);
+    connect(connectivitySelector, QOverload<int>::of(&QComboBox::activated), this, &MainWindow::onFillConnectivityChanged);
+
+    m_toolBar->addWidget(toleranceSelector);
+    m_toolBar->addWidget(connectivitySelector);
+    m_toolBar->addSeparator();
+}
+
 void MainWindow::buildBrushMenu()
 {
     QComboBox *brushSelector = new QComboBox(this);
@@ -368,13 +402,13 @@ void MainWindow::showResizeDialog(){
         if (pixelBased) {
             int w = dialog.pixelWidth();
             int h = dialog.pixelHeight();
-            m_canvas->resizeImage(w, h);
+            m_canvas->resizeImage(w, h, dialog.filter(), dialog.linearLight());
         }
         else if (percentBased) {
             int wp = dialog.percentageWidth();
             int hp = dialog.percentageHeight();
-            auto image = m_canvas->getImage();
-            m_canvas->resizeImage(image.width() * wp / 100, image.height() * hp / 100);
+            const QSize size = m_canvas->imageSize();
+            m_canvas->resizeImage(size.width() * wp / 100, size.height() * hp / 100, dialog.filter(), dialog.linearLight());
         }
         else {
             return;
@@ -384,15 +418,28 @@ void MainWindow::showResizeDialog(){
     }
 }
 
+void MainWindow::showRotateDialog(){
+    RotateDialog dialog(this);
+
+    if (dialog.exec() == QDialog::Accepted) {
+        m_canvas->rotateImage(dialog.angle(), dialog.bounds(), dialog.interpolation());
+        m_canvas->update();
+    }
+}
+
 void MainWindow::showFiltersDialog()
 {
-    FilterDialog dialog(this);
+    // The live preview renders from a proxy no larger than the screen
+    const QSize size = m_canvas->imageSize();
+    const QImage proxy = m_canvas->previewProxy(QGuiApplication::primaryScreen()->availableSize());
+    const double proxyScale = size.width() > 0 ? double(proxy.width()) / size.width() : 1.0;
+    FilterDialog dialog(proxy, proxyScale, this);
 
     if (dialog.exec() == QDialog::Accepted) {
         // User clicked OK
         QString chosenFilter = dialog.selectedFilter();
         if (!chosenFilter.isEmpty()) {
-            onFilterChosen(chosenFilter);
+            onFilterChosen(chosenFilter, dialog.parameter());
         } else {
             //QMessageBox::information(this, "Filter Dialog", "No filter was selected.");
         }
@@ -402,36 +449,113 @@ void MainWindow::showFiltersDialog()
     }
 }
 
-void MainWindow::onFilterChosen(const QString& name){
-    m_canvas->pushUndoState();
-    if(name == "Grayscale"){
-        m_canvas->setImage(FilterApplyer::applyGrayscale(m_canvas->getImage()));
-    } else if(name == "Sepia"){
-        m_canvas->setImage(FilterApplyer::applySepia(m_canvas->getImage()));
-    } else if(name == "Invert"){
-        m_canvas->setImage(FilterApplyer::applyInvert(m_canvas->getImage()));
-    } else if(name == "Blur"){
-        m_canvas->setImage(FilterApplyer::applyBlur(m_canvas->getImage()));
-    } else if(name == "Brightness"){
-        m_canvas->setImage(FilterApplyer::applyBrightnessFilter(m_canvas->getImage(), 30));
-    } else if(name == "Contrast"){
-        m_canvas->setImage(FilterApplyer::applyContrast(m_canvas->getImage(), 1.2));
-    } else if(name == "Saturation"){
-        m_canvas->setImage(FilterApplyer::applySaturation(m_canvas->getImage(), true));
-    } else if(name == "Desaturation"){
-        m_canvas->setImage(FilterApplyer::applySaturation(m_canvas->getImage(), false));
-    } else if(name == "Hue"){
-        m_canvas->setImage(FilterApplyer::applyHue(m_canvas->getImage(), 30));
-    } else if(name == "Posterize"){
-        m_canvas->setImage(FilterApplyer::applyPosterize(m_canvas->getImage(), 5));
-    } else if(name == "Solarize"){
-        m_canvas->setImage(FilterApplyer::applySolarize(m_canvas->getImage(), 128));
-    } else if(name == "Pixelate"){
-        m_canvas->setImage(FilterApplyer::applyPixelate(m_canvas->getImage(), 30));
-    } else if(name == "Vignette"){
-        m_canvas->setImage(FilterApplyer::applyVignete(m_canvas->getImage()));
-    } else if(name == "Sharpen"){
-        m_canvas->setImage(FilterApplyer::applyDeBlur(m_canvas->getImage()));
+void MainWindow::onFilterChosen(const QString& name, int parameter){
+    submitFilterJob(name, [name, parameter](const QImage& image) {
+        return FilterDialog::apply(image, name, parameter);
+    });
+}
+
+void MainWindow::buildJobIndicator()
+{
+    m_jobProgress = new QProgressBar(this);
+    m_jobProgress->setRange(0, 100);
+    m_jobProgress->setMaximumWidth(200);
+    m_jobProgress->hide();
+
+    m_cancelJobButton = new QToolButton(this);
+    m_cancelJobButton->setText("Cancel");
+    m_cancelJobButton->setToolTip("Cancel the running filter and the ones waiting after it");
+    m_cancelJobButton->hide();
+    connect(m_cancelJobButton, &QToolButton::clicked, this, &MainWindow::onCancelJobClicked);
+
+    statusBar()->addPermanentWidget(m_jobProgress);
+    statusBar()->addPermanentWidget(m_cancelJobButton);
+}
+
+// Conflict policy: jobs run in the order they were submitted, each one on the
+// image as it is when the job starts, so queued filters apply on top of each
+// other. If the image is edited while a job runs, the job is rebased: it runs
+// again on the edited image instead of overwriting the edit.
+void MainWindow::submitFilterJob(const QString& name, const FilterJob::Filter& filter)
+{
+    FilterJob *job = new FilterJob(name, filter, this);
+    connect(job, &FilterJob::progressChanged, this, &MainWindow::onJobProgress);
+    connect(job, &FilterJob::finished, this, &MainWindow::onJobFinished);
+    connect(job, &FilterJob::cancelled, this, &MainWindow::onJobCancelled);
+    m_pendingJobs.enqueue(job);
+    if (!m_activeJob) {
+        startNextJob();
+    } else {
+        statusBar()->showMessage(name + " queued after " + m_activeJob->name(), 3000);
+    }
+}
+
+void MainWindow::startNextJob()
+{
+    m_activeJob = m_pendingJobs.isEmpty() ? nullptr : m_pendingJobs.dequeue();
+    m_jobProgress->setVisible(m_activeJob != nullptr);
+    m_cancelJobButton->setVisible(m_activeJob != nullptr);
+    if (!m_activeJob) {
+        return;
+    }
+    m_jobProgress->setValue(0);
+    m_activeJob->start(m_canvas->getImage());
+    m_activeJobKey = m_canvas->imageKey();
+}
+
+void MainWindow::onJobProgress(int pass, int percent)
+{
+    if (sender() != m_activeJob) {
+        return;
+    }
+    m_jobProgress->setValue(percent);
+    m_jobProgress->setFormat(QString("%1: pass %2, %p%").arg(m_activeJob->name()).arg(pass));
+}
+
+void MainWindow::onJobFinished(const QImage& result)
+{
+    FilterJob *job = m_activeJob;
+    if (sender() != job) {
+        return;
+    }
+    if (m_canvas->imageKey() != m_activeJobKey) {
+        statusBar()->showMessage("The image changed during " + job->name() + ", applying it again", 3000);
+        job->start(m_canvas->getImage());
+        m_activeJobKey = m_canvas->imageKey();
+        return;
+    }
+
+    if (FilterDialog::isSelfInverse(job->name(), job->source().format())) {
+        // Applying it again undoes it, so the history keeps no pixels for it
+        m_canvas->setImage(result, UndoHistory::Command{job->filter(), job->filter()});
+    } else {
+        m_canvas->setImage(result);
+    }
+    statusBar()->showMessage(job->name() + " applied", 3000);
+    job->deleteLater();
+    startNextJob();
+}
+
+void MainWindow::onJobCancelled()
+{
+    FilterJob *job = qobject_cast<FilterJob*>(sender());
+    if (!job) {
+        return;
+    }
+    statusBar()->showMessage(job->name() + " cancelled", 3000);
+    job->deleteLater();
+    if (job == m_activeJob) {
+        startNextJob();
+    }
+}
+
+void MainWindow::onCancelJobClicked()
+{
+    while (!m_pendingJobs.isEmpty()) {
+        m_pendingJobs.dequeue()->deleteLater();
+    }
+    if (m_activeJob) {
+        m_activeJob->cancel();
     }
 }
 
@@ -476,6 +600,7 @@ void MainWindow::onNewProjectClicked(){
     db->createProject(projectName, fullPath);
 
     m_currentProjectPath = fullPath;
+    m_canvas->setUndoSpillDirectory(m_currentProjectPath);
     int currentProjectId = -1;
     m_canvas->createBlank();
     m_currentFilePath.clear();
@@ -521,6 +646,7 @@ void MainWindow::onOpenProjectCLicked(){
     }
 
     m_currentProjectPath = dirPath;
+    m_canvas->setUndoSpillDirectory(m_currentProjectPath);
     //m_currentProjectFile = projectFilePath;
     auto db = DatabaseManager::instance();
     db->openDatabase("projects_library");
@@ -566,7 +692,7 @@ void MainWindow::onSaveAsClicked()
         this,
         "Save Image As",
         assetsDir + "/Untitled.png",
-        "PNG Image (*.png);;JPEG Image (*.jpg);;BMP Image (*.bmp);;All Files (*)",
+        "PNG Image (*.png);;PNG Image, 8-bit (*.png);;JPEG Image (*.jpg);;BMP Image (*.bmp);;All Files (*)",
         &selectedFilter
     );
 
@@ -594,7 +720,7 @@ void MainWindow::onSaveAsClicked()
     }
 
     m_canvas->setFilePath(filePath);
-    m_canvas->saveImage();
+    m_canvas->saveImage(selectedFilter.contains("8-bit"));
 
     auto db = DatabaseManager::instance();
     db->openDatabase("projects_library");
@@ -617,19 +743,19 @@ void MainWindow::onCopyClicked()
 
 void MainWindow::onCutClicked()
 {
-    m_canvas->pushUndoState();
     m_canvas->cut();
 }
 
 void MainWindow::onPasteClicked()
 {
-    m_canvas->pushUndoState();
     m_canvas->paste();
 }
 
 void MainWindow::onUndoClicked()
 {
-    m_canvas->undo();
+    if (!m_canvas->undo()) {
+        QMessageBox::warning(this, "Undo", "The previous state could not be read back from the undo file.");
+    }
 }
 
 void MainWindow::onRedoClicked()
@@ -637,48 +763,40 @@ void MainWindow::onRedoClicked()
     m_canvas->redo();
 }
 
+// Rotations and flips only change the orientation the canvas shows its pixels in;
+// consecutive ones compose and are baked in with one pass when the pixels are needed.
 void MainWindow::onRotateLeftCLicked()
 {
-    QImage src{m_canvas->getImage()};
-    if(src.isNull()) { return; }
-    m_canvas->pushUndoState();
-    m_canvas->setImage(ImageManipulator::rotateLeft(src));
+    m_canvas->orient(Orientation::rotateLeft());
     m_canvas->update();
 }
 
 void MainWindow::onRotateRightClicked()
 {
-    QImage src{m_canvas->getImage()};
-    if(src.isNull()) { return; }
-    m_canvas->pushUndoState();
-    m_canvas->setImage(ImageManipulator::rotateRight(src));
+    m_canvas->orient(Orientation::rotateRight());
     m_canvas->update();
 }
 
 void MainWindow::onRotate180Clicked()
 {
-    QImage src{m_canvas->getImage()};
-    if(src.isNull()) { return; }
-    m_canvas->pushUndoState();
-    m_canvas->setImage(ImageManipulator::rotate180(src));
+    m_canvas->orient(Orientation::rotate180());
     m_canvas->update();
 }
 
+void MainWindow::onRotateByAngleClicked()
+{
+    showRotateDialog();
+}
+
 void MainWindow::onHorizontalFlipClicked()
 {
-    QImage src{m_canvas->getImage()};
-    if(src.isNull()) { return; }
-    m_canvas->pushUndoState();
-    m_canvas->setImage(ImageManipulator::flipHorizontally(src));
+    m_canvas->orient(Orientation::flipHorizontal());
     m_canvas->update();
 }
 
 void MainWindow::onVerticalFlipClicked()
 {
-    QImage src{m_canvas->getImage()};
-    if(src.isNull()) { return; }
-    m_canvas->pushUndoState();
-    m_canvas->setImage(ImageManipulator::flipVertically(src));
+    m_canvas->orient(Orientation::flipVertical());
     m_canvas->update();
 }
 
@@ -746,6 +864,14 @@ void MainWindow::onWidthChanged(int width){
     m_canvas->setEraserWidth(width);
 }
 
+void MainWindow::onFillToleranceChanged(int tolerance){
+    m_canvas->setFillTolerance(tolerance);
+}
+
+void MainWindow::onFillConnectivityChanged(int index){
+    m_canvas->setFillConnectivity(index == 1 ? FloodFill::Connectivity::Eight : FloodFill::Connectivity::Four);
+}
+
 void MainWindow::onColorPanelClicked()
 {
     QColor defaultColor = Qt::black;
@@ -781,14 +907,16 @@ void MainWindow::onFiltersClicked()
 
 void MainWindow::onNoiseReductionClicked()
 {
-    m_canvas->pushUndoState();
-    m_canvas->setImage(FilterApplyer::applyNoiseReduction(m_canvas->getImage()));
+    submitFilterJob("Noise Reduction", [](const QImage& image) {
+        return FilterApplyer::applyNoiseReduction(image);
+    });
 }
 
 void MainWindow::onEdgeDetectionClicked()
 {
-    m_canvas->pushUndoState();
-    m_canvas->setImage(FilterApplyer::applyEdgeDetection(m_canvas->getImage()));
+    submitFilterJob("Edge Detection", [](const QImage& image) {
+        return FilterApplyer::applyEdgeDetection(image);
+    });
 }
 
 
@@ -8,9 +8,12 @@
 #include <QAction>
 #include <QLabel>
 #include <QToolButton>
+#include <QProgressBar>
+#include <QQueue>
 
 //#include "canvas.h"
 #include "graphicscanvas.h"
+#include "filterjob.h"
 
 class MainWindow : public QMainWindow
 {
@@ -32,6 +35,14 @@ private:
     QString m_currentFilePath;
     QString m_currentProjectPath;
 
+    // Filters run as background jobs, one at a time; the others wait in order.
+    FilterJob* m_activeJob;
+    // GraphicsCanvas::imageKey() of the image the active job was started on.
+    qint64 m_activeJobKey;
+    QQueue<FilterJob*> m_pendingJobs;
+    QProgressBar* m_jobProgress;
+    QToolButton* m_cancelJobButton;
+
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
@@ -45,6 +56,7 @@ private:
     void createMainToolBar();
     void buildGeometricOperationsSection();
     void buildSizeSelector();
+    void buildFillOptions();
     void buildToolsSection();
     void buildBrushMenu();
     void buildColorMenu();
@@ -53,8 +65,14 @@ private:
 
     //Dialog builders
     void showResizeDialog();
+    void showRotateDialog();
     void showFiltersDialog();
 
+    //Background filter jobs
+    void buildJobIndicator();
+    void submitFilterJob(const QString& name, const FilterJob::Filter& filter);
+    void startNextJob();
+
 private:
    //Stylization utilities
     void setGlobalStyles();
@@ -85,6 +103,7 @@ private slots:
     void onRotateLeftCLicked();
     void onRotateRightClicked();
     void onRotate180Clicked();
+    void onRotateByAngleClicked();
     void onHorizontalFlipClicked();
     void onVerticalFlipClicked();
     void onCropClicked();
@@ -102,6 +121,8 @@ private slots:
     //Brushes' slots
     void onSelectBrushClicked(int index);
     void onWidthChanged(int width);
+    void onFillToleranceChanged(int tolerance);
+    void onFillConnectivityChanged(int index);
 
     //Color panel's slot
     void onColorPanelClicked();
@@ -109,11 +130,17 @@ private slots:
     void updateCurrentColorSwatch(const QColor &color);
     //Filters' slots
     void onFiltersClicked();
-    void onFilterChosen(const QString& filterName);
+    void onFilterChosen(const QString& filterName, int parameter);
 
     //Advanced options' slots
     void onNoiseReductionClicked();
     void onEdgeDetectionClicked();
+
+    //Filter jobs' slots
+    void onJobProgress(int pass, int percent);
+    void onJobFinished(const QImage& result);
+    void onJobCancelled();
+    void onCancelJobClicked();
 //    void onCreateProcessClicked();
 //    void onExecuteProcessClicked();
 };
@@ -0,0 +1,176 @@
+#include "orientation.h"
+
+namespace {
+
+// The orientation as a signed permutation matrix acting on pixel coordinates
+// relative to the image center: mirrors * transpose.
+struct Matrix{
+    int values[2][2];
+};
+
+Matrix toMatrix(bool swapAxes, bool mirrorX, bool mirrorY){
+    const int x = mirrorX ? -1 : 1;
+    const int y = mirrorY ? -1 : 1;
+    Matrix matrix = {{{x, 0}, {0, y}}};
+    if(swapAxes){
+        matrix = {{{0, x}, {y, 0}}};
+    }
+    return matrix;
+}
+
+// EXIF Orientation values 1 to 8 in the order of the tag's definition.
+const bool kExifOrientations[8][3] = {
+    { false, false, false },
+    { false, true,  false },
+    { false, true,  true  },
+    { false, false, true  },
+    { true,  false, false },
+    { true,  true,  false },
+    { true,  true,  true  },
+    { true,  false, true  }
+};
+
+Matrix multiply(const Matrix& a, const Matrix& b){
+    Matrix result;
+    for(int row = 0; row < 2; ++row){
+        for(int column = 0; column < 2; ++column){
+            result.values[row][column] = a.values[row][0] * b.values[0][column] + a.values[row][1] * b.values[1][column];
+        }
+    }
+    return result;
+}
+
+}
+
+Orientation::Orientation()
+    : m_swapAxes(false), m_mirrorX(false), m_mirrorY(false)
+{
+}
+
+Orientation::Orientation(bool swapAxes, bool mirrorX, bool mirrorY)
+    : m_swapAxes(swapAxes), m_mirrorX(mirrorX), m_mirrorY(mirrorY)
+{
+}
+
+Orientation Orientation::rotateLeft()
+{
+    // (x, y) -> (y, -x)
+    return Orientation(true, false, true);
+}
+
+Orientation Orientation::rotateRight()
+{
+    // (x, y) -> (-y, x)
+    return Orientation(true, true, false);
+}
+
+Orientation Orientation::rotate180()
+{
+    return Orientation(false, true, true);
+}
+
+Orientation Orientation::flipHorizontal()
+{
+    return Orientation(false, true, false);
+}
+
+Orientation Orientation::flipVertical()
+{
+    return Orientation(false, false, true);
+}
+
+Orientation Orientation::transpose()
+{
+    return Orientation(true, false, false);
+}
+
+Orientation Orientation::antiTranspose()
+{
+    return Orientation(true, true, true);
+}
+
+Orientation Orientation::fromExif(int value)
+{
+    if(value < 1 || value > 8){
+        return Orientation();
+    }
+    const bool* entry = kExifOrientations[value - 1];
+    return Orientation(entry[0], entry[1], entry[2]);
+}
+
+bool Orientation::isIdentity() const
+{
+    return !m_swapAxes && !m_mirrorX && !m_mirrorY;
+}
+
+bool Orientation::swapsAxes() const
+{
+    return m_swapAxes;
+}
+
+bool Orientation::mirrorsX() const
+{
+    return m_mirrorX;
+}
+
+bool Orientation::mirrorsY() const
+{
+    return m_mirrorY;
+}
+
+Orientation Orientation::then(const Orientation& next) const
+{
+    const Matrix product = multiply(toMatrix(next.m_swapAxes, next.m_mirrorX, next.m_mirrorY),
+                                    toMatrix(m_swapAxes, m_mirrorX, m_mirrorY));
+    if(product.values[0][0] == 0){
+        return Orientation(true, product.values[0][1] < 0, product.values[1][0] < 0);
+    }
+    return Orientation(false, product.values[0][0] < 0, product.values[1][1] < 0);
+}
+
+Orientation Orientation::inverted() const
+{
+    // Mirrors and transposes are their own inverses; the two quarter turns swap.
+    if(m_swapAxes && m_mirrorX != m_mirrorY){
+        return Orientation(true, m_mirrorY, m_mirrorX);
+    }
+    return *this;
+}
+
+QSize Orientation::mapSize(const QSize& size) const
+{
+    return m_swapAxes ? size.transposed() : size;
+}
+
+QTransform Orientation::toTransform(const QSize& size) const
+{
+    const QSize mapped = mapSize(size);
+    const qreal x = m_mirrorX ? -1 : 1;
+    const qreal y = m_mirrorY ? -1 : 1;
+    const qreal dx = m_mirrorX ? mapped.width() : 0;
+    const qreal dy = m_mirrorY ? mapped.height() : 0;
+    if(m_swapAxes){
+        return QTransform(0, y, x, 0, dx, dy);
+    }
+    return QTransform(x, 0, 0, y, dx, dy);
+}
+
+int Orientation::toExif() const
+{
+    for(int value = 1; value <= 8; ++value){
+        if(fromExif(value) == *this){
+            return value;
+        }
+    }
+    return 1;
+}
+
+bool Orientation::operator==(const Orientation& other) const
+{
+    return m_swapAxes == other.m_swapAxes && m_mirrorX == other.m_mirrorX && m_mirrorY == other.m_mirrorY;
+}
+
+bool Orientation::operator!=(const Orientation& other) const
+{
+    return !(*this == other);
+}
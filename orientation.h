@@ -0,0 +1,58 @@
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+#include <QSize>
+#include <QTransform>
+
+// One of the eight rotations and reflections of a rectangle (the dihedral group
+// D4): an optional transpose followed by optional mirrors of the x and y axes.
+// Sequences of rotations and flips compose into a single Orientation, so they can
+// be applied with one pass over the pixels by ImageManipulator::transform().
+class Orientation
+{
+public:
+    // Identity.
+    Orientation();
+
+    // Rotations are clockwise (right) or counterclockwise (left) as seen on screen.
+    static Orientation rotateLeft();
+    static Orientation rotateRight();
+    static Orientation rotate180();
+    // Mirrors left and right, and top and bottom respectively.
+    static Orientation flipHorizontal();
+    static Orientation flipVertical();
+    // Reflections across the main diagonal and the anti-diagonal.
+    static Orientation transpose();
+    static Orientation antiTranspose();
+    // The value of the EXIF Orientation tag, 1 to 8; other values give the identity.
+    static Orientation fromExif(int value);
+
+    bool isIdentity() const;
+    // True for the 90 degree rotations and the transposes, which swap width and height.
+    bool swapsAxes() const;
+    // Mirrors applied after the optional transpose.
+    bool mirrorsX() const;
+    bool mirrorsY() const;
+
+    // The orientation that applies this one first and then next.
+    Orientation then(const Orientation& next) const;
+    Orientation inverted() const;
+    QSize mapSize(const QSize& size) const;
+    // Maps the coordinates of an image of the given size to those of the transformed
+    // image, e.g. to display the untransformed pixels through a QGraphicsItem.
+    QTransform toTransform(const QSize& size) const;
+    int toExif() const;
+
+    bool operator==(const Orientation& other) const;
+    bool operator!=(const Orientation& other) const;
+
+private:
+    Orientation(bool swapAxes, bool mirrorX, bool mirrorY);
+
+private:
+    bool m_swapAxes;
+    bool m_mirrorX;
+    bool m_mirrorY;
+};
+
+#endif // ORIENTATION_H
@@ -0,0 +1,91 @@
+#ifndef PIXELTRAITS_H
+#define PIXELTRAITS_H
+
+#include <QImage>
+#include <QRgb>
+
+// Compile-time description of how a QImage format stores one pixel, so row
+// kernels can be instantiated per format instead of converting whole images or
+// going through pixel()/setPixel().
+//
+// load() returns the pixel as a non-premultiplied QRgb and store() writes one
+// back; formats without alpha drop it and Grayscale8 stores qGray().
+template <QImage::Format F>
+struct PixelTraits;
+
+template <>
+struct PixelTraits<QImage::Format_ARGB32>{
+    static const int BytesPerPixel = 4;
+    // Stored pixels already are QRgb values, so rows can be processed in place.
+    static const bool IsQRgb = true;
+
+    static QRgb load(const uchar* p){
+        return *reinterpret_cast<const QRgb*>(p);
+    }
+
+    static void store(uchar* p, QRgb value){
+        *reinterpret_cast<QRgb*>(p) = value;
+    }
+};
+
+template <>
+struct PixelTraits<QImage::Format_RGB32>{
+    static const int BytesPerPixel = 4;
+    // The alpha byte is always 0xff, which every filter keeps.
+    static const bool IsQRgb = true;
+
+    static QRgb load(const uchar* p){
+        return *reinterpret_cast<const QRgb*>(p) | 0xff000000u;
+    }
+
+    static void store(uchar* p, QRgb value){
+        *reinterpret_cast<QRgb*>(p) = value | 0xff000000u;
+    }
+};
+
+template <>
+struct PixelTraits<QImage::Format_ARGB32_Premultiplied>{
+    static const int BytesPerPixel = 4;
+    static const bool IsQRgb = false;
+
+    static QRgb load(const uchar* p){
+        return qUnpremultiply(*reinterpret_cast<const QRgb*>(p));
+    }
+
+    static void store(uchar* p, QRgb value){
+        *reinterpret_cast<QRgb*>(p) = qPremultiply(value);
+    }
+};
+
+template <>
+struct PixelTraits<QImage::Format_RGB888>{
+    static const int BytesPerPixel = 3;
+    static const bool IsQRgb = false;
+
+    // Bytes are red, green, blue in memory order.
+    static QRgb load(const uchar* p){
+        return qRgb(p[0], p[1], p[2]);
+    }
+
+    static void store(uchar* p, QRgb value){
+        p[0] = uchar(qRed(value));
+        p[1] = uchar(qGreen(value));
+        p[2] = uchar(qBlue(value));
+    }
+};
+
+template <>
+struct PixelTraits<QImage::Format_Grayscale8>{
+    static const int BytesPerPixel = 1;
+    static const bool IsQRgb = false;
+
+    static QRgb load(const uchar* p){
+        return qRgb(p[0], p[0], p[0]);
+    }
+
+    static void store(uchar* p, QRgb value){
+        p[0] = uchar(qGray(value));
+    }
+};
+
+#endif // PIXELTRAITS_H
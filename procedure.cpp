@@ -1,12 +1,32 @@
 #include "procedure.h"
+#include "colormatrix.h"
 #include "databasemanager.h"
+#include "filterapplyer.h"
+#include "imagemanipulator.h"
+#include "orientation.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
 #include <QStringList>
+#include <QVector>
 #include <QDebug>
 #include <QtMath>
 
+namespace {
+
+// The number between the parentheses of a step such as "Contrast(1.5)".
+double stepArgument(const QString &step, double fallback)
+{
+    int start = step.indexOf('(');
+    int end = step.indexOf(')');
+    if (start != -1 && end != -1 && end > start) {
+        return step.mid(start + 1, end - start - 1).toDouble();
+    }
+    return fallback;
+}
+
+}
+
 Procedure::Procedure(int procId)
     : m_procedureId(procId), m_projectId(-1)
 {
@@ -61,48 +81,53 @@ bool Procedure::executeOnImage(QImage &img)
 {
     if (m_sequence.isEmpty())
         return false;
+    // Every step is a color matrix or a rotation/flip. Color matrices act on each pixel
+    // alone and so commute with the geometric steps: the orientations are concatenated
+    // into one pass, and the matrices are fused wherever no step in between saturates.
+    QVector<ColorMatrix> matrices;
+    Orientation orientation;
     QStringList steps = m_sequence.split(",", QString::SkipEmptyParts);
     for (const QString &step : steps) {
         QString s = step.trimmed();
         if (s.compare("Grayscale", Qt::CaseInsensitive) == 0) {
-            for (int y = 0; y < img.height(); ++y) {
-                for (int x = 0; x < img.width(); ++x) {
-                    QColor c = QColor(img.pixel(x, y));
-                    int gray = qGray(c.rgb());
-                    img.setPixel(x, y, qRgb(gray, gray, gray));
-                }
-            }
+            matrices.append(ColorMatrix::grayscale());
         }
         else if (s.compare("Invert", Qt::CaseInsensitive) == 0) {
-            for (int y = 0; y < img.height(); ++y) {
-                for (int x = 0; x < img.width(); ++x) {
-                    QColor c = QColor(img.pixel(x, y));
-                    c.setRgb(255 - c.red(), 255 - c.green(), 255 - c.blue());
-                    img.setPixel(x, y, c.rgb());
-                }
-            }
+            matrices.append(ColorMatrix::invert());
+        }
+        else if (s.compare("Sepia", Qt::CaseInsensitive) == 0) {
+            matrices.append(ColorMatrix::sepia());
         }
         else if (s.startsWith("Contrast", Qt::CaseInsensitive)) {
-            int start = s.indexOf('(');
-            int end = s.indexOf(')');
-            double factor = 1.0;
-            if (start != -1 && end != -1 && end > start) {
-                factor = s.mid(start + 1, end - start - 1).toDouble();
-            }
-            for (int y = 0; y < img.height(); ++y) {
-                for (int x = 0; x < img.width(); ++x) {
-                    QColor c = QColor(img.pixel(x, y));
-                    int r = qBound(0, int((c.red() - 128) * factor + 128), 255);
-                    int g = qBound(0, int((c.green() - 128) * factor + 128), 255);
-                    int b = qBound(0, int((c.blue() - 128) * factor + 128), 255);
-                    img.setPixel(x, y, qRgb(r, g, b));
-                }
-            }
+            matrices.append(ColorMatrix::contrast(stepArgument(s, 1.0)));
+        }
+        else if (s.startsWith("Saturation", Qt::CaseInsensitive)) {
+            matrices.append(ColorMatrix::saturation(stepArgument(s, 1.0)));
+        }
+        else if (s.startsWith("Hue", Qt::CaseInsensitive)) {
+            matrices.append(ColorMatrix::hueRotation(stepArgument(s, 0.0)));
+        }
+        else if (s.compare("RotateLeft", Qt::CaseInsensitive) == 0) {
+            orientation = orientation.then(Orientation::rotateLeft());
+        }
+        else if (s.compare("RotateRight", Qt::CaseInsensitive) == 0) {
+            orientation = orientation.then(Orientation::rotateRight());
+        }
+        else if (s.compare("Rotate180", Qt::CaseInsensitive) == 0) {
+            orientation = orientation.then(Orientation::rotate180());
+        }
+        else if (s.compare("FlipHorizontal", Qt::CaseInsensitive) == 0) {
+            orientation = orientation.then(Orientation::flipHorizontal());
+        }
+        else if (s.compare("FlipVertical", Qt::CaseInsensitive) == 0) {
+            orientation = orientation.then(Orientation::flipVertical());
         }
         else {
             qDebug() << "Unknown procedure step:" << s;
         }
     }
+    img = ImageManipulator::transform(img, orientation);
+    img = FilterApplyer::applyColorMatrices(img, matrices);
     return true;
 }
 
@@ -0,0 +1,330 @@
+#include "resampler.h"
+#include "floatimage.h"
+#include "simdkernels.h"
+#include "tilescheduler.h"
+
+#include <QVarLengthArray>
+#include <QtMath>
+#include <cmath>
+
+namespace {
+
+const int kWeightOne = 1 << SimdKernels::WeightShift;
+
+double boxKernel(double x){
+    return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+}
+
+double triangleKernel(double x){
+    return qMax(0.0, 1.0 - qAbs(x));
+}
+
+// Keys cubic with a = -0.5 (Catmull-Rom).
+double cubicKernel(double x){
+    const double a = -0.5;
+    x = qAbs(x);
+    if(x < 1.0){
+        return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+    }
+    if(x < 2.0){
+        return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+    }
+    return 0.0;
+}
+
+double sinc(double x){
+    if(x == 0.0){
+        return 1.0;
+    }
+    x *= M_PI;
+    return std::sin(x) / x;
+}
+
+double lanczos3Kernel(double x){
+    return (qAbs(x) < 3.0) ? sinc(x) * sinc(x / 3.0) : 0.0;
+}
+
+struct FilterShape{
+    double (*kernel)(double);
+    double support;
+};
+
+FilterShape filterShape(Resampler::Filter filter){
+    switch(filter){
+    case Resampler::Filter::Box:
+        return FilterShape{ boxKernel, 0.5 };
+    case Resampler::Filter::Bilinear:
+        return FilterShape{ triangleKernel, 1.0 };
+    case Resampler::Filter::Bicubic:
+        return FilterShape{ cubicKernel, 2.0 };
+    case Resampler::Filter::Lanczos3:
+    default:
+        return FilterShape{ lanczos3Kernel, 3.0 };
+    }
+}
+
+// Weights of one axis: output i reads taps inputs from starts[i], with the weights
+// weights[i * taps + k], which sum to 1 (kWeightOne in fixed point). The same
+// weights are kept as 16-bit and float values for the other kernels.
+struct WeightTable{
+    int taps;
+    QVector<int> starts;
+    QVector<int> weights;
+    QVector<qint16> shortWeights;
+    QVector<float> floatWeights;
+};
+
+WeightTable weightTable(int inSize, int outSize, Resampler::Filter filter){
+    const FilterShape shape = filterShape(filter);
+    const double scale = double(inSize) / outSize;
+    const double filterScale = qMax(scale, 1.0);
+    const double support = shape.support * filterScale;
+
+    WeightTable table;
+    // Rounded up to a multiple of 8 with zero weights, the step of the vector kernels.
+    table.taps = qMin((2 * int(std::ceil(support)) + 8) & ~7, inSize);
+    table.starts.resize(outSize);
+    table.weights.fill(0, outSize * table.taps);
+    table.shortWeights.fill(0, outSize * table.taps);
+    table.floatWeights.fill(0.0f, outSize * table.taps);
+
+    QVarLengthArray<double, 64> exact(table.taps);
+    for(int i = 0; i < outSize; ++i){
+        const double center = (i + 0.5) * scale;
+        const int first = qMax(0, int(center - support + 0.5));
+        const int last = qMin(inSize, int(center + support + 0.5));
+        // Windows near the end start early so all taps stay inside the row.
+        const int start = qMin(first, inSize - table.taps);
+        table.starts[i] = start;
+
+        std::fill(exact.begin(), exact.end(), 0.0);
+        double total = 0.0;
+        for(int j = first; j < last; ++j){
+            const double weight = shape.kernel((j - center + 0.5) / filterScale);
+            exact[j - start] = weight;
+            total += weight;
+        }
+        if(total == 0.0){
+            exact[qBound(first, int(center), last - 1) - start] = 1.0;
+            total = 1.0;
+        }
+
+        int* fixed = table.weights.data() + i * table.taps;
+        float* single = table.floatWeights.data() + i * table.taps;
+        int sum = 0;
+        int largest = 0;
+        for(int k = 0; k < table.taps; ++k){
+            single[k] = float(exact[k] / total);
+            fixed[k] = qRound(exact[k] / total * kWeightOne);
+            sum += fixed[k];
+            if(fixed[k] > fixed[largest]){
+                largest = k;
+            }
+        }
+        // The rounding error goes to the largest tap so flat areas stay exactly flat.
+        fixed[largest] += kWeightOne - sum;
+        std::copy(fixed, fixed + table.taps, table.shortWeights.begin() + i * table.taps);
+    }
+    return table;
+}
+
+// Output rows per band: enough that the input rows a band needs beyond its own
+// share (the filter overlap) stay small next to it.
+int rowAlignment(const WeightTable& rows, int inHeight, int outHeight){
+    return qBound(1, int(std::ceil(4.0 * rows.taps * outHeight / inHeight)), 256);
+}
+
+// The negative lobes of Bicubic and Lanczos3 ring at sharp alpha edges, which can
+// leave a premultiplied color above its alpha; unpremultiplying it would then wrap.
+// Clamps the colors to alpha, as SimdKernels::remapBicubic() does.
+void clampToAlpha(QRgb* pixels, int count){
+    for(int i = 0; i < count; ++i){
+        const QRgb pixel = pixels[i];
+        const int alpha = qAlpha(pixel);
+        if(qRed(pixel) > alpha || qGreen(pixel) > alpha || qBlue(pixel) > alpha){
+            pixels[i] = qRgba(qMin(qRed(pixel), alpha), qMin(qGreen(pixel), alpha), qMin(qBlue(pixel), alpha), alpha);
+        }
+    }
+}
+
+// 8-bit path on RGB32 or premultiplied ARGB32 pixels, with the fixed-point
+// kernels that also run the Gaussian blur.
+QImage resample8(const QImage& src, const QSize& size, const WeightTable& columns, const WeightTable& rows){
+    QImage dst(size, src.format());
+    const uchar* in = src.constBits();
+    uchar* out = dst.bits();
+    const qptrdiff inStride = src.bytesPerLine();
+    const qptrdiff outStride = dst.bytesPerLine();
+    const int values = 4 * size.width();
+    const bool premultiplied = (src.format() == QImage::Format_ARGB32_Premultiplied);
+
+    TileScheduler::forEachBand(size, dst.bytesPerLine(), 0, [&](const TileScheduler::Tile& tile){
+        const int first = rows.starts[tile.rect.top()];
+        const int last = rows.starts[tile.rect.bottom()] + rows.taps;
+        QVector<quint16> horizontal((last - first) * values);
+        for(int y = first; y < last; ++y){
+            SimdKernels::resampleRow(reinterpret_cast<const QRgb*>(in + y * inStride), columns.starts.constData(),
+                                     columns.shortWeights.constData(), columns.taps, size.width(),
+                                     horizontal.data() + (y - first) * values);
+        }
+        QVarLengthArray<const quint16*, 64> lines(rows.taps);
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            for(int k = 0; k < rows.taps; ++k){
+                lines[k] = horizontal.constData() + (rows.starts[y] + k - first) * values;
+            }
+            SimdKernels::convolveColumn(lines.constData(), rows.weights.constData() + y * rows.taps, rows.taps,
+                                        values, out + y * outStride);
+            if(premultiplied){
+                clampToAlpha(reinterpret_cast<QRgb*>(out + y * outStride), size.width());
+            }
+        }
+    }, rowAlignment(rows, src.height(), size.height()));
+    return dst;
+}
+
+// sRGB transfer curve sampled at 4096 intervals and interpolated linearly; both
+// directions are linear near black, where that is exact.
+class TransferTable
+{
+public:
+    explicit TransferTable(double (*curve)(double))
+        : m_values(kSteps + 2)
+    {
+        for(int i = 0; i <= kSteps; ++i){
+            m_values[i] = float(curve(double(i) / kSteps));
+        }
+        m_values[kSteps + 1] = m_values[kSteps];
+    }
+
+    float operator()(float value) const{
+        const float position = qBound(0.0f, value, 1.0f) * kSteps;
+        const int i = int(position);
+        return m_values[i] + (position - i) * (m_values[i + 1] - m_values[i]);
+    }
+
+private:
+    static const int kSteps = 4096;
+    QVector<float> m_values;
+};
+
+double srgbToLinear(double v){
+    return (v <= 0.04045) ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+}
+
+double linearToSrgb(double v){
+    return (v <= 0.0031308) ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+}
+
+const TransferTable& toLinear(){
+    static const TransferTable table(srgbToLinear);
+    return table;
+}
+
+const TransferTable& toSrgb(){
+    static const TransferTable table(linearToSrgb);
+    return table;
+}
+
+void resampleFloatRow(const float* in, const WeightTable& columns, int count, float* out){
+    const int taps = columns.taps;
+    for(int x = 0; x < count; ++x){
+        const float* window = in + columns.starts[x];
+        const float* weights = columns.floatWeights.constData() + x * taps;
+        float sum = 0.0f;
+        for(int k = 0; k < taps; ++k){
+            sum += weights[k] * window[k];
+        }
+        out[x] = sum;
+    }
+}
+
+// Float path for high bit depth and linear light. Pixels are premultiplied (and
+// linearized) before filtering and converted back afterwards.
+QImage resampleFloat(const QImage& src, const QSize& size, const WeightTable& columns, const WeightTable& rows, bool linearLight){
+    FloatImage in(src);
+    const int inWidth = in.width();
+    const TransferTable& decode = toLinear();
+    const TransferTable& encode = toSrgb();
+    TileScheduler::forEachBand(in.size(), inWidth * 4 * int(sizeof(float)), 0, [&](const TileScheduler::Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            const float* alpha = in.constLine(FloatImage::Alpha, y);
+            for(int c = FloatImage::Red; c <= FloatImage::Blue; ++c){
+                float* line = in.line(FloatImage::Channel(c), y);
+                for(int x = 0; x < inWidth; ++x){
+                    line[x] = (linearLight ? decode(line[x]) : line[x]) * alpha[x];
+                }
+            }
+        }
+    });
+
+    // Vertical pass first: it is vectorized, and the scalar horizontal pass then only
+    // runs once per output pixel.
+    FloatImage out(size.width(), size.height());
+    const int width = size.width();
+    TileScheduler::forEachBand(size, width * 4 * int(sizeof(float)), 0, [&](const TileScheduler::Tile& tile){
+        QVector<float> vertical(inWidth);
+        QVarLengthArray<const float*, 64> lines(rows.taps);
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            for(int c = 0; c < 4; ++c){
+                for(int k = 0; k < rows.taps; ++k){
+                    lines[k] = in.constLine(FloatImage::Channel(c), rows.starts[y] + k);
+                }
+                SimdKernels::convolveFloat(lines.constData(), rows.floatWeights.constData() + y * rows.taps, rows.taps,
+                                           inWidth, vertical.data());
+                resampleFloatRow(vertical.constData(), columns, width, out.line(FloatImage::Channel(c), y));
+            }
+            const float* alpha = out.constLine(FloatImage::Alpha, y);
+            for(int c = FloatImage::Red; c <= FloatImage::Blue; ++c){
+                float* line = out.line(FloatImage::Channel(c), y);
+                for(int x = 0; x < width; ++x){
+                    const float value = (alpha[x] > 0.0f) ? line[x] / alpha[x] : 0.0f;
+                    line[x] = linearLight ? encode(value) : value;
+                }
+            }
+        }
+    });
+    // Indexed sources cannot hold the blended colors, so they come back as 32-bit.
+    if(src.colorCount() > 0){
+        return out.toImage(src.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    }
+    return out.toImage(src.format());
+}
+
+}
+
+QImage Resampler::resize(const QImage& src, const QSize& size, Filter filter, bool linearLight){
+    if(src.isNull() || size.isEmpty()){
+        return QImage();
+    }
+    if(size == src.size()){
+        return src;
+    }
+
+    const WeightTable columns = weightTable(src.width(), size.width(), filter);
+    const WeightTable rows = weightTable(src.height(), size.height(), filter);
+    if(linearLight || FloatImage::isHighBitDepth(src.format())){
+        return resampleFloat(src, size, columns, rows, linearLight);
+    }
+
+    // Premultiplied, so transparent pixels do not bleed their color into the result.
+    const QImage::Format work = src.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+    const QImage dst = resample8((src.format() == work) ? src : src.convertToFormat(work), size, columns, rows);
+    if(src.format() == work || src.colorCount() > 0){
+        return dst;
+    }
+    return dst.convertToFormat(src.format());
+}
+
+const char* Resampler::name(Filter filter){
+    switch(filter){
+    case Filter::Box:
+        return "Box";
+    case Filter::Bilinear:
+        return "Bilinear";
+    case Filter::Bicubic:
+        return "Bicubic";
+    case Filter::Lanczos3:
+    default:
+        return "Lanczos3";
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QImage>
+
+// Separable resizing with a choice of reconstruction filter. The weights of each
+// output column and row are computed once per call; the image then goes through a
+// horizontal and a vertical pass, in parallel bands of output rows.
+//
+// Downscaling widens the filter by the scale factor, so every input pixel
+// contributes and large reductions do not alias.
+class Resampler
+{
+public:
+    enum class Filter{
+        Box,
+        Bilinear,
+        Bicubic,
+        Lanczos3
+    };
+
+public:
+    // Resizes src to size and returns the same format; indexed images come back as
+    // 32-bit. With linearLight the filter averages linear intensities instead of
+    // sRGB values, which keeps fine bright detail from darkening when downscaling.
+    static QImage resize(const QImage& src, const QSize& size, Filter filter = Filter::Lanczos3, bool linearLight = false);
+
+    static const char* name(Filter filter);
+};
+
+#endif // RESAMPLER_H
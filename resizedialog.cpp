@@ -3,6 +3,7 @@
 #include <QCheckBox>
 #include <QSpinBox>
 #include <QDialogButtonBox>
+#include <QComboBox>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
@@ -63,6 +64,22 @@ ResizeDialog::ResizeDialog(QWidget *parent)
     percentLayout->addWidget(new QLabel("Height (%):", this));
     percentLayout->addWidget(m_percentHeightSpin);
 
+    // 3) Resampling filter
+    m_filterCombo = new QComboBox(this);
+    for (Resampler::Filter filter : { Resampler::Filter::Box, Resampler::Filter::Bilinear,
+                                      Resampler::Filter::Bicubic, Resampler::Filter::Lanczos3 }) {
+        m_filterCombo->addItem(Resampler::name(filter), int(filter));
+    }
+    m_filterCombo->setCurrentIndex(m_filterCombo->findData(int(Resampler::Filter::Lanczos3)));
+    m_linearLightCheck = new QCheckBox("Resample in linear light", this);
+    m_linearLightCheck->setToolTip("Slower, but keeps fine bright detail from darkening when downscaling");
+
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    filterLayout->addWidget(new QLabel("Filter:", this));
+    filterLayout->addWidget(m_filterCombo);
+    filterLayout->addSpacing(10);
+    filterLayout->addWidget(m_linearLightCheck);
+
     // Connect toggles
     connect(m_pixelCheck,  &QCheckBox::toggled, this, &ResizeDialog::onPixelCheckToggled);
     connect(m_percentCheck,&QCheckBox::toggled, this, &ResizeDialog::onPercentCheckToggled);
@@ -80,6 +97,8 @@ ResizeDialog::ResizeDialog(QWidget *parent)
     mainLayout->addSpacing(15);
     mainLayout->addWidget(m_percentCheck);
     mainLayout->addLayout(percentLayout);
+    mainLayout->addSpacing(15);
+    mainLayout->addLayout(filterLayout);
 
     mainLayout->addSpacing(10);
     mainLayout->addWidget(m_buttonBox);
@@ -144,3 +163,13 @@ int ResizeDialog::percentageHeight() const
 {
     return m_percentHeightSpin->value();
 }
+
+Resampler::Filter ResizeDialog::filter() const
+{
+    return Resampler::Filter(m_filterCombo->currentData().toInt());
+}
+
+bool ResizeDialog::linearLight() const
+{
+    return m_linearLightCheck->isChecked();
+}
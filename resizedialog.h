@@ -6,6 +6,9 @@
 #include <QCheckBox>
 #include <QSpinBox>
 #include <QDialogButtonBox>
+#include <QComboBox>
+
+#include "resampler.h"
 
 class ResizeDialog : public QDialog
 {
@@ -28,6 +31,10 @@ public:
     int percentageWidth() const;
     int percentageHeight() const;
 
+    // Reconstruction filter and whether to resample in linear light
+    Resampler::Filter filter() const;
+    bool linearLight() const;
+
 private slots:
     // Toggle which section is active when checkboxes are toggled
     void onPixelCheckToggled(bool checked);
@@ -42,6 +49,9 @@ private:
     QSpinBox  *m_percentWidthSpin;
     QSpinBox  *m_percentHeightSpin;
 
+    QComboBox *m_filterCombo;
+    QCheckBox *m_linearLightCheck;
+
     QDialogButtonBox *m_buttonBox;
 };
 
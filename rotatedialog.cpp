@@ -0,0 +1,77 @@
+#include "rotatedialog.h"
+
+#include <QCheckBox>
+#include <QDoubleSpinBox>
+#include <QDialogButtonBox>
+#include <QComboBox>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+
+RotateDialog::RotateDialog(QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle("Rotate Image");
+
+    // Angle, fine enough to straighten a tilted scan
+    m_angleSpin = new QDoubleSpinBox(this);
+    m_angleSpin->setRange(-180.0, 180.0);
+    m_angleSpin->setDecimals(2);
+    m_angleSpin->setSingleStep(0.1);
+    m_angleSpin->setSuffix("°");
+    m_angleSpin->setValue(0.0);
+
+    m_expandCheck = new QCheckBox("Expand canvas to fit", this);
+    m_expandCheck->setChecked(true);
+    m_expandCheck->setToolTip("Otherwise the image keeps its size and the corners are cut off");
+
+    m_interpolationCombo = new QComboBox(this);
+    m_interpolationCombo->addItem("Nearest", int(ImageManipulator::Interpolation::Nearest));
+    m_interpolationCombo->addItem("Bilinear", int(ImageManipulator::Interpolation::Bilinear));
+    m_interpolationCombo->addItem("Bicubic", int(ImageManipulator::Interpolation::Bicubic));
+    m_interpolationCombo->setCurrentIndex(m_interpolationCombo->findData(int(ImageManipulator::Interpolation::Bicubic)));
+
+    QHBoxLayout *angleLayout = new QHBoxLayout();
+    angleLayout->addWidget(new QLabel("Angle (clockwise):", this));
+    angleLayout->addWidget(m_angleSpin);
+
+    QHBoxLayout *interpolationLayout = new QHBoxLayout();
+    interpolationLayout->addWidget(new QLabel("Interpolation:", this));
+    interpolationLayout->addWidget(m_interpolationCombo);
+
+    // OK/Cancel buttons
+    m_buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel,
+                                       Qt::Horizontal, this);
+    connect(m_buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(m_buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    // Overall layout
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->addLayout(angleLayout);
+    mainLayout->addWidget(m_expandCheck);
+    mainLayout->addLayout(interpolationLayout);
+
+    mainLayout->addSpacing(10);
+    mainLayout->addWidget(m_buttonBox);
+}
+
+RotateDialog::~RotateDialog()
+{
+    // nothing special
+}
+
+qreal RotateDialog::angle() const
+{
+    return m_angleSpin->value();
+}
+
+ImageManipulator::RotationBounds RotateDialog::bounds() const
+{
+    return m_expandCheck->isChecked() ? ImageManipulator::RotationBounds::Expand
+                                      : ImageManipulator::RotationBounds::Crop;
+}
+
+ImageManipulator::Interpolation RotateDialog::interpolation() const
+{
+    return ImageManipulator::Interpolation(m_interpolationCombo->currentData().toInt());
+}
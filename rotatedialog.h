@@ -0,0 +1,36 @@
+#ifndef ROTATEDIALOG_H
+#define ROTATEDIALOG_H
+
+#include <QDialog>
+#include <QWidget>
+#include <QCheckBox>
+#include <QDoubleSpinBox>
+#include <QDialogButtonBox>
+#include <QComboBox>
+
+#include "imagemanipulator.h"
+
+class RotateDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit RotateDialog(QWidget *parent = nullptr);
+    ~RotateDialog();
+
+    // Clockwise angle in degrees
+    qreal angle() const;
+
+    // Whether the canvas grows to fit the rotated image or keeps its size
+    ImageManipulator::RotationBounds bounds() const;
+
+    ImageManipulator::Interpolation interpolation() const;
+
+private:
+    QDoubleSpinBox *m_angleSpin;
+    QCheckBox *m_expandCheck;
+    QComboBox *m_interpolationCombo;
+
+    QDialogButtonBox *m_buttonBox;
+};
+
+#endif // ROTATEDIALOG_H
@@ -0,0 +1,1803 @@
+#include "simdkernels.h"
+
+#include <QByteArray>
+#include <QVarLengthArray>
+#include <QtMath>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+// Vector paths need GCC or Clang on x86; they are compiled per function with the
+// target attribute, so the rest of the program keeps the default instruction set.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+// MinGW does not align the stack for spilled 32-byte registers, so Windows GCC
+// builds stop at SSE2.
+#if !defined(_WIN32)
+#define SIMD_X86_AVX
+#endif
+#endif
+
+const int SimdKernels::WeightShift;
+const int SimdKernels::RowFractionBits;
+const int SimdKernels::RemapFractionBits;
+
+namespace {
+
+typedef SimdKernels::InstructionSet InstructionSet;
+
+const int kRowShift = SimdKernels::WeightShift - SimdKernels::RowFractionBits;
+const int kColumnShift = SimdKernels::WeightShift + SimdKernels::RowFractionBits;
+
+// Pairs of consecutive weights packed as two 16-bit halves, the operand layout of
+// madd: (weights[2i], weights[2i + 1]), the missing last weight of an odd count being 0.
+class WeightPairs
+{
+public:
+    WeightPairs(const int* weights, int taps)
+        : m_pairs((taps + 1) / 2)
+    {
+        for(int k = 0; k < taps; k += 2){
+            const int next = (k + 1 < taps) ? weights[k + 1] : 0;
+            m_pairs[k / 2] = (weights[k] & 0xffff) | (next << 16);
+        }
+    }
+
+    int operator[](int i) const{
+        return m_pairs[i];
+    }
+
+private:
+    QVarLengthArray<int, 64> m_pairs;
+};
+
+// Scalar kernels. The vector kernels fall back to them for the pixels left over
+// after the last full vector, so they take the first index to process.
+
+void lookupScalar(const QRgb* in, QRgb* out, int first, int count, const uchar* table){
+    for(int i = first; i < count; ++i){
+        const QRgb p = in[i];
+        out[i] = (p & 0xff000000u) | (quint32(table[(p >> 16) & 0xff]) << 16)
+               | (quint32(table[(p >> 8) & 0xff]) << 8) | quint32(table[p & 0xff]);
+    }
+}
+
+void colorMatrixScalar(const QRgb* in, QRgb* out, int first, int count, const SimdKernels::FixedColorMatrix& matrix){
+    const int shift = SimdKernels::ColorMatrixShift;
+    for(int i = first; i < count; ++i){
+        const QRgb p = in[i];
+        const int channels[4] = { int(p & 0xff), int((p >> 8) & 0xff), int((p >> 16) & 0xff), int(p >> 24) };
+        QRgb result = 0;
+        for(int c = 0; c < 4; ++c){
+            const qint16* row = matrix.coefficients[c];
+            const int value = matrix.offsets[c] + row[0] * channels[0] + row[1] * channels[1]
+                            + row[2] * channels[2] + row[3] * channels[3];
+            result |= quint32(qBound(0, value >> shift, 255)) << (8 * c);
+        }
+        out[i] = result;
+    }
+}
+
+void convolveRowScalar(const QRgb* padded, int first, int width, const int* weights, int taps, quint16* out){
+    for(int x = first; x < width; ++x){
+        const QRgb* window = padded + x;
+        int sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+        for(int k = 0; k < taps; ++k){
+            const QRgb p = window[k];
+            const int w = weights[k];
+            sum0 += w * int(p & 0xff);
+            sum1 += w * int((p >> 8) & 0xff);
+            sum2 += w * int((p >> 16) & 0xff);
+            sum3 += w * int(p >> 24);
+        }
+        const int half = 1 << (kRowShift - 1);
+        out[4 * x]     = quint16((sum0 + half) >> kRowShift);
+        out[4 * x + 1] = quint16((sum1 + half) >> kRowShift);
+        out[4 * x + 2] = quint16((sum2 + half) >> kRowShift);
+        out[4 * x + 3] = quint16((sum3 + half) >> kRowShift);
+    }
+}
+
+void convolveColumnScalar(const quint16* const* rows, const int* weights, int taps, int first, int count, uchar* out){
+    // Blocks of values are accumulated row by row so every input row is read sequentially.
+    const int block = 256;
+    int acc[block];
+    for(int start = first; start < count; start += block){
+        const int length = qMin(block, count - start);
+        std::fill(acc, acc + length, 1 << (kColumnShift - 1));
+        for(int k = 0; k < taps; ++k){
+            const quint16* row = rows[k] + start;
+            const int w = weights[k];
+            for(int i = 0; i < length; ++i){
+                acc[i] += w * int(row[i]);
+            }
+        }
+        for(int i = 0; i < length; ++i){
+            out[start + i] = uchar(qBound(0, acc[i] >> kColumnShift, 255));
+        }
+    }
+}
+
+void resampleRowScalar(const QRgb* in, const int* starts, const qint16* weights, int taps, int first, int count, quint16* out){
+    const int half = 1 << (kRowShift - 1);
+    const int limit = 255 << SimdKernels::RowFractionBits;
+    for(int x = first; x < count; ++x){
+        const QRgb* window = in + starts[x];
+        const qint16* w = weights + x * taps;
+        int sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+        for(int k = 0; k < taps; ++k){
+            const QRgb p = window[k];
+            sum0 += w[k] * int(p & 0xff);
+            sum1 += w[k] * int((p >> 8) & 0xff);
+            sum2 += w[k] * int((p >> 16) & 0xff);
+            sum3 += w[k] * int(p >> 24);
+        }
+        out[4 * x]     = quint16(qBound(0, (sum0 + half) >> kRowShift, limit));
+        out[4 * x + 1] = quint16(qBound(0, (sum1 + half) >> kRowShift, limit));
+        out[4 * x + 2] = quint16(qBound(0, (sum2 + half) >> kRowShift, limit));
+        out[4 * x + 3] = quint16(qBound(0, (sum3 + half) >> kRowShift, limit));
+    }
+}
+
+// a, b and c are the rows above, at and below the pixel, and l, m and r the columns
+// left of, at and right of it.
+inline QRgb sobelPixel(const QRgb* a, const QRgb* b, const QRgb* c, int l, int m, int r){
+    QRgb result = 0xff000000u;
+    for(int shift = 0; shift < 24; shift += 8){
+        const int a0 = (a[l] >> shift) & 0xff, a1 = (a[m] >> shift) & 0xff, a2 = (a[r] >> shift) & 0xff;
+        const int b0 = (b[l] >> shift) & 0xff, b2 = (b[r] >> shift) & 0xff;
+        const int c0 = (c[l] >> shift) & 0xff, c1 = (c[m] >> shift) & 0xff, c2 = (c[r] >> shift) & 0xff;
+
+        const int gx = (a2 - a0) + 2 * (b2 - b0) + (c2 - c0);
+        const int gy = (c0 - a0) + 2 * (c1 - a1) + (c2 - a2);
+        const int magnitude = qMin(255, int(qSqrt(gx * gx + gy * gy)));
+        result |= quint32(magnitude) << shift;
+    }
+    return result;
+}
+
+void sobelRowScalar(const QRgb* above, const QRgb* row, const QRgb* below, int width, int first, int end, QRgb* out){
+    for(int x = first; x < end; ++x){
+        out[x] = sobelPixel(above, row, below, qMax(x - 1, 0), x, qMin(x + 1, width - 1));
+    }
+}
+
+void convolveFloatScalar(const float* const* rows, const float* weights, int taps, int first, int count, float* out){
+    // The same blocking as convolveColumnScalar(); every value sums its taps in
+    // order k = 0 .. taps - 1, like the vector lanes do.
+    const int block = 256;
+    float acc[block];
+    for(int start = first; start < count; start += block){
+        const int length = qMin(block, count - start);
+        std::fill(acc, acc + length, 0.0f);
+        for(int k = 0; k < taps; ++k){
+            const float* row = rows[k] + start;
+            const float w = weights[k];
+            for(int i = 0; i < length; ++i){
+                acc[i] += w * row[i];
+            }
+        }
+        std::copy(acc, acc + length, out + start);
+    }
+}
+
+void colorMatrixFloatScalar(const float* const* in, float* const* out, int first, int count, const float* matrix){
+    for(int i = first; i < count; ++i){
+        const float r = in[0][i], g = in[1][i], b = in[2][i], a = in[3][i];
+        for(int c = 0; c < 4; ++c){
+            const float* row = matrix + 5 * c;
+            out[c][i] = row[0] * r + row[1] * g + row[2] * b + row[3] * a + row[4];
+        }
+    }
+}
+
+const float kUnitFromWord = 1.0f / 65535.0f;
+
+void unpackRgba64Scalar(const quint16* in, int first, int count, float* const* planes){
+    for(int i = first; i < count; ++i){
+        for(int c = 0; c < 4; ++c){
+            planes[c][i] = float(in[4 * i + c]) * kUnitFromWord;
+        }
+    }
+}
+
+void packRgba64Scalar(const float* const* planes, int first, int count, quint16* out){
+    for(int i = first; i < count; ++i){
+        for(int c = 0; c < 4; ++c){
+            const float scaled = qBound(0.0f, planes[c][i], 1.0f) * 65535.0f;
+            out[4 * i + c] = quint16(scaled + 0.5f);
+        }
+    }
+}
+
+void transpose32Scalar(const quint32* src, qptrdiff srcStride, quint32* dst, qptrdiff dstStride,
+                       int width, int height, int firstRow){
+    for(int y = firstRow; y < height; ++y){
+        quint32* out = dst + y * dstStride;
+        for(int x = 0; x < width; ++x){
+            out[x] = src[x * srcStride + y];
+        }
+    }
+}
+
+void reverse32Scalar(const quint32* in, quint32* out, int first, int end, int count){
+    if(in == out){
+        std::reverse(out + first, out + end);
+        return;
+    }
+    for(int i = first; i < end; ++i){
+        out[count - 1 - i] = in[i];
+    }
+}
+
+// x / 255 rounded to nearest, for 0 <= x <= 65535; the vector kernels divide the same way.
+inline int divide255(int x){
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Source-over of color at alpha (0..255) onto a non-premultiplied pixel.
+inline QRgb blendPixel(QRgb dst, QRgb color, int alpha){
+    const int dstAlpha = qAlpha(dst);
+    if(dstAlpha == 255){
+        const int keep = 255 - alpha;
+        return qRgba(divide255(qRed(dst) * keep + qRed(color) * alpha),
+                     divide255(qGreen(dst) * keep + qGreen(color) * alpha),
+                     divide255(qBlue(dst) * keep + qBlue(color) * alpha), 255);
+    }
+    const int srcWeight = alpha * 255;
+    const int dstWeight = dstAlpha * (255 - alpha);
+    // The unrounded output alpha, times 255.
+    const int denominator = srcWeight + dstWeight;
+    if(denominator == 0){
+        return 0;
+    }
+    const int outAlpha = divide255(denominator);
+    const auto mix = [&](int s, int d){
+        return qMin(255, (s * srcWeight + d * dstWeight + denominator / 2) / denominator);
+    };
+    return qRgba(mix(qRed(color), qRed(dst)), mix(qGreen(color), qGreen(dst)), mix(qBlue(color), qBlue(dst)), outAlpha);
+}
+
+void blendCoverageScalar(QRgb* pixels, const uchar* coverage, int first, int count, QRgb color){
+    const int colorAlpha = qAlpha(color);
+    for(int i = first; i < count; ++i){
+        if(coverage[i]){
+            const int alpha = divide255(coverage[i] * colorAlpha);
+            if(alpha){
+                pixels[i] = blendPixel(pixels[i], color, alpha);
+            }
+        }
+    }
+}
+
+// Remap coordinates split into the pixel left of or above the position and the
+// fraction towards the next one.
+const int kRemapOne = 1 << SimdKernels::RemapFractionBits;
+const int kRemapMask = kRemapOne - 1;
+const int kBilinearShift = 2 * SimdKernels::RemapFractionBits;
+
+// Bicubic weights in 5.11 fixed point. A row of the 4x4 neighbourhood is reduced to
+// 8.7 fixed point like convolveRow() output, so the vertical step fits madd too.
+const int kCubicShift = 11;
+const int kCubicRowShift = kCubicShift - SimdKernels::RowFractionBits;
+const int kCubicColumnShift = kCubicShift + SimdKernels::RowFractionBits;
+
+// Weights of the taps at -1, 0, 1 and 2 pixels for every fraction, each set
+// summing to exactly 1 << kCubicShift.
+struct CubicWeights{
+    qint16 taps[kRemapOne][4];
+
+    CubicWeights(){
+        for(int f = 0; f < kRemapOne; ++f){
+            const double t = double(f) / kRemapOne;
+            const double exact[4] = { keys(1 + t), keys(t), keys(1 - t), keys(2 - t) };
+            int sum = 0, largest = 0;
+            for(int k = 0; k < 4; ++k){
+                taps[f][k] = qint16(qRound(exact[k] * (1 << kCubicShift)));
+                sum += taps[f][k];
+                if(taps[f][k] > taps[f][largest]){
+                    largest = k;
+                }
+            }
+            taps[f][largest] += qint16((1 << kCubicShift) - sum);
+        }
+    }
+
+    // Keys' cubic convolution kernel with a = -0.5 for 0 <= x <= 2.
+    static double keys(double x){
+        const double a = -0.5;
+        if(x < 1){
+            return ((a + 2) * x - (a + 3)) * x * x + 1;
+        }
+        return ((a * x - 5 * a) * x + 8 * a) * x - 4 * a;
+    }
+};
+
+const CubicWeights& cubicWeights(){
+    static const CubicWeights weights;
+    return weights;
+}
+
+inline QRgb remapPixel(const SimdKernels::RemapSource& src, int x, int y){
+    if(x < 0 || y < 0 || x >= src.width || y >= src.height){
+        if(!src.clampEdges){
+            return 0;
+        }
+        x = qBound(0, x, src.width - 1);
+        y = qBound(0, y, src.height - 1);
+    }
+    return src.bits[y * src.stride + x];
+}
+
+void remapNearestScalar(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int first, int count, QRgb* out){
+    const int half = kRemapOne / 2;
+    for(int i = first; i < count; ++i){
+        out[i] = remapPixel(src, (xs[i] + half) >> SimdKernels::RemapFractionBits, (ys[i] + half) >> SimdKernels::RemapFractionBits);
+    }
+}
+
+inline QRgb bilinearPixel(const SimdKernels::RemapSource& src, qint32 x, qint32 y){
+    const int x0 = x >> SimdKernels::RemapFractionBits;
+    const int y0 = y >> SimdKernels::RemapFractionBits;
+    if(!src.clampEdges && (x0 < -1 || y0 < -1 || x0 >= src.width || y0 >= src.height)){
+        return 0;
+    }
+    const int fx = x & kRemapMask;
+    const int fy = y & kRemapMask;
+    const QRgb p00 = remapPixel(src, x0, y0);
+    const QRgb p01 = remapPixel(src, x0 + 1, y0);
+    const QRgb p10 = remapPixel(src, x0, y0 + 1);
+    const QRgb p11 = remapPixel(src, x0 + 1, y0 + 1);
+    QRgb result = 0;
+    for(int shift = 0; shift < 32; shift += 8){
+        const int top = int((p00 >> shift) & 0xff) * (kRemapOne - fx) + int((p01 >> shift) & 0xff) * fx;
+        const int bottom = int((p10 >> shift) & 0xff) * (kRemapOne - fx) + int((p11 >> shift) & 0xff) * fx;
+        const int value = (top * (kRemapOne - fy) + bottom * fy + (1 << (kBilinearShift - 1))) >> kBilinearShift;
+        result |= QRgb(value) << shift;
+    }
+    return result;
+}
+
+void remapBilinearScalar(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int first, int count, QRgb* out){
+    for(int i = first; i < count; ++i){
+        out[i] = bilinearPixel(src, xs[i], ys[i]);
+    }
+}
+
+inline QRgb bicubicPixel(const SimdKernels::RemapSource& src, qint32 x, qint32 y, const CubicWeights& cubic){
+    const int x0 = x >> SimdKernels::RemapFractionBits;
+    const int y0 = y >> SimdKernels::RemapFractionBits;
+    if(!src.clampEdges && (x0 < -2 || y0 < -2 || x0 > src.width || y0 > src.height)){
+        return 0;
+    }
+    const qint16* wx = cubic.taps[x & kRemapMask];
+    const qint16* wy = cubic.taps[y & kRemapMask];
+    const int limit = 255 << SimdKernels::RowFractionBits;
+    int sums[4] = { 0, 0, 0, 0 };
+    for(int j = 0; j < 4; ++j){
+        QRgb row[4];
+        for(int k = 0; k < 4; ++k){
+            row[k] = remapPixel(src, x0 - 1 + k, y0 - 1 + j);
+        }
+        for(int c = 0; c < 4; ++c){
+            int h = 0;
+            for(int k = 0; k < 4; ++k){
+                h += wx[k] * int((row[k] >> (8 * c)) & 0xff);
+            }
+            sums[c] += wy[j] * qBound(0, (h + (1 << (kCubicRowShift - 1))) >> kCubicRowShift, limit);
+        }
+    }
+    int values[4];
+    for(int c = 0; c < 4; ++c){
+        values[c] = qBound(0, (sums[c] + (1 << (kCubicColumnShift - 1))) >> kCubicColumnShift, 255);
+    }
+    const int alpha = values[3];
+    return qRgba(qMin(values[2], alpha), qMin(values[1], alpha), qMin(values[0], alpha), alpha);
+}
+
+void remapBicubicScalar(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int first, int count, QRgb* out){
+    const CubicWeights& cubic = cubicWeights();
+    for(int i = first; i < count; ++i){
+        out[i] = bicubicPixel(src, xs[i], ys[i], cubic);
+    }
+}
+
+void lookupPlain(const QRgb* in, QRgb* out, int count, const uchar* table){
+    lookupScalar(in, out, 0, count, table);
+}
+
+void colorMatrixPlain(const QRgb* in, QRgb* out, int count, const SimdKernels::FixedColorMatrix& matrix){
+    colorMatrixScalar(in, out, 0, count, matrix);
+}
+
+void convolveRowPlain(const QRgb* padded, int width, const int* weights, int taps, quint16* out){
+    convolveRowScalar(padded, 0, width, weights, taps, out);
+}
+
+void convolveColumnPlain(const quint16* const* rows, const int* weights, int taps, int count, uchar* out){
+    convolveColumnScalar(rows, weights, taps, 0, count, out);
+}
+
+void resampleRowPlain(const QRgb* in, const int* starts, const qint16* weights, int taps, int count, quint16* out){
+    resampleRowScalar(in, starts, weights, taps, 0, count, out);
+}
+
+void sobelRowPlain(const QRgb* above, const QRgb* row, const QRgb* below, int width, QRgb* out){
+    sobelRowScalar(above, row, below, width, 0, width, out);
+}
+
+void convolveFloatPlain(const float* const* rows, const float* weights, int taps, int count, float* out){
+    convolveFloatScalar(rows, weights, taps, 0, count, out);
+}
+
+void colorMatrixFloatPlain(const float* const* in, float* const* out, int count, const float* matrix){
+    colorMatrixFloatScalar(in, out, 0, count, matrix);
+}
+
+void unpackRgba64Plain(const quint16* in, int count, float* const* planes){
+    unpackRgba64Scalar(in, 0, count, planes);
+}
+
+void packRgba64Plain(const float* const* planes, int count, quint16* out){
+    packRgba64Scalar(planes, 0, count, out);
+}
+
+void transpose32Plain(const quint32* src, qptrdiff srcStride, quint32* dst, qptrdiff dstStride, int width, int height){
+    transpose32Scalar(src, srcStride, dst, dstStride, width, height, 0);
+}
+
+void reverse32Plain(const quint32* in, quint32* out, int count){
+    reverse32Scalar(in, out, 0, count, count);
+}
+
+void remapNearestPlain(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out){
+    remapNearestScalar(src, xs, ys, 0, count, out);
+}
+
+void remapBilinearPlain(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out){
+    remapBilinearScalar(src, xs, ys, 0, count, out);
+}
+
+void remapBicubicPlain(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out){
+    remapBicubicScalar(src, xs, ys, 0, count, out);
+}
+
+void blendCoveragePlain(QRgb* pixels, const uchar* coverage, int count, QRgb color){
+    blendCoverageScalar(pixels, coverage, 0, count, color);
+}
+
+#ifdef SIMD_X86
+
+// The Sobel magnitude is computed in float: gx^2 + gy^2 is an exact integer below
+// 2^24 and sqrtps is correctly rounded, so truncating gives the same values as qSqrt().
+
+// SSE2: 4 pixels per step. Intermediate rows are 8.7 fixed point (at most 32640)
+// so they fit the signed 16-bit inputs of madd.
+
+// Color matrix operands for madd: the coefficients of the input pairs (blue, red)
+// and (green, alpha) of one output channel, packed into 16-bit halves.
+inline int coefficientPair(qint16 low, qint16 high){
+    return int(quint32(quint16(low)) | (quint32(quint16(high)) << 16));
+}
+
+SIMD_TARGET("sse2")
+void colorMatrixSse2(const QRgb* in, QRgb* out, int count, const SimdKernels::FixedColorMatrix& matrix){
+    __m128i blueRed[4], greenAlpha[4], offsets[4];
+    for(int c = 0; c < 4; ++c){
+        blueRed[c] = _mm_set1_epi32(coefficientPair(matrix.coefficients[c][0], matrix.coefficients[c][2]));
+        greenAlpha[c] = _mm_set1_epi32(coefficientPair(matrix.coefficients[c][1], matrix.coefficients[c][3]));
+        offsets[c] = _mm_set1_epi32(matrix.offsets[c]);
+    }
+    const __m128i evenBytes = _mm_set1_epi32(0x00ff00ff);
+
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        // Every 32-bit lane holds (blue, red) and (green, alpha) as 16-bit pairs, so one
+        // madd per pair gives two products of a channel row.
+        const __m128i br = _mm_and_si128(p, evenBytes);
+        const __m128i ga = _mm_and_si128(_mm_srli_epi32(p, 8), evenBytes);
+        __m128i channels[4];
+        for(int c = 0; c < 4; ++c){
+            const __m128i sum = _mm_add_epi32(_mm_madd_epi16(br, blueRed[c]), _mm_madd_epi16(ga, greenAlpha[c]));
+            channels[c] = _mm_srai_epi32(_mm_add_epi32(sum, offsets[c]), SimdKernels::ColorMatrixShift);
+        }
+        // Saturating packs clamp to 0..255 and leave the bytes planar: 4 blue, 4 green,
+        // 4 red, 4 alpha. The unpacks interleave them back into pixels.
+        const __m128i planar = _mm_packus_epi16(_mm_packs_epi32(channels[0], channels[1]),
+                                                _mm_packs_epi32(channels[2], channels[3]));
+        const __m128i blueGreen = _mm_unpacklo_epi8(planar, _mm_srli_si128(planar, 4));
+        const __m128i redAlpha = _mm_unpacklo_epi8(_mm_srli_si128(planar, 8), _mm_srli_si128(planar, 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(blueGreen, redAlpha));
+    }
+    colorMatrixScalar(in, out, i, count, matrix);
+}
+
+SIMD_TARGET("sse2")
+void convolveRowSse2(const QRgb* padded, int width, const int* weights, int taps, quint16* out){
+    const WeightPairs pairs(weights, taps);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi32(1 << (kRowShift - 1));
+    int x = 0;
+    for(; x + 4 <= width; x += 4){
+        // acc<n> collects output pixel x + n; each madd adds the taps k and k + 1.
+        __m128i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+        for(int k = 0; k < taps; k += 2){
+            const __m128i w = _mm_set1_epi32(pairs[k / 2]);
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(padded + x + k));
+            const __m128i b = (k + 1 < taps) ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(padded + x + k + 1)) : a;
+            const __m128i aLow = _mm_unpacklo_epi8(a, zero), aHigh = _mm_unpackhi_epi8(a, zero);
+            const __m128i bLow = _mm_unpacklo_epi8(b, zero), bHigh = _mm_unpackhi_epi8(b, zero);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(aLow, bLow), w));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(aLow, bLow), w));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(aHigh, bHigh), w));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(aHigh, bHigh), w));
+        }
+        acc0 = _mm_srai_epi32(_mm_add_epi32(acc0, half), kRowShift);
+        acc1 = _mm_srai_epi32(_mm_add_epi32(acc1, half), kRowShift);
+        acc2 = _mm_srai_epi32(_mm_add_epi32(acc2, half), kRowShift);
+        acc3 = _mm_srai_epi32(_mm_add_epi32(acc3, half), kRowShift);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * x), _mm_packs_epi32(acc0, acc1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * x + 8), _mm_packs_epi32(acc2, acc3));
+    }
+    convolveRowScalar(padded, x, width, weights, taps, out);
+}
+
+SIMD_TARGET("sse2")
+void convolveColumnSse2(const quint16* const* rows, const int* weights, int taps, int count, uchar* out){
+    const WeightPairs pairs(weights, taps);
+    const __m128i half = _mm_set1_epi32(1 << (kColumnShift - 1));
+    int i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m128i low = half, high = half;
+        for(int k = 0; k < taps; k += 2){
+            const __m128i w = _mm_set1_epi32(pairs[k / 2]);
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+            const __m128i b = (k + 1 < taps) ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + i)) : a;
+            low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        const __m128i words = _mm_packs_epi32(_mm_srai_epi32(low, kColumnShift), _mm_srai_epi32(high, kColumnShift));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(words, words));
+    }
+    convolveColumnScalar(rows, weights, taps, i, count, out);
+}
+
+// Adds taps first..taps - 1 of one output pixel to the four channel sums in acc.
+// Four taps per step: the channels of neighbouring input pixels are interleaved so
+// that each madd multiplies two pixels with a pair of adjacent weights.
+SIMD_TARGET("sse2")
+inline __m128i resampleTapsSse2(const QRgb* window, const qint16* weights, int first, int taps, __m128i acc){
+    const __m128i zero = _mm_setzero_si128();
+    int k = first;
+    for(; k + 4 <= taps; k += 4){
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(window + k));
+        const __m128i low = _mm_unpacklo_epi8(pixels, zero);
+        const __m128i high = _mm_unpackhi_epi8(pixels, zero);
+        const __m128i w = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights + k));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(low, _mm_srli_si128(low, 8)), _mm_shuffle_epi32(w, 0x00)));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(high, _mm_srli_si128(high, 8)), _mm_shuffle_epi32(w, 0x55)));
+    }
+    for(; k < taps; ++k){
+        const __m128i pixel = _mm_unpacklo_epi8(_mm_cvtsi32_si128(int(window[k])), zero);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(pixel, zero), _mm_set1_epi32(quint16(weights[k]))));
+    }
+    return acc;
+}
+
+// Rounds, clamps and stores the channel sums of one output pixel.
+SIMD_TARGET("sse2")
+inline void storeResampledSse2(__m128i acc, quint16* out){
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i limit = _mm_set1_epi16(255 << SimdKernels::RowFractionBits);
+    const __m128i half = _mm_set1_epi32(1 << (kRowShift - 1));
+    const __m128i words = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(acc, half), kRowShift), zero);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_min_epi16(_mm_max_epi16(words, zero), limit));
+}
+
+SIMD_TARGET("sse2")
+void resampleRowSse2(const QRgb* in, const int* starts, const qint16* weights, int taps, int count, quint16* out){
+    for(int x = 0; x < count; ++x){
+        const __m128i acc = resampleTapsSse2(in + starts[x], weights + x * taps, 0, taps, _mm_setzero_si128());
+        storeResampledSse2(acc, out + 4 * x);
+    }
+}
+
+// Magnitudes of 2 pixels from the 16-bit channels of their neighbourhood.
+SIMD_TARGET("sse2")
+inline __m128i sobelMagnitudeSse2(__m128i aL, __m128i aM, __m128i aR, __m128i bL, __m128i bR,
+                                  __m128i cL, __m128i cM, __m128i cR){
+    __m128i gx = _mm_add_epi16(_mm_sub_epi16(aR, aL), _mm_sub_epi16(cR, cL));
+    gx = _mm_add_epi16(gx, _mm_slli_epi16(_mm_sub_epi16(bR, bL), 1));
+    __m128i gy = _mm_add_epi16(_mm_sub_epi16(cL, aL), _mm_sub_epi16(cR, aR));
+    gy = _mm_add_epi16(gy, _mm_slli_epi16(_mm_sub_epi16(cM, aM), 1));
+
+    const __m128i first = _mm_unpacklo_epi16(gx, gy);
+    const __m128i second = _mm_unpackhi_epi16(gx, gy);
+    const __m128 squared0 = _mm_cvtepi32_ps(_mm_madd_epi16(first, first));
+    const __m128 squared1 = _mm_cvtepi32_ps(_mm_madd_epi16(second, second));
+    return _mm_packs_epi32(_mm_cvttps_epi32(_mm_sqrt_ps(squared0)), _mm_cvttps_epi32(_mm_sqrt_ps(squared1)));
+}
+
+SIMD_TARGET("sse2")
+void sobelRowSse2(const QRgb* above, const QRgb* row, const QRgb* below, int width, QRgb* out){
+    sobelRowScalar(above, row, below, width, 0, qMin(1, width), out);
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi32(int(0xff000000u));
+    int x = 1;
+    for(; x + 4 < width; x += 4){
+        const __m128i aL = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x - 1));
+        const __m128i aM = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x));
+        const __m128i aR = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x + 1));
+        const __m128i bL = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x - 1));
+        const __m128i bR = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 1));
+        const __m128i cL = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x - 1));
+        const __m128i cM = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x));
+        const __m128i cR = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x + 1));
+
+        const __m128i low = sobelMagnitudeSse2(
+                    _mm_unpacklo_epi8(aL, zero), _mm_unpacklo_epi8(aM, zero), _mm_unpacklo_epi8(aR, zero),
+                    _mm_unpacklo_epi8(bL, zero), _mm_unpacklo_epi8(bR, zero),
+                    _mm_unpacklo_epi8(cL, zero), _mm_unpacklo_epi8(cM, zero), _mm_unpacklo_epi8(cR, zero));
+        const __m128i high = sobelMagnitudeSse2(
+                    _mm_unpackhi_epi8(aL, zero), _mm_unpackhi_epi8(aM, zero), _mm_unpackhi_epi8(aR, zero),
+                    _mm_unpackhi_epi8(bL, zero), _mm_unpackhi_epi8(bR, zero),
+                    _mm_unpackhi_epi8(cL, zero), _mm_unpackhi_epi8(cM, zero), _mm_unpackhi_epi8(cR, zero));
+        // packus clamps the magnitudes to 255.
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_or_si128(_mm_packus_epi16(low, high), alpha));
+    }
+    sobelRowScalar(above, row, below, width, x, width, out);
+}
+
+SIMD_TARGET("sse2")
+void convolveFloatSse2(const float* const* rows, const float* weights, int taps, int count, float* out){
+    int i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m128 low = _mm_setzero_ps(), high = _mm_setzero_ps();
+        for(int k = 0; k < taps; ++k){
+            const __m128 w = _mm_set1_ps(weights[k]);
+            low = _mm_add_ps(low, _mm_mul_ps(w, _mm_loadu_ps(rows[k] + i)));
+            high = _mm_add_ps(high, _mm_mul_ps(w, _mm_loadu_ps(rows[k] + i + 4)));
+        }
+        _mm_storeu_ps(out + i, low);
+        _mm_storeu_ps(out + i + 4, high);
+    }
+    convolveFloatScalar(rows, weights, taps, i, count, out);
+}
+
+SIMD_TARGET("sse2")
+void colorMatrixFloatSse2(const float* const* in, float* const* out, int count, const float* matrix){
+    __m128 m[4][5];
+    for(int c = 0; c < 4; ++c){
+        for(int j = 0; j < 5; ++j){
+            m[c][j] = _mm_set1_ps(matrix[5 * c + j]);
+        }
+    }
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        const __m128 r = _mm_loadu_ps(in[0] + i), g = _mm_loadu_ps(in[1] + i);
+        const __m128 b = _mm_loadu_ps(in[2] + i), a = _mm_loadu_ps(in[3] + i);
+        __m128 results[4];
+        for(int c = 0; c < 4; ++c){
+            __m128 value = _mm_add_ps(_mm_mul_ps(m[c][0], r), _mm_mul_ps(m[c][1], g));
+            value = _mm_add_ps(value, _mm_mul_ps(m[c][2], b));
+            value = _mm_add_ps(value, _mm_mul_ps(m[c][3], a));
+            results[c] = _mm_add_ps(value, m[c][4]);
+        }
+        for(int c = 0; c < 4; ++c){
+            _mm_storeu_ps(out[c] + i, results[c]);
+        }
+    }
+    colorMatrixFloatScalar(in, out, i, count, matrix);
+}
+
+// The RGBA64 conversions widen 4 pixels to one float vector each and transpose
+// them into the planes. They are also used on the AVX paths, where the 128-bit
+// transpose is as fast as the lane-crossing one.
+SIMD_TARGET("sse2")
+void unpackRgba64Sse2(const quint16* in, int count, float* const* planes){
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(kUnitFromWord);
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * i));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * i + 8));
+        __m128 p0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(first, zero));
+        __m128 p1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(first, zero));
+        __m128 p2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(second, zero));
+        __m128 p3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(second, zero));
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        _mm_storeu_ps(planes[0] + i, _mm_mul_ps(p0, scale));
+        _mm_storeu_ps(planes[1] + i, _mm_mul_ps(p1, scale));
+        _mm_storeu_ps(planes[2] + i, _mm_mul_ps(p2, scale));
+        _mm_storeu_ps(planes[3] + i, _mm_mul_ps(p3, scale));
+    }
+    unpackRgba64Scalar(in, i, count, planes);
+}
+
+SIMD_TARGET("sse2")
+inline __m128 quantizeSse2(__m128 value){
+    const __m128 clamped = _mm_max_ps(_mm_setzero_ps(), _mm_min_ps(_mm_set1_ps(1.0f), value));
+    return _mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(65535.0f)), _mm_set1_ps(0.5f));
+}
+
+SIMD_TARGET("sse2")
+void packRgba64Sse2(const float* const* planes, int count, quint16* out){
+    // SSE2 only packs to signed words, so values are biased by -32768 and back.
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i flip = _mm_set1_epi16(short(0x8000));
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m128 p0 = quantizeSse2(_mm_loadu_ps(planes[0] + i));
+        __m128 p1 = quantizeSse2(_mm_loadu_ps(planes[1] + i));
+        __m128 p2 = quantizeSse2(_mm_loadu_ps(planes[2] + i));
+        __m128 p3 = quantizeSse2(_mm_loadu_ps(planes[3] + i));
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        const __m128i w0 = _mm_sub_epi32(_mm_cvttps_epi32(p0), bias);
+        const __m128i w1 = _mm_sub_epi32(_mm_cvttps_epi32(p1), bias);
+        const __m128i w2 = _mm_sub_epi32(_mm_cvttps_epi32(p2), bias);
+        const __m128i w3 = _mm_sub_epi32(_mm_cvttps_epi32(p3), bias);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i), _mm_xor_si128(_mm_packs_epi32(w0, w1), flip));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i + 8), _mm_xor_si128(_mm_packs_epi32(w2, w3), flip));
+    }
+    packRgba64Scalar(planes, i, count, out);
+}
+
+// Transposes 4x4 micro-tiles in registers; leftover rows and columns are scalar.
+SIMD_TARGET("sse2")
+void transpose32Sse2(const quint32* src, qptrdiff srcStride, quint32* dst, qptrdiff dstStride, int width, int height){
+    const int fullWidth = width & ~3;
+    int y = 0;
+    for(; y + 4 <= height; y += 4){
+        for(int x = 0; x < fullWidth; x += 4){
+            const quint32* in = src + x * srcStride + y;
+            __m128 r0 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+            __m128 r1 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + srcStride)));
+            __m128 r2 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * srcStride)));
+            __m128 r3 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 3 * srcStride)));
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            quint32* out = dst + y * dstStride + x;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_castps_si128(r0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + dstStride), _mm_castps_si128(r1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * dstStride), _mm_castps_si128(r2));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 3 * dstStride), _mm_castps_si128(r3));
+        }
+        for(int row = y; row < y + 4; ++row){
+            for(int x = fullWidth; x < width; ++x){
+                dst[row * dstStride + x] = src[x * srcStride + row];
+            }
+        }
+    }
+    transpose32Scalar(src, srcStride, dst, dstStride, width, height, y);
+}
+
+// In place, vectors are swapped pairwise from both ends and the middle is left to
+// the scalar code; otherwise every vector is reversed into its mirrored position.
+SIMD_TARGET("sse2")
+void reverse32Sse2(const quint32* in, quint32* out, int count){
+    if(in == out){
+        int i = 0, j = count - 4;
+        for(; i + 4 <= j; i += 4, j -= 4){
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + j));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_shuffle_epi32(b, 0x1b));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), _mm_shuffle_epi32(a, 0x1b));
+        }
+        reverse32Scalar(in, out, i, j + 4, count);
+        return;
+    }
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + count - 4 - i), _mm_shuffle_epi32(v, 0x1b));
+    }
+    reverse32Scalar(in, out, i, count, count);
+}
+
+// Coverage blending mixes opaque pixels in 16-bit channels, the effective alpha of
+// each pixel spread over its four channels. Groups with a translucent pixel take the
+// scalar code, and groups with no coverage at all are skipped.
+SIMD_TARGET("sse2")
+inline __m128i divide255Sse2(__m128i x){
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// d * (255 - alpha) + s * alpha stays below 65536, so unsigned 16-bit lanes suffice.
+SIMD_TARGET("sse2")
+inline __m128i mixSse2(__m128i dst, __m128i src, __m128i alpha){
+    const __m128i keep = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    return divide255Sse2(_mm_add_epi16(_mm_mullo_epi16(dst, keep), _mm_mullo_epi16(src, alpha)));
+}
+
+SIMD_TARGET("sse2")
+void blendCoverageSse2(QRgb* pixels, const uchar* coverage, int count, QRgb color){
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32(int(0xff000000u));
+    // The alpha lanes mix towards 255, so opaque pixels stay opaque.
+    const __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32(int(color | 0xff000000u)), zero);
+    const __m128i colorAlpha = _mm_set1_epi32(qAlpha(color));
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        int covered;
+        memcpy(&covered, coverage + i, sizeof(covered));
+        if(!covered){
+            continue;
+        }
+        __m128i* p = reinterpret_cast<__m128i*>(pixels + i);
+        const __m128i dst = _mm_loadu_si128(p);
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(dst, opaque), opaque)) != 0xffff){
+            blendCoverageScalar(pixels, coverage, i, i + 4, color);
+            continue;
+        }
+        const __m128i cover = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(covered), zero), zero);
+        const __m128i alpha = divide255Sse2(_mm_mullo_epi16(cover, colorAlpha));
+        const __m128i alphas = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+        const __m128i low = mixSse2(_mm_unpacklo_epi8(dst, zero), src, _mm_unpacklo_epi32(alphas, alphas));
+        const __m128i high = mixSse2(_mm_unpackhi_epi8(dst, zero), src, _mm_unpackhi_epi32(alphas, alphas));
+        _mm_storeu_si128(p, _mm_packus_epi16(low, high));
+    }
+    blendCoverageScalar(pixels, coverage, i, count, color);
+}
+
+// The remap kernels blend the channels of one pixel per 128-bit vector; neighbouring
+// output pixels read unrelated source addresses, so there is nothing to load in
+// bulk. Pixels whose neighbourhood crosses the image border take the scalar code.
+
+inline bool remapInside(const SimdKernels::RemapSource& src, int x0, int y0, int before, int after){
+    return x0 >= before && y0 >= before && x0 + after < src.width && y0 + after < src.height;
+}
+
+// Two pixels' channels interleaved as madd operands: (a.blue, b.blue, a.green, ...).
+SIMD_TARGET("sse2")
+inline __m128i interleavePixelsSse2(__m128i pair){
+    const __m128i words = _mm_unpacklo_epi8(pair, _mm_setzero_si128());
+    return _mm_unpacklo_epi16(words, _mm_srli_si128(words, 8));
+}
+
+SIMD_TARGET("sse2")
+inline QRgb bilinearPixelSse2(const SimdKernels::RemapSource& src, qint32 x, qint32 y){
+    const int x0 = x >> SimdKernels::RemapFractionBits;
+    const int y0 = y >> SimdKernels::RemapFractionBits;
+    if(!remapInside(src, x0, y0, 0, 1)){
+        return bilinearPixel(src, x, y);
+    }
+    const int fx = x & kRemapMask;
+    const int fy = y & kRemapMask;
+    const QRgb* p = src.bits + y0 * src.stride + x0;
+    const __m128i wx = _mm_set1_epi32((fx << 16) | (kRemapOne - fx));
+    const __m128i top = _mm_madd_epi16(interleavePixelsSse2(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))), wx);
+    const __m128i bottom = _mm_madd_epi16(interleavePixelsSse2(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + src.stride))), wx);
+    const __m128i rows = _mm_packs_epi32(top, bottom);
+    __m128i v = _mm_madd_epi16(_mm_unpacklo_epi16(rows, _mm_srli_si128(rows, 8)), _mm_set1_epi32((fy << 16) | (kRemapOne - fy)));
+    v = _mm_srai_epi32(_mm_add_epi32(v, _mm_set1_epi32(1 << (kBilinearShift - 1))), kBilinearShift);
+    v = _mm_packs_epi32(v, v);
+    return QRgb(_mm_cvtsi128_si32(_mm_packus_epi16(v, v)));
+}
+
+SIMD_TARGET("sse2")
+void remapBilinearSse2(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out){
+    for(int i = 0; i < count; ++i){
+        out[i] = bilinearPixelSse2(src, xs[i], ys[i]);
+    }
+}
+
+// One row of the bicubic neighbourhood reduced to 8.7 fixed point, channels in 32 bits.
+SIMD_TARGET("sse2")
+inline __m128i bicubicRowSse2(const QRgb* p, __m128i w01, __m128i w23){
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i low = _mm_unpacklo_epi8(pixels, zero);
+    const __m128i high = _mm_unpackhi_epi8(pixels, zero);
+    const __m128i sum = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(low, _mm_srli_si128(low, 8)), w01),
+                                      _mm_madd_epi16(_mm_unpacklo_epi16(high, _mm_srli_si128(high, 8)), w23));
+    return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (kCubicRowShift - 1))), kCubicRowShift);
+}
+
+// Packs two rows from bicubicRowSse2() to clamped 16-bit values, interleaved for madd.
+SIMD_TARGET("sse2")
+inline __m128i bicubicRowPairSse2(__m128i first, __m128i second){
+    const __m128i rows = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(first, second), _mm_setzero_si128()),
+                                       _mm_set1_epi16(255 << SimdKernels::RowFractionBits));
+    return _mm_unpacklo_epi16(rows, _mm_srli_si128(rows, 8));
+}
+
+SIMD_TARGET("sse2")
+inline QRgb bicubicPixelSse2(const SimdKernels::RemapSource& src, qint32 x, qint32 y, const CubicWeights& cubic){
+    const int x0 = x >> SimdKernels::RemapFractionBits;
+    const int y0 = y >> SimdKernels::RemapFractionBits;
+    if(!remapInside(src, x0, y0, 1, 2)){
+        return bicubicPixel(src, x, y, cubic);
+    }
+    const qint16* wx = cubic.taps[x & kRemapMask];
+    const qint16* wy = cubic.taps[y & kRemapMask];
+    const __m128i wx01 = _mm_set1_epi32(coefficientPair(wx[0], wx[1]));
+    const __m128i wx23 = _mm_set1_epi32(coefficientPair(wx[2], wx[3]));
+    const QRgb* p = src.bits + (y0 - 1) * src.stride + x0 - 1;
+    const __m128i h0 = bicubicRowSse2(p, wx01, wx23);
+    const __m128i h1 = bicubicRowSse2(p + src.stride, wx01, wx23);
+    const __m128i h2 = bicubicRowSse2(p + 2 * src.stride, wx01, wx23);
+    const __m128i h3 = bicubicRowSse2(p + 3 * src.stride, wx01, wx23);
+    __m128i v = _mm_add_epi32(_mm_madd_epi16(bicubicRowPairSse2(h0, h1), _mm_set1_epi32(coefficientPair(wy[0], wy[1]))),
+                              _mm_madd_epi16(bicubicRowPairSse2(h2, h3), _mm_set1_epi32(coefficientPair(wy[2], wy[3]))));
+    v = _mm_srai_epi32(_mm_add_epi32(v, _mm_set1_epi32(1 << (kCubicColumnShift - 1))), kCubicColumnShift);
+    v = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(v, v), _mm_setzero_si128()), _mm_set1_epi16(255));
+    v = _mm_min_epi16(v, _mm_shufflelo_epi16(v, 0xff));
+    return QRgb(_mm_cvtsi128_si32(_mm_packus_epi16(v, v)));
+}
+
+SIMD_TARGET("sse2")
+void remapBicubicSse2(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out){
+    const CubicWeights& cubic = cubicWeights();
+    for(int i = 0; i < count; ++i){
+        out[i] = bicubicPixelSse2(src, xs[i], ys[i], cubic);
+    }
+}
+
+#ifdef SIMD_X86_AVX
+
+// AVX2: 8 pixels per step. Unpacks and packs work within 128-bit lanes, so each
+// lane handles 4 pixels exactly like the SSE2 code and is reordered where needed.
+
+SIMD_TARGET("avx2")
+void lookupAvx2(const QRgb* in, QRgb* out, int count, const uchar* table){
+    // Sixteen 16-entry slices of the table; slice s answers the bytes 16s .. 16s + 15.
+    __m256i slices[16];
+    for(int s = 0; s < 16; ++s){
+        slices[s] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table + 16 * s)));
+    }
+    const __m256i step = _mm256_set1_epi8(16);
+    const __m256i bias = _mm256_set1_epi8(0x70);
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xff000000u));
+
+    int i = 0;
+    for(; i + 8 <= count; i += 8){
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        // After subtracting 16s only the bytes of slice s are below 16; adding 0x70 with
+        // saturation sets the high bit of all others, which makes the shuffle return 0.
+        __m256i index = p;
+        __m256i result = _mm256_setzero_si256();
+        for(int s = 0; s < 16; ++s){
+            result = _mm256_or_si256(result, _mm256_shuffle_epi8(slices[s], _mm256_adds_epu8(index, bias)));
+            index = _mm256_sub_epi8(index, step);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_blendv_epi8(result, p, alphaMask));
+    }
+    lookupScalar(in, out, i, count, table);
+}
+
+SIMD_TARGET("avx2")
+void colorMatrixAvx2(const QRgb* in, QRgb* out, int count, const SimdKernels::FixedColorMatrix& matrix){
+    __m256i blueRed[4], greenAlpha[4], offsets[4];
+    for(int c = 0; c < 4; ++c){
+        blueRed[c] = _mm256_set1_epi32(coefficientPair(matrix.coefficients[c][0], matrix.coefficients[c][2]));
+        greenAlpha[c] = _mm256_set1_epi32(coefficientPair(matrix.coefficients[c][1], matrix.coefficients[c][3]));
+        offsets[c] = _mm256_set1_epi32(matrix.offsets[c]);
+    }
+    const __m256i evenBytes = _mm256_set1_epi32(0x00ff00ff);
+
+    int i = 0;
+    for(; i + 8 <= count; i += 8){
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        const __m256i br = _mm256_and_si256(p, evenBytes);
+        const __m256i ga = _mm256_and_si256(_mm256_srli_epi32(p, 8), evenBytes);
+        __m256i channels[4];
+        for(int c = 0; c < 4; ++c){
+            const __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(br, blueRed[c]), _mm256_madd_epi16(ga, greenAlpha[c]));
+            channels[c] = _mm256_srai_epi32(_mm256_add_epi32(sum, offsets[c]), SimdKernels::ColorMatrixShift);
+        }
+        const __m256i planar = _mm256_packus_epi16(_mm256_packs_epi32(channels[0], channels[1]),
+                                                   _mm256_packs_epi32(channels[2], channels[3]));
+        const __m256i blueGreen = _mm256_unpacklo_epi8(planar, _mm256_srli_si256(planar, 4));
+        const __m256i redAlpha = _mm256_unpacklo_epi8(_mm256_srli_si256(planar, 8), _mm256_srli_si256(planar, 12));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_unpacklo_epi16(blueGreen, redAlpha));
+    }
+    colorMatrixScalar(in, out, i, count, matrix);
+}
+
+SIMD_TARGET("avx2")
+void convolveRowAvx2(const QRgb* padded, int width, const int* weights, int taps, quint16* out){
+    const WeightPairs pairs(weights, taps);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi32(1 << (kRowShift - 1));
+    int x = 0;
+    for(; x + 8 <= width; x += 8){
+        // Lane 0 of acc<n> collects output pixel x + n, lane 1 pixel x + 4 + n.
+        __m256i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+        for(int k = 0; k < taps; k += 2){
+            const __m256i w = _mm256_set1_epi32(pairs[k / 2]);
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(padded + x + k));
+            const __m256i b = (k + 1 < taps) ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(padded + x + k + 1)) : a;
+            const __m256i aLow = _mm256_unpacklo_epi8(a, zero), aHigh = _mm256_unpackhi_epi8(a, zero);
+            const __m256i bLow = _mm256_unpacklo_epi8(b, zero), bHigh = _mm256_unpackhi_epi8(b, zero);
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi16(aLow, bLow), w));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi16(aLow, bLow), w));
+            acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi16(aHigh, bHigh), w));
+            acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi16(aHigh, bHigh), w));
+        }
+        acc0 = _mm256_srai_epi32(_mm256_add_epi32(acc0, half), kRowShift);
+        acc1 = _mm256_srai_epi32(_mm256_add_epi32(acc1, half), kRowShift);
+        acc2 = _mm256_srai_epi32(_mm256_add_epi32(acc2, half), kRowShift);
+        acc3 = _mm256_srai_epi32(_mm256_add_epi32(acc3, half), kRowShift);
+        const __m256i pixels01 = _mm256_packs_epi32(acc0, acc1);
+        const __m256i pixels23 = _mm256_packs_epi32(acc2, acc3);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * x), _mm256_permute2x128_si256(pixels01, pixels23, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * x + 16), _mm256_permute2x128_si256(pixels01, pixels23, 0x31));
+    }
+    convolveRowScalar(padded, x, width, weights, taps, out);
+}
+
+SIMD_TARGET("avx2")
+void convolveColumnAvx2(const quint16* const* rows, const int* weights, int taps, int count, uchar* out){
+    const WeightPairs pairs(weights, taps);
+    const __m256i half = _mm256_set1_epi32(1 << (kColumnShift - 1));
+    int i = 0;
+    for(; i + 16 <= count; i += 16){
+        __m256i low = half, high = half;
+        for(int k = 0; k < taps; k += 2){
+            const __m256i w = _mm256_set1_epi32(pairs[k / 2]);
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + i));
+            const __m256i b = (k + 1 < taps) ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k + 1] + i)) : a;
+            low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        const __m256i words = _mm256_packs_epi32(_mm256_srai_epi32(low, kColumnShift), _mm256_srai_epi32(high, kColumnShift));
+        const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(bytes));
+    }
+    convolveColumnScalar(rows, weights, taps, i, count, out);
+}
+
+// Eight taps per step, four in each lane; the lanes are added up at the end.
+SIMD_TARGET("avx2")
+void resampleRowAvx2(const QRgb* in, const int* starts, const qint16* weights, int taps, int count, quint16* out){
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i firstPairs = _mm256_setr_epi32(0, 0, 0, 0, 2, 2, 2, 2);
+    const __m256i secondPairs = _mm256_setr_epi32(1, 1, 1, 1, 3, 3, 3, 3);
+    for(int x = 0; x < count; ++x){
+        const QRgb* window = in + starts[x];
+        const qint16* w = weights + x * taps;
+        __m256i acc = zero;
+        int k = 0;
+        for(; k + 8 <= taps; k += 8){
+            const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(window + k));
+            const __m256i low = _mm256_unpacklo_epi8(pixels, zero);
+            const __m256i high = _mm256_unpackhi_epi8(pixels, zero);
+            const __m256i pairs = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w + k)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpacklo_epi16(low, _mm256_srli_si256(low, 8)),
+                                                          _mm256_permutevar8x32_epi32(pairs, firstPairs)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpacklo_epi16(high, _mm256_srli_si256(high, 8)),
+                                                          _mm256_permutevar8x32_epi32(pairs, secondPairs)));
+        }
+        const __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        storeResampledSse2(resampleTapsSse2(window, w, k, taps, sum), out + 4 * x);
+    }
+}
+
+SIMD_TARGET("avx2")
+inline __m256i sobelMagnitudeAvx2(__m256i aL, __m256i aM, __m256i aR, __m256i bL, __m256i bR,
+                                  __m256i cL, __m256i cM, __m256i cR){
+    __m256i gx = _mm256_add_epi16(_mm256_sub_epi16(aR, aL), _mm256_sub_epi16(cR, cL));
+    gx = _mm256_add_epi16(gx, _mm256_slli_epi16(_mm256_sub_epi16(bR, bL), 1));
+    __m256i gy = _mm256_add_epi16(_mm256_sub_epi16(cL, aL), _mm256_sub_epi16(cR, aR));
+    gy = _mm256_add_epi16(gy, _mm256_slli_epi16(_mm256_sub_epi16(cM, aM), 1));
+
+    const __m256i first = _mm256_unpacklo_epi16(gx, gy);
+    const __m256i second = _mm256_unpackhi_epi16(gx, gy);
+    const __m256 squared0 = _mm256_cvtepi32_ps(_mm256_madd_epi16(first, first));
+    const __m256 squared1 = _mm256_cvtepi32_ps(_mm256_madd_epi16(second, second));
+    return _mm256_packs_epi32(_mm256_cvttps_epi32(_mm256_sqrt_ps(squared0)), _mm256_cvttps_epi32(_mm256_sqrt_ps(squared1)));
+}
+
+SIMD_TARGET("avx2")
+void sobelRowAvx2(const QRgb* above, const QRgb* row, const QRgb* below, int width, QRgb* out){
+    sobelRowScalar(above, row, below, width, 0, qMin(1, width), out);
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alpha = _mm256_set1_epi32(int(0xff000000u));
+    int x = 1;
+    for(; x + 8 < width; x += 8){
+        const __m256i aL = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x - 1));
+        const __m256i aM = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x));
+        const __m256i aR = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x + 1));
+        const __m256i bL = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x - 1));
+        const __m256i bR = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x + 1));
+        const __m256i cL = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x - 1));
+        const __m256i cM = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x));
+        const __m256i cR = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x + 1));
+
+        const __m256i low = sobelMagnitudeAvx2(
+                    _mm256_unpacklo_epi8(aL, zero), _mm256_unpacklo_epi8(aM, zero), _mm256_unpacklo_epi8(aR, zero),
+                    _mm256_unpacklo_epi8(bL, zero), _mm256_unpacklo_epi8(bR, zero),
+                    _mm256_unpacklo_epi8(cL, zero), _mm256_unpacklo_epi8(cM, zero), _mm256_unpacklo_epi8(cR, zero));
+        const __m256i high = sobelMagnitudeAvx2(
+                    _mm256_unpackhi_epi8(aL, zero), _mm256_unpackhi_epi8(aM, zero), _mm256_unpackhi_epi8(aR, zero),
+                    _mm256_unpackhi_epi8(bL, zero), _mm256_unpackhi_epi8(bR, zero),
+                    _mm256_unpackhi_epi8(cL, zero), _mm256_unpackhi_epi8(cM, zero), _mm256_unpackhi_epi8(cR, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_or_si256(_mm256_packus_epi16(low, high), alpha));
+    }
+    sobelRowScalar(above, row, below, width, x, width, out);
+}
+
+// The float kernels gain nothing from AVX-512 that memory bandwidth would not
+// take back, so the AVX-512 tables use these too.
+
+SIMD_TARGET("avx2")
+void convolveFloatAvx2(const float* const* rows, const float* weights, int taps, int count, float* out){
+    int i = 0;
+    for(; i + 16 <= count; i += 16){
+        __m256 low = _mm256_setzero_ps(), high = _mm256_setzero_ps();
+        for(int k = 0; k < taps; ++k){
+            const __m256 w = _mm256_set1_ps(weights[k]);
+            low = _mm256_add_ps(low, _mm256_mul_ps(w, _mm256_loadu_ps(rows[k] + i)));
+            high = _mm256_add_ps(high, _mm256_mul_ps(w, _mm256_loadu_ps(rows[k] + i + 8)));
+        }
+        _mm256_storeu_ps(out + i, low);
+        _mm256_storeu_ps(out + i + 8, high);
+    }
+    convolveFloatScalar(rows, weights, taps, i, count, out);
+}
+
+SIMD_TARGET("avx2")
+void colorMatrixFloatAvx2(const float* const* in, float* const* out, int count, const float* matrix){
+    __m256 m[4][5];
+    for(int c = 0; c < 4; ++c){
+        for(int j = 0; j < 5; ++j){
+            m[c][j] = _mm256_set1_ps(matrix[5 * c + j]);
+        }
+    }
+    int i = 0;
+    for(; i + 8 <= count; i += 8){
+        const __m256 r = _mm256_loadu_ps(in[0] + i), g = _mm256_loadu_ps(in[1] + i);
+        const __m256 b = _mm256_loadu_ps(in[2] + i), a = _mm256_loadu_ps(in[3] + i);
+        __m256 results[4];
+        for(int c = 0; c < 4; ++c){
+            __m256 value = _mm256_add_ps(_mm256_mul_ps(m[c][0], r), _mm256_mul_ps(m[c][1], g));
+            value = _mm256_add_ps(value, _mm256_mul_ps(m[c][2], b));
+            value = _mm256_add_ps(value, _mm256_mul_ps(m[c][3], a));
+            results[c] = _mm256_add_ps(value, m[c][4]);
+        }
+        for(int c = 0; c < 4; ++c){
+            _mm256_storeu_ps(out[c] + i, results[c]);
+        }
+    }
+    colorMatrixFloatScalar(in, out, i, count, matrix);
+}
+
+// 8x8 micro-tiles: 32-bit and 64-bit unpacks transpose the 4x4 quarters within
+// the lanes, and the lane permutes put the quarters in place.
+SIMD_TARGET("avx2")
+void transpose32Avx2(const quint32* src, qptrdiff srcStride, quint32* dst, qptrdiff dstStride, int width, int height){
+    const int fullWidth = width & ~7;
+    int y = 0;
+    for(; y + 8 <= height; y += 8){
+        for(int x = 0; x < fullWidth; x += 8){
+            const quint32* in = src + x * srcStride + y;
+            __m256i r[8];
+            for(int i = 0; i < 8; ++i){
+                r[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * srcStride));
+            }
+            const __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]), t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+            const __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]), t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+            const __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]), t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+            const __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]), t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+            const __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+            const __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+            const __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+            const __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+            const __m256i columns[8] = {
+                _mm256_permute2x128_si256(u0, u4, 0x20), _mm256_permute2x128_si256(u1, u5, 0x20),
+                _mm256_permute2x128_si256(u2, u6, 0x20), _mm256_permute2x128_si256(u3, u7, 0x20),
+                _mm256_permute2x128_si256(u0, u4, 0x31), _mm256_permute2x128_si256(u1, u5, 0x31),
+                _mm256_permute2x128_si256(u2, u6, 0x31), _mm256_permute2x128_si256(u3, u7, 0x31)
+            };
+            quint32* out = dst + y * dstStride + x;
+            for(int i = 0; i < 8; ++i){
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * dstStride), columns[i]);
+            }
+        }
+        for(int row = y; row < y + 8; ++row){
+            for(int x = fullWidth; x < width; ++x){
+                dst[row * dstStride + x] = src[x * srcStride + row];
+            }
+        }
+    }
+    transpose32Sse2(src + y, srcStride, dst + y * dstStride, dstStride, width, height - y);
+}
+
+SIMD_TARGET("avx2")
+void reverse32Avx2(const quint32* in, quint32* out, int count){
+    const __m256i reversed = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    if(in == out){
+        int i = 0, j = count - 8;
+        for(; i + 8 <= j; i += 8, j -= 8){
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + i));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + j));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permutevar8x32_epi32(b, reversed));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + j), _mm256_permutevar8x32_epi32(a, reversed));
+        }
+        reverse32Scalar(in, out, i, j + 8, count);
+        return;
+    }
+    int i = 0;
+    for(; i + 8 <= count; i += 8){
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + count - 8 - i), _mm256_permutevar8x32_epi32(v, reversed));
+    }
+    reverse32Scalar(in, out, i, count, count);
+}
+
+SIMD_TARGET("avx2")
+inline __m256i divide255Avx2(__m256i x){
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+SIMD_TARGET("avx2")
+inline __m256i mixAvx2(__m256i dst, __m256i src, __m256i alpha){
+    const __m256i keep = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+    return divide255Avx2(_mm256_add_epi16(_mm256_mullo_epi16(dst, keep), _mm256_mullo_epi16(src, alpha)));
+}
+
+// Unpacking works within 128-bit lanes: the low halves hold pixels 0, 1, 4 and 5,
+// which is also where unpacking the spread alphas puts theirs.
+SIMD_TARGET("avx2")
+void blendCoverageAvx2(QRgb* pixels, const uchar* coverage, int count, QRgb color){
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32(int(0xff000000u));
+    const __m256i src = _mm256_unpacklo_epi8(_mm256_set1_epi32(int(color | 0xff000000u)), zero);
+    const __m256i colorAlpha = _mm256_set1_epi32(qAlpha(color));
+    int i = 0;
+    for(; i + 8 <= count; i += 8){
+        qint64 covered;
+        memcpy(&covered, coverage + i, sizeof(covered));
+        if(!covered){
+            continue;
+        }
+        __m256i* p = reinterpret_cast<__m256i*>(pixels + i);
+        const __m256i dst = _mm256_loadu_si256(p);
+        if(_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(dst, opaque), opaque)) != -1){
+            blendCoverageScalar(pixels, coverage, i, i + 8, color);
+            continue;
+        }
+        const __m256i cover = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(coverage + i)));
+        const __m256i alpha = divide255Avx2(_mm256_mullo_epi16(cover, colorAlpha));
+        const __m256i alphas = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 16));
+        const __m256i low = mixAvx2(_mm256_unpacklo_epi8(dst, zero), src, _mm256_unpacklo_epi32(alphas, alphas));
+        const __m256i high = mixAvx2(_mm256_unpackhi_epi8(dst, zero), src, _mm256_unpackhi_epi32(alphas, alphas));
+        _mm256_storeu_si256(p, _mm256_packus_epi16(low, high));
+    }
+    blendCoverageSse2(pixels + i, coverage + i, count - i, color);
+}
+
+// Nearest neighbour is a gather; lanes outside the image are clamped to the edge or
+// masked off and stay 0.
+SIMD_TARGET("avx2")
+void remapNearestAvx2(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out){
+    const __m256i half = _mm256_set1_epi32(kRemapOne / 2);
+    const __m256i before = _mm256_set1_epi32(-1);
+    const __m256i width = _mm256_set1_epi32(src.width);
+    const __m256i height = _mm256_set1_epi32(src.height);
+    const __m256i stride = _mm256_set1_epi32(int(src.stride));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lastX = _mm256_set1_epi32(src.width - 1);
+    const __m256i lastY = _mm256_set1_epi32(src.height - 1);
+    int i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256i x = _mm256_srai_epi32(_mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs + i)), half),
+                                      SimdKernels::RemapFractionBits);
+        __m256i y = _mm256_srai_epi32(_mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ys + i)), half),
+                                      SimdKernels::RemapFractionBits);
+        if(src.clampEdges){
+            x = _mm256_min_epi32(_mm256_max_epi32(x, zero), lastX);
+            y = _mm256_min_epi32(_mm256_max_epi32(y, zero), lastY);
+        }
+        const __m256i inside = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(x, before), _mm256_cmpgt_epi32(width, x)),
+                                                _mm256_and_si256(_mm256_cmpgt_epi32(y, before), _mm256_cmpgt_epi32(height, y)));
+        const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(y, stride), x);
+        const __m256i pixels = _mm256_mask_i32gather_epi32(zero, reinterpret_cast<const int*>(src.bits),
+                                                           index, inside, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), pixels);
+    }
+    remapNearestScalar(src, xs, ys, i, count, out);
+}
+
+SIMD_TARGET("avx2")
+inline __m256i interleavePixelsAvx2(const QRgb* a, const QRgb* b){
+    const __m256i pair = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a))),
+                                                 _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b)), 1);
+    const __m256i words = _mm256_unpacklo_epi8(pair, _mm256_setzero_si256());
+    return _mm256_unpacklo_epi16(words, _mm256_srli_si256(words, 8));
+}
+
+SIMD_TARGET("avx2")
+inline __m256i laneWeightsAvx2(int a, int b){
+    return _mm256_setr_epi32(a, a, a, a, b, b, b, b);
+}
+
+SIMD_TARGET("avx2")
+inline void storeLanePixelsAvx2(__m256i words, QRgb* out){
+    const __m256i bytes = _mm256_packus_epi16(words, words);
+    out[0] = QRgb(_mm_cvtsi128_si32(_mm256_castsi256_si128(bytes)));
+    out[1] = QRgb(_mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1)));
+}
+
+// Two output pixels per step, one in each lane; a pair with a pixel near the border
+// goes through the one-pixel SSE2 code instead.
+SIMD_TARGET("avx2")
+void remapBilinearAvx2(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out){
+    const __m256i half = _mm256_set1_epi32(1 << (kBilinearShift - 1));
+    int i = 0;
+    for(; i + 2 <= count; i += 2){
+        const int xa = xs[i] >> SimdKernels::RemapFractionBits, ya = ys[i] >> SimdKernels::RemapFractionBits;
+        const int xb = xs[i + 1] >> SimdKernels::RemapFractionBits, yb = ys[i + 1] >> SimdKernels::RemapFractionBits;
+        if(!remapInside(src, xa, ya, 0, 1) || !remapInside(src, xb, yb, 0, 1)){
+            out[i] = bilinearPixelSse2(src, xs[i], ys[i]);
+            out[i + 1] = bilinearPixelSse2(src, xs[i + 1], ys[i + 1]);
+            continue;
+        }
+        const int fxa = xs[i] & kRemapMask, fya = ys[i] & kRemapMask;
+        const int fxb = xs[i + 1] & kRemapMask, fyb = ys[i + 1] & kRemapMask;
+        const QRgb* a = src.bits + ya * src.stride + xa;
+        const QRgb* b = src.bits + yb * src.stride + xb;
+        const __m256i wx = laneWeightsAvx2((fxa << 16) | (kRemapOne - fxa), (fxb << 16) | (kRemapOne - fxb));
+        const __m256i top = _mm256_madd_epi16(interleavePixelsAvx2(a, b), wx);
+        const __m256i bottom = _mm256_madd_epi16(interleavePixelsAvx2(a + src.stride, b + src.stride), wx);
+        const __m256i rows = _mm256_packs_epi32(top, bottom);
+        __m256i v = _mm256_madd_epi16(_mm256_unpacklo_epi16(rows, _mm256_srli_si256(rows, 8)),
+                                      laneWeightsAvx2((fya << 16) | (kRemapOne - fya), (fyb << 16) | (kRemapOne - fyb)));
+        v = _mm256_srai_epi32(_mm256_add_epi32(v, half), kBilinearShift);
+        storeLanePixelsAvx2(_mm256_packs_epi32(v, v), out + i);
+    }
+    remapBilinearSse2(src, xs + i, ys + i, count - i, out + i);
+}
+
+SIMD_TARGET("avx2")
+inline __m256i bicubicRowAvx2(const QRgb* a, const QRgb* b, __m256i w01, __m256i w23){
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a))),
+                                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(b)), 1);
+    const __m256i low = _mm256_unpacklo_epi8(pixels, zero);
+    const __m256i high = _mm256_unpackhi_epi8(pixels, zero);
+    const __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(low, _mm256_srli_si256(low, 8)), w01),
+                                         _mm256_madd_epi16(_mm256_unpacklo_epi16(high, _mm256_srli_si256(high, 8)), w23));
+    return _mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(1 << (kCubicRowShift - 1))), kCubicRowShift);
+}
+
+SIMD_TARGET("avx2")
+inline __m256i bicubicRowPairAvx2(__m256i first, __m256i second){
+    const __m256i rows = _mm256_min_epi16(_mm256_max_epi16(_mm256_packs_epi32(first, second), _mm256_setzero_si256()),
+                                          _mm256_set1_epi16(255 << SimdKernels::RowFractionBits));
+    return _mm256_unpacklo_epi16(rows, _mm256_srli_si256(rows, 8));
+}
+
+SIMD_TARGET("avx2")
+void remapBicubicAvx2(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out){
+    const CubicWeights& cubic = cubicWeights();
+    const __m256i half = _mm256_set1_epi32(1 << (kCubicColumnShift - 1));
+    int i = 0;
+    for(; i + 2 <= count; i += 2){
+        const int xa = xs[i] >> SimdKernels::RemapFractionBits, ya = ys[i] >> SimdKernels::RemapFractionBits;
+        const int xb = xs[i + 1] >> SimdKernels::RemapFractionBits, yb = ys[i + 1] >> SimdKernels::RemapFractionBits;
+        if(!remapInside(src, xa, ya, 1, 2) || !remapInside(src, xb, yb, 1, 2)){
+            out[i] = bicubicPixelSse2(src, xs[i], ys[i], cubic);
+            out[i + 1] = bicubicPixelSse2(src, xs[i + 1], ys[i + 1], cubic);
+            continue;
+        }
+        const qint16* wxa = cubic.taps[xs[i] & kRemapMask];
+        const qint16* wya = cubic.taps[ys[i] & kRemapMask];
+        const qint16* wxb = cubic.taps[xs[i + 1] & kRemapMask];
+        const qint16* wyb = cubic.taps[ys[i + 1] & kRemapMask];
+        const __m256i wx01 = laneWeightsAvx2(coefficientPair(wxa[0], wxa[1]), coefficientPair(wxb[0], wxb[1]));
+        const __m256i wx23 = laneWeightsAvx2(coefficientPair(wxa[2], wxa[3]), coefficientPair(wxb[2], wxb[3]));
+        const QRgb* a = src.bits + (ya - 1) * src.stride + xa - 1;
+        const QRgb* b = src.bits + (yb - 1) * src.stride + xb - 1;
+        const __m256i h0 = bicubicRowAvx2(a, b, wx01, wx23);
+        const __m256i h1 = bicubicRowAvx2(a + src.stride, b + src.stride, wx01, wx23);
+        const __m256i h2 = bicubicRowAvx2(a + 2 * src.stride, b + 2 * src.stride, wx01, wx23);
+        const __m256i h3 = bicubicRowAvx2(a + 3 * src.stride, b + 3 * src.stride, wx01, wx23);
+        __m256i v = _mm256_add_epi32(
+                    _mm256_madd_epi16(bicubicRowPairAvx2(h0, h1), laneWeightsAvx2(coefficientPair(wya[0], wya[1]), coefficientPair(wyb[0], wyb[1]))),
+                    _mm256_madd_epi16(bicubicRowPairAvx2(h2, h3), laneWeightsAvx2(coefficientPair(wya[2], wya[3]), coefficientPair(wyb[2], wyb[3]))));
+        v = _mm256_srai_epi32(_mm256_add_epi32(v, half), kCubicColumnShift);
+        v = _mm256_min_epi16(_mm256_max_epi16(_mm256_packs_epi32(v, v), _mm256_setzero_si256()), _mm256_set1_epi16(255));
+        storeLanePixelsAvx2(_mm256_min_epi16(v, _mm256_shufflelo_epi16(v, 0xff)), out + i);
+    }
+    remapBicubicSse2(src, xs + i, ys + i, count - i, out + i);
+}
+
+// AVX-512: 16 pixels per step, four 128-bit lanes of 4 pixels each. The lookup
+// uses the two-table byte permute of AVX-512 VBMI where the CPU has it.
+
+SIMD_TARGET("avx512f,avx512bw,avx512vbmi")
+void lookupAvx512(const QRgb* in, QRgb* out, int count, const uchar* table){
+    const __m512i table0 = _mm512_loadu_si512(table);
+    const __m512i table1 = _mm512_loadu_si512(table + 64);
+    const __m512i table2 = _mm512_loadu_si512(table + 128);
+    const __m512i table3 = _mm512_loadu_si512(table + 192);
+    const __mmask64 alphaBytes = 0x8888888888888888ull;
+
+    int i = 0;
+    for(; i + 16 <= count; i += 16){
+        const __m512i p = _mm512_loadu_si512(in + i);
+        // Each permute covers 128 entries with the low 7 bits; bit 7 picks the half.
+        const __m512i lower = _mm512_permutex2var_epi8(table0, p, table1);
+        const __m512i upper = _mm512_permutex2var_epi8(table2, p, table3);
+        const __m512i result = _mm512_mask_blend_epi8(_mm512_movepi8_mask(p), lower, upper);
+        _mm512_storeu_si512(out + i, _mm512_mask_blend_epi8(alphaBytes, result, p));
+    }
+    lookupScalar(in, out, i, count, table);
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+void colorMatrixAvx512(const QRgb* in, QRgb* out, int count, const SimdKernels::FixedColorMatrix& matrix){
+    __m512i blueRed[4], greenAlpha[4], offsets[4];
+    for(int c = 0; c < 4; ++c){
+        blueRed[c] = _mm512_set1_epi32(coefficientPair(matrix.coefficients[c][0], matrix.coefficients[c][2]));
+        greenAlpha[c] = _mm512_set1_epi32(coefficientPair(matrix.coefficients[c][1], matrix.coefficients[c][3]));
+        offsets[c] = _mm512_set1_epi32(matrix.offsets[c]);
+    }
+    const __m512i evenBytes = _mm512_set1_epi32(0x00ff00ff);
+
+    int i = 0;
+    for(; i + 16 <= count; i += 16){
+        const __m512i p = _mm512_loadu_si512(in + i);
+        const __m512i br = _mm512_and_si512(p, evenBytes);
+        const __m512i ga = _mm512_and_si512(_mm512_srli_epi32(p, 8), evenBytes);
+        __m512i channels[4];
+        for(int c = 0; c < 4; ++c){
+            const __m512i sum = _mm512_add_epi32(_mm512_madd_epi16(br, blueRed[c]), _mm512_madd_epi16(ga, greenAlpha[c]));
+            channels[c] = _mm512_srai_epi32(_mm512_add_epi32(sum, offsets[c]), SimdKernels::ColorMatrixShift);
+        }
+        const __m512i planar = _mm512_packus_epi16(_mm512_packs_epi32(channels[0], channels[1]),
+                                                   _mm512_packs_epi32(channels[2], channels[3]));
+        const __m512i blueGreen = _mm512_unpacklo_epi8(planar, _mm512_bsrli_epi128(planar, 4));
+        const __m512i redAlpha = _mm512_unpacklo_epi8(_mm512_bsrli_epi128(planar, 8), _mm512_bsrli_epi128(planar, 12));
+        _mm512_storeu_si512(out + i, _mm512_unpacklo_epi16(blueGreen, redAlpha));
+    }
+    colorMatrixScalar(in, out, i, count, matrix);
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+void convolveRowAvx512(const QRgb* padded, int width, const int* weights, int taps, quint16* out){
+    const WeightPairs pairs(weights, taps);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i half = _mm512_set1_epi32(1 << (kRowShift - 1));
+    // Interleave the lanes of the packed results back into pixel order.
+    const __m512i firstHalf = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+    const __m512i secondHalf = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+    int x = 0;
+    for(; x + 16 <= width; x += 16){
+        // Lane j of acc<n> collects output pixel x + 4j + n.
+        __m512i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+        for(int k = 0; k < taps; k += 2){
+            const __m512i w = _mm512_set1_epi32(pairs[k / 2]);
+            const __m512i a = _mm512_loadu_si512(padded + x + k);
+            const __m512i b = (k + 1 < taps) ? _mm512_loadu_si512(padded + x + k + 1) : a;
+            const __m512i aLow = _mm512_unpacklo_epi8(a, zero), aHigh = _mm512_unpackhi_epi8(a, zero);
+            const __m512i bLow = _mm512_unpacklo_epi8(b, zero), bHigh = _mm512_unpackhi_epi8(b, zero);
+            acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(_mm512_unpacklo_epi16(aLow, bLow), w));
+            acc1 = _mm512_add_epi32(acc1, _mm512_madd_epi16(_mm512_unpackhi_epi16(aLow, bLow), w));
+            acc2 = _mm512_add_epi32(acc2, _mm512_madd_epi16(_mm512_unpacklo_epi16(aHigh, bHigh), w));
+            acc3 = _mm512_add_epi32(acc3, _mm512_madd_epi16(_mm512_unpackhi_epi16(aHigh, bHigh), w));
+        }
+        acc0 = _mm512_srai_epi32(_mm512_add_epi32(acc0, half), kRowShift);
+        acc1 = _mm512_srai_epi32(_mm512_add_epi32(acc1, half), kRowShift);
+        acc2 = _mm512_srai_epi32(_mm512_add_epi32(acc2, half), kRowShift);
+        acc3 = _mm512_srai_epi32(_mm512_add_epi32(acc3, half), kRowShift);
+        const __m512i pixels01 = _mm512_packs_epi32(acc0, acc1);
+        const __m512i pixels23 = _mm512_packs_epi32(acc2, acc3);
+        _mm512_storeu_si512(out + 4 * x, _mm512_permutex2var_epi64(pixels01, firstHalf, pixels23));
+        _mm512_storeu_si512(out + 4 * x + 32, _mm512_permutex2var_epi64(pixels01, secondHalf, pixels23));
+    }
+    convolveRowScalar(padded, x, width, weights, taps, out);
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+void convolveColumnAvx512(const quint16* const* rows, const int* weights, int taps, int count, uchar* out){
+    const WeightPairs pairs(weights, taps);
+    const __m512i half = _mm512_set1_epi32(1 << (kColumnShift - 1));
+    const __m512i evenQuads = _mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0);
+    int i = 0;
+    for(; i + 32 <= count; i += 32){
+        __m512i low = half, high = half;
+        for(int k = 0; k < taps; k += 2){
+            const __m512i w = _mm512_set1_epi32(pairs[k / 2]);
+            const __m512i a = _mm512_loadu_si512(rows[k] + i);
+            const __m512i b = (k + 1 < taps) ? _mm512_loadu_si512(rows[k + 1] + i) : a;
+            low = _mm512_add_epi32(low, _mm512_madd_epi16(_mm512_unpacklo_epi16(a, b), w));
+            high = _mm512_add_epi32(high, _mm512_madd_epi16(_mm512_unpackhi_epi16(a, b), w));
+        }
+        const __m512i words = _mm512_packs_epi32(_mm512_srai_epi32(low, kColumnShift), _mm512_srai_epi32(high, kColumnShift));
+        const __m512i bytes = _mm512_permutexvar_epi64(evenQuads, _mm512_packus_epi16(words, words));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm512_castsi512_si256(bytes));
+    }
+    convolveColumnScalar(rows, weights, taps, i, count, out);
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+inline __m512i sobelMagnitudeAvx512(__m512i aL, __m512i aM, __m512i aR, __m512i bL, __m512i bR,
+                                    __m512i cL, __m512i cM, __m512i cR){
+    __m512i gx = _mm512_add_epi16(_mm512_sub_epi16(aR, aL), _mm512_sub_epi16(cR, cL));
+    gx = _mm512_add_epi16(gx, _mm512_slli_epi16(_mm512_sub_epi16(bR, bL), 1));
+    __m512i gy = _mm512_add_epi16(_mm512_sub_epi16(cL, aL), _mm512_sub_epi16(cR, aR));
+    gy = _mm512_add_epi16(gy, _mm512_slli_epi16(_mm512_sub_epi16(cM, aM), 1));
+
+    const __m512i first = _mm512_unpacklo_epi16(gx, gy);
+    const __m512i second = _mm512_unpackhi_epi16(gx, gy);
+    const __m512 squared0 = _mm512_cvtepi32_ps(_mm512_madd_epi16(first, first));
+    const __m512 squared1 = _mm512_cvtepi32_ps(_mm512_madd_epi16(second, second));
+    return _mm512_packs_epi32(_mm512_cvttps_epi32(_mm512_sqrt_ps(squared0)), _mm512_cvttps_epi32(_mm512_sqrt_ps(squared1)));
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+void sobelRowAvx512(const QRgb* above, const QRgb* row, const QRgb* below, int width, QRgb* out){
+    sobelRowScalar(above, row, below, width, 0, qMin(1, width), out);
+
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i alpha = _mm512_set1_epi32(int(0xff000000u));
+    int x = 1;
+    for(; x + 16 < width; x += 16){
+        const __m512i aL = _mm512_loadu_si512(above + x - 1);
+        const __m512i aM = _mm512_loadu_si512(above + x);
+        const __m512i aR = _mm512_loadu_si512(above + x + 1);
+        const __m512i bL = _mm512_loadu_si512(row + x - 1);
+        const __m512i bR = _mm512_loadu_si512(row + x + 1);
+        const __m512i cL = _mm512_loadu_si512(below + x - 1);
+        const __m512i cM = _mm512_loadu_si512(below + x);
+        const __m512i cR = _mm512_loadu_si512(below + x + 1);
+
+        const __m512i low = sobelMagnitudeAvx512(
+                    _mm512_unpacklo_epi8(aL, zero), _mm512_unpacklo_epi8(aM, zero), _mm512_unpacklo_epi8(aR, zero),
+                    _mm512_unpacklo_epi8(bL, zero), _mm512_unpacklo_epi8(bR, zero),
+                    _mm512_unpacklo_epi8(cL, zero), _mm512_unpacklo_epi8(cM, zero), _mm512_unpacklo_epi8(cR, zero));
+        const __m512i high = sobelMagnitudeAvx512(
+                    _mm512_unpackhi_epi8(aL, zero), _mm512_unpackhi_epi8(aM, zero), _mm512_unpackhi_epi8(aR, zero),
+                    _mm512_unpackhi_epi8(bL, zero), _mm512_unpackhi_epi8(bR, zero),
+                    _mm512_unpackhi_epi8(cL, zero), _mm512_unpackhi_epi8(cM, zero), _mm512_unpackhi_epi8(cR, zero));
+        _mm512_storeu_si512(out + x, _mm512_or_si512(_mm512_packus_epi16(low, high), alpha));
+    }
+    sobelRowScalar(above, row, below, width, x, width, out);
+}
+
+#endif // SIMD_X86_AVX
+#endif // SIMD_X86
+
+struct KernelTable{
+    void (*lookup)(const QRgb*, QRgb*, int, const uchar*);
+    void (*colorMatrix)(const QRgb*, QRgb*, int, const SimdKernels::FixedColorMatrix&);
+    void (*convolveRow)(const QRgb*, int, const int*, int, quint16*);
+    void (*convolveColumn)(const quint16* const*, const int*, int, int, uchar*);
+    void (*sobelRow)(const QRgb*, const QRgb*, const QRgb*, int, QRgb*);
+    void (*convolveFloat)(const float* const*, const float*, int, int, float*);
+    void (*colorMatrixFloat)(const float* const*, float* const*, int, const float*);
+    void (*unpackRgba64)(const quint16*, int, float* const*);
+    void (*packRgba64)(const float* const*, int, quint16*);
+    void (*transpose32)(const quint32*, qptrdiff, quint32*, qptrdiff, int, int);
+    void (*reverse32)(const quint32*, quint32*, int);
+    void (*resampleRow)(const QRgb*, const int*, const qint16*, int, int, quint16*);
+    void (*remapNearest)(const SimdKernels::RemapSource&, const qint32*, const qint32*, int, QRgb*);
+    void (*remapBilinear)(const SimdKernels::RemapSource&, const qint32*, const qint32*, int, QRgb*);
+    void (*remapBicubic)(const SimdKernels::RemapSource&, const qint32*, const qint32*, int, QRgb*);
+    void (*blendCoverage)(QRgb*, const uchar*, int, QRgb);
+};
+
+const KernelTable kScalarKernels = {
+    lookupPlain, colorMatrixPlain, convolveRowPlain, convolveColumnPlain, sobelRowPlain,
+    convolveFloatPlain, colorMatrixFloatPlain, unpackRgba64Plain, packRgba64Plain,
+    transpose32Plain, reverse32Plain, resampleRowPlain,
+    remapNearestPlain, remapBilinearPlain, remapBicubicPlain, blendCoveragePlain
+};
+
+#ifdef SIMD_X86
+// SSE2 has no byte shuffle or gather, so the lookup and the nearest neighbour remap
+// stay scalar there.
+const KernelTable kSse2Kernels = {
+    lookupPlain, colorMatrixSse2, convolveRowSse2, convolveColumnSse2, sobelRowSse2,
+    convolveFloatSse2, colorMatrixFloatSse2, unpackRgba64Sse2, packRgba64Sse2,
+    transpose32Sse2, reverse32Sse2, resampleRowSse2,
+    remapNearestPlain, remapBilinearSse2, remapBicubicSse2, blendCoverageSse2
+};
+#ifdef SIMD_X86_AVX
+const KernelTable kAvx2Kernels = {
+    lookupAvx2, colorMatrixAvx2, convolveRowAvx2, convolveColumnAvx2, sobelRowAvx2,
+    convolveFloatAvx2, colorMatrixFloatAvx2, unpackRgba64Sse2, packRgba64Sse2,
+    transpose32Avx2, reverse32Avx2, resampleRowAvx2,
+    remapNearestAvx2, remapBilinearAvx2, remapBicubicAvx2, blendCoverageAvx2
+};
+const KernelTable kAvx512Kernels = {
+    lookupAvx2, colorMatrixAvx512, convolveRowAvx512, convolveColumnAvx512, sobelRowAvx512,
+    convolveFloatAvx2, colorMatrixFloatAvx2, unpackRgba64Sse2, packRgba64Sse2,
+    transpose32Avx2, reverse32Avx2, resampleRowAvx2,
+    remapNearestAvx2, remapBilinearAvx2, remapBicubicAvx2, blendCoverageAvx2
+};
+const KernelTable kAvx512VbmiKernels = {
+    lookupAvx512, colorMatrixAvx512, convolveRowAvx512, convolveColumnAvx512, sobelRowAvx512,
+    convolveFloatAvx2, colorMatrixFloatAvx2, unpackRgba64Sse2, packRgba64Sse2,
+    transpose32Avx2, reverse32Avx2, resampleRowAvx2,
+    remapNearestAvx2, remapBilinearAvx2, remapBicubicAvx2, blendCoverageAvx2
+};
+#endif
+#endif
+
+InstructionSet detectInstructionSet(bool* vbmi){
+    *vbmi = false;
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+#ifdef SIMD_X86_AVX
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")){
+        *vbmi = __builtin_cpu_supports("avx512vbmi");
+        return InstructionSet::AVX512;
+    }
+    if(__builtin_cpu_supports("avx2")){
+        return InstructionSet::AVX2;
+    }
+#endif
+    if(__builtin_cpu_supports("sse2")){
+        return InstructionSet::SSE2;
+    }
+#endif
+    return InstructionSet::Scalar;
+}
+
+InstructionSet requestedInstructionSet(InstructionSet detected){
+    const QByteArray requested = qgetenv("IMAGE_EDITOR_SIMD").toLower();
+    for(InstructionSet set : { InstructionSet::Scalar, InstructionSet::SSE2, InstructionSet::AVX2, InstructionSet::AVX512 }){
+        if(requested == SimdKernels::name(set)){
+            return qMin(set, detected);
+        }
+    }
+    return detected;
+}
+
+struct Dispatch{
+    InstructionSet detected;
+    bool vbmi;
+    std::atomic<int> active;
+
+    Dispatch()
+        : vbmi(false)
+    {
+        detected = detectInstructionSet(&vbmi);
+        active.store(int(requestedInstructionSet(detected)));
+    }
+};
+
+Dispatch& dispatch(){
+    static Dispatch instance;
+    return instance;
+}
+
+const KernelTable& kernels(){
+    const Dispatch& d = dispatch();
+    switch(InstructionSet(d.active.load(std::memory_order_relaxed))){
+#ifdef SIMD_X86
+#ifdef SIMD_X86_AVX
+    case InstructionSet::AVX512:
+        return d.vbmi ? kAvx512VbmiKernels : kAvx512Kernels;
+    case InstructionSet::AVX2:
+        return kAvx2Kernels;
+#endif
+    case InstructionSet::SSE2:
+        return kSse2Kernels;
+#endif
+    default:
+        return kScalarKernels;
+    }
+}
+
+}
+
+SimdKernels::InstructionSet SimdKernels::detected()
+{
+    return dispatch().detected;
+}
+
+SimdKernels::InstructionSet SimdKernels::active()
+{
+    return InstructionSet(dispatch().active.load(std::memory_order_relaxed));
+}
+
+void SimdKernels::setActive(InstructionSet set)
+{
+    Dispatch& d = dispatch();
+    d.active.store(int(qMin(set, d.detected)), std::memory_order_relaxed);
+}
+
+const char* SimdKernels::name(InstructionSet set)
+{
+    switch(set){
+    case InstructionSet::SSE2:
+        return "sse2";
+    case InstructionSet::AVX2:
+        return "avx2";
+    case InstructionSet::AVX512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+void SimdKernels::lookup(const QRgb* in, QRgb* out, int count, const uchar* table)
+{
+    kernels().lookup(in, out, count, table);
+}
+
+void SimdKernels::colorMatrix(const QRgb* in, QRgb* out, int count, const FixedColorMatrix& matrix)
+{
+    kernels().colorMatrix(in, out, count, matrix);
+}
+
+void SimdKernels::convolveRow(const QRgb* padded, int width, const int* weights, int taps, quint16* out)
+{
+    kernels().convolveRow(padded, width, weights, taps, out);
+}
+
+void SimdKernels::convolveColumn(const quint16* const* rows, const int* weights, int taps, int count, uchar* out)
+{
+    kernels().convolveColumn(rows, weights, taps, count, out);
+}
+
+void SimdKernels::sobelRow(const QRgb* above, const QRgb* row, const QRgb* below, int width, QRgb* out)
+{
+    kernels().sobelRow(above, row, below, width, out);
+}
+
+void SimdKernels::convolveFloat(const float* const* rows, const float* weights, int taps, int count, float* out)
+{
+    kernels().convolveFloat(rows, weights, taps, count, out);
+}
+
+void SimdKernels::colorMatrixFloat(const float* const* in, float* const* out, int count, const float* matrix)
+{
+    kernels().colorMatrixFloat(in, out, count, matrix);
+}
+
+void SimdKernels::unpackRgba64(const quint16* in, int count, float* const* planes)
+{
+    kernels().unpackRgba64(in, count, planes);
+}
+
+void SimdKernels::packRgba64(const float* const* planes, int count, quint16* out)
+{
+    kernels().packRgba64(planes, count, out);
+}
+
+void SimdKernels::transpose32(const quint32* src, qptrdiff srcStride, quint32* dst, qptrdiff dstStride, int width, int height)
+{
+    kernels().transpose32(src, srcStride, dst, dstStride, width, height);
+}
+
+void SimdKernels::reverse32(const quint32* in, quint32* out, int count)
+{
+    kernels().reverse32(in, out, count);
+}
+
+void SimdKernels::resampleRow(const QRgb* in, const int* starts, const qint16* weights, int taps, int count, quint16* out)
+{
+    kernels().resampleRow(in, starts, weights, taps, count, out);
+}
+
+void SimdKernels::remapNearest(const RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out)
+{
+    kernels().remapNearest(src, xs, ys, count, out);
+}
+
+void SimdKernels::remapBilinear(const RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out)
+{
+    kernels().remapBilinear(src, xs, ys, count, out);
+}
+
+void SimdKernels::remapBicubic(const RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out)
+{
+    kernels().remapBicubic(src, xs, ys, count, out);
+}
+
+void SimdKernels::blendCoverage(QRgb* pixels, const uchar* coverage, int count, QRgb color)
+{
+    kernels().blendCoverage(pixels, coverage, count, color);
+}
@@ -0,0 +1,115 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <QRgb>
+
+// Inner loops of the pixel filters with SSE2, AVX2 and AVX-512 versions. The
+// widest instruction set the CPU supports is detected on first use; every
+// path produces exactly the same output as the scalar one.
+//
+// The IMAGE_EDITOR_SIMD environment variable (scalar, sse2, avx2 or avx512)
+// caps the instruction set, e.g. to reproduce regression images on another machine.
+class SimdKernels
+{
+public:
+    enum class InstructionSet{
+        Scalar,
+        SSE2,
+        AVX2,
+        AVX512
+    };
+
+    // Fixed-point scale of convolution weights: the taps of a kernel sum to 1 << WeightShift.
+    static const int WeightShift = 14;
+    // Fraction bits of the intermediate values written by convolveRow().
+    static const int RowFractionBits = 7;
+    // Fraction bits of FixedColorMatrix.
+    static const int ColorMatrixShift = 12;
+    // Fraction bits of the source coordinates read by the remap kernels.
+    static const int RemapFractionBits = 7;
+
+    // Color matrix in 4.12 fixed point with rows and columns in QRgb byte order
+    // (blue, green, red, alpha). The offsets are in the same fixed-point units.
+    struct FixedColorMatrix{
+        qint16 coefficients[4][4];
+        qint32 offsets[4];
+    };
+
+    // Premultiplied ARGB32 pixels sampled by the remap kernels; stride is in pixels.
+    // With clampEdges, positions outside the image read the nearest edge pixel
+    // instead of transparent black.
+    struct RemapSource{
+        const QRgb* bits;
+        qptrdiff stride;
+        int width;
+        int height;
+        bool clampEdges;
+    };
+
+public:
+    static InstructionSet detected();
+    static InstructionSet active();
+    // Selects a narrower path than detected(), e.g. to compare against the scalar
+    // results. Must not be called while filters are running.
+    static void setActive(InstructionSet set);
+    static const char* name(InstructionSet set);
+
+    // Maps the three color channels of count pixels through a 256-entry table; alpha is kept.
+    static void lookup(const QRgb* in, QRgb* out, int count, const uchar* table);
+    // Applies a color matrix to count pixels; each result is rounded down and clamped to 0..255.
+    static void colorMatrix(const QRgb* in, QRgb* out, int count, const FixedColorMatrix& matrix);
+
+    // Horizontal pass: out gets 4 * width values in QRgb byte order, channel c of
+    // pixel x being sum(weights[k] * channel c of padded[x + k]) in 8.7 fixed point.
+    // padded holds width + taps - 1 pixels.
+    static void convolveRow(const QRgb* padded, int width, const int* weights, int taps, quint16* out);
+    // Vertical pass: out[i] = sum(weights[k] * rows[k][i]) rounded and clamped back to
+    // 8 bits, for count values of taps rows produced by convolveRow().
+    static void convolveColumn(const quint16* const* rows, const int* weights, int taps, int count, uchar* out);
+    // Horizontal resampling pass: like convolveRow(), but output pixel x reads the
+    // taps pixels from in + starts[x] with its own weights, weights[x * taps + k].
+    // Weights may be negative; results are clamped to 0..255 (in 8.7 fixed point).
+    static void resampleRow(const QRgb* in, const int* starts, const qint16* weights, int taps, int count, quint16* out);
+
+    // Sobel gradient magnitude per channel of one row, edges clamped; alpha is opaque.
+    static void sobelRow(const QRgb* above, const QRgb* row, const QRgb* below, int width, QRgb* out);
+
+    // Float kernels of the high bit depth path. No path uses fused multiply-add, so
+    // they round identically too.
+
+    // out[i] = sum(weights[k] * rows[k][i]). A horizontal pass passes one padded row
+    // at increasing offsets.
+    static void convolveFloat(const float* const* rows, const float* weights, int taps, int count, float* out);
+    // Applies a row-major 4x5 matrix (red, green, blue, alpha, offset) to four planes
+    // of count pixels; in and out may be the same planes.
+    static void colorMatrixFloat(const float* const* in, float* const* out, int count, const float* matrix);
+    // Converts interleaved RGBA64 pixels to red, green, blue and alpha planes in 0..1,
+    // and back with clamping and rounding.
+    static void unpackRgba64(const quint16* in, int count, float* const* planes);
+    static void packRgba64(const float* const* planes, int count, quint16* out);
+
+    // Transposes a block of 32-bit pixels: dst[y * dstStride + x] = src[x * srcStride + y]
+    // for width x height destination pixels. Strides are in pixels and may be negative
+    // to walk rows bottom-up, which turns the transpose into a 90 degree rotation.
+    static void transpose32(const quint32* src, qptrdiff srcStride, quint32* dst, qptrdiff dstStride, int width, int height);
+    // out[i] = in[count - 1 - i]. in and out are either the same row, reversed in
+    // place, or do not overlap.
+    static void reverse32(const quint32* in, quint32* out, int count);
+
+    // Inverse mapping for rotations and warps: out[i] samples src at (xs[i], ys[i]),
+    // coordinates in fixed point with RemapFractionBits and pixel centers on whole
+    // numbers. Unless src clamps its edges, pixels outside it are transparent, so the
+    // edges of the result are antialiased by the filter like any other edge.
+    static void remapNearest(const RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out);
+    static void remapBilinear(const RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out);
+    // Keys' cubic (a = -0.5) over 4x4 pixels; ringing is clamped so that the color
+    // channels stay below alpha.
+    static void remapBicubic(const RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out);
+
+    // Source-over of color onto count ARGB32 pixels, neither premultiplied, pixel i
+    // being covered by coverage[i] / 255 of it. Opaque pixels are mixed with rounding;
+    // translucent ones get the exact source-over color and alpha.
+    static void blendCoverage(QRgb* pixels, const uchar* coverage, int count, QRgb color);
+};
+
+#endif // SIMDKERNELS_H
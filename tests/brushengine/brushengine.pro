@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_brushengine
+
+SOURCES += \
+    tst_brushengine.cpp \
+    ../../brushengine.cpp \
+    ../../simdkernels.cpp \
+    ../../tiledimage.cpp \
+    ../../tilescheduler.cpp
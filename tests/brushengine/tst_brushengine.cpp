@@ -0,0 +1,46 @@
+#include <QtTest>
+#include <QPainter>
+
+#include "brushengine.h"
+
+class TestBrushEngine : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void patternsMatchQBrush();
+};
+
+// A dab much larger than the pattern paints exactly the pixels a QBrush of the
+// same style fills.
+void TestBrushEngine::patternsMatchQBrush()
+{
+    for(int style = Qt::Dense1Pattern; style <= Qt::DiagCrossPattern; ++style){
+        QImage expected(8, 8, QImage::Format_ARGB32);
+        expected.fill(Qt::white);
+        {
+            QPainter painter(&expected);
+            painter.fillRect(expected.rect(), QBrush(Qt::black, Qt::BrushStyle(style)));
+        }
+
+        QImage blank(8, 8, QImage::Format_ARGB32);
+        blank.fill(Qt::white);
+        TiledImage image(blank);
+        BrushEngine::Brush brush;
+        brush.diameter = 40;
+        brush.pattern = Qt::BrushStyle(style);
+        BrushEngine engine;
+        engine.beginStroke(image, brush, QPointF(4, 4));
+        const QImage painted = image.toImage();
+
+        for(int y = 0; y < 8; ++y){
+            for(int x = 0; x < 8; ++x){
+                QCOMPARE(painted.pixel(x, y), expected.pixel(x, y));
+            }
+        }
+    }
+}
+
+QTEST_MAIN(TestBrushEngine)
+
+#include "tst_brushengine.moc"
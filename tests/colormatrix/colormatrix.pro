@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+TARGET = tst_colormatrix
+
+SOURCES += \
+    tst_colormatrix.cpp \
+    ../../colormatrix.cpp \
+    ../../filterapplyer.cpp \
+    ../../floatimage.cpp \
+    ../../integralimage.cpp \
+    ../../simdkernels.cpp \
+    ../../tilescheduler.cpp \
+    ../../warpengine.cpp
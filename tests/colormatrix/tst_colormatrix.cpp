@@ -0,0 +1,81 @@
+#include <QtTest>
+
+#include "colormatrix.h"
+#include "filterapplyer.h"
+
+namespace {
+
+// Every 8-bit value in each channel, opaque.
+QImage ramp()
+{
+    QImage image(256, 1, QImage::Format_ARGB32);
+    for(int x = 0; x < 256; ++x){
+        image.setPixel(x, 0, qRgba(x, 255 - x, (x * 7) & 0xff, 255));
+    }
+    return image;
+}
+
+int contrasted(int value, double factor)
+{
+    return qBound(0, qFloor((value - 128) * factor + 128), 255);
+}
+
+}
+
+class TestColorMatrix : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void largeGain();
+    void rangeBounds();
+    void fusionMatchesSteps();
+};
+
+void TestColorMatrix::largeGain()
+{
+    const QImage src = ramp();
+    for(double factor : { 2.0, 10.0, 40.0 }){
+        const QImage dst = FilterApplyer::applyColorMatrix(src, ColorMatrix::contrast(factor));
+        for(int x = 0; x < src.width(); ++x){
+            const QRgb in = src.pixel(x, 0);
+            const QRgb out = dst.pixel(x, 0);
+            QCOMPARE(qRed(out), contrasted(qRed(in), factor));
+            QCOMPARE(qGreen(out), contrasted(qGreen(in), factor));
+            QCOMPARE(qBlue(out), contrasted(qBlue(in), factor));
+            QCOMPARE(qAlpha(out), 255);
+        }
+    }
+}
+
+void TestColorMatrix::rangeBounds()
+{
+    QVERIFY(ColorMatrix().staysInRange());
+    QVERIFY(ColorMatrix::invert().staysInRange());
+    QVERIFY(ColorMatrix::grayscale().staysInRange());
+    QVERIFY(ColorMatrix::contrast(0.5).staysInRange());
+    QVERIFY(!ColorMatrix::contrast(3).staysInRange());
+    QVERIFY(!ColorMatrix::sepia().staysInRange());
+}
+
+void TestColorMatrix::fusionMatchesSteps()
+{
+    const QImage src = ramp();
+    // Each chain saturates after its first step; fusing across it would undo the clamp.
+    const QVector<QVector<ColorMatrix>> chains = {
+        { ColorMatrix::contrast(3), ColorMatrix::contrast(0.5) },
+        { ColorMatrix::contrast(2), ColorMatrix::invert(), ColorMatrix::contrast(0.25) },
+        { ColorMatrix::sepia(), ColorMatrix::contrast(0.5) }
+    };
+    for(const QVector<ColorMatrix>& chain : chains){
+        QImage stepwise = src;
+        for(const ColorMatrix& matrix : chain){
+            stepwise = FilterApplyer::applyColorMatrix(stepwise, matrix);
+        }
+        QCOMPARE(FilterApplyer::applyColorMatrices(src, chain), stepwise);
+    }
+}
+
+QTEST_MAIN(TestColorMatrix)
+
+#include "tst_colormatrix.moc"
@@ -0,0 +1,26 @@
+include(../tests.pri)
+
+QT += widgets
+
+TARGET = tst_graphicscanvas
+
+SOURCES += \
+    tst_graphicscanvas.cpp \
+    ../../brushengine.cpp \
+    ../../filterjob.cpp \
+    ../../floatimage.cpp \
+    ../../floodfill.cpp \
+    ../../graphicscanvas.cpp \
+    ../../imagedisplayitem.cpp \
+    ../../imagemanipulator.cpp \
+    ../../jpegexif.cpp \
+    ../../orientation.cpp \
+    ../../resampler.cpp \
+    ../../simdkernels.cpp \
+    ../../tiledimage.cpp \
+    ../../tilescheduler.cpp \
+    ../../undohistory.cpp
+
+HEADERS += \
+    ../../filterjob.h \
+    ../../graphicscanvas.h
@@ -0,0 +1,61 @@
+#include <QtTest>
+
+#include "filterjob.h"
+#include "graphicscanvas.h"
+
+class TestGraphicsCanvas : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void imageKey();
+    void jobOnUnchangedImage();
+};
+
+void TestGraphicsCanvas::imageKey()
+{
+    GraphicsCanvas canvas;
+    const qint64 key = canvas.imageKey();
+    canvas.getImage();
+    QCOMPARE(canvas.imageKey(), key);
+
+    // A pending orientation changes the image as shown without touching the pixels.
+    canvas.orient(Orientation::rotateRight());
+    QVERIFY(canvas.imageKey() != key);
+    canvas.getImage();
+    const qint64 baked = canvas.imageKey();
+    QVERIFY(baked != key);
+    canvas.getImage();
+    QCOMPARE(canvas.imageKey(), baked);
+
+    QImage image(20, 10, QImage::Format_ARGB32);
+    image.fill(Qt::red);
+    canvas.setImage(image);
+    QVERIFY(canvas.imageKey() != baked);
+}
+
+// MainWindow applies a job's result only while the key it recorded when the job
+// started still matches, and starts the job again otherwise.
+void TestGraphicsCanvas::jobOnUnchangedImage()
+{
+    GraphicsCanvas canvas;
+    FilterJob job("Invert", [](const QImage& image) {
+        QImage inverted = image;
+        inverted.invertPixels();
+        return inverted;
+    });
+    QSignalSpy finished(&job, &FilterJob::finished);
+    job.start(canvas.getImage());
+    const qint64 key = canvas.imageKey();
+    QVERIFY(finished.wait(10000));
+
+    QCOMPARE(canvas.imageKey(), key);
+    const QImage result = finished.first().first().value<QImage>();
+    canvas.setImage(result);
+    QCOMPARE(canvas.getImage(), result);
+    QVERIFY(canvas.canUndo());
+}
+
+QTEST_MAIN(TestGraphicsCanvas)
+
+#include "tst_graphicscanvas.moc"
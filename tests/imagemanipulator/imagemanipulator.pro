@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+TARGET = tst_imagemanipulator
+
+SOURCES += \
+    tst_imagemanipulator.cpp \
+    ../../floatimage.cpp \
+    ../../imagemanipulator.cpp \
+    ../../orientation.cpp \
+    ../../simdkernels.cpp \
+    ../../tilescheduler.cpp
@@ -0,0 +1,53 @@
+#include <QtTest>
+
+#include "imagemanipulator.h"
+
+class TestImageManipulator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void rotatedFormats();
+    void rotateHighBitDepth();
+};
+
+void TestImageManipulator::rotatedFormats()
+{
+    const auto rotated = [](QImage::Format format){
+        QImage image(16, 12, format);
+        image.fill(Qt::red);
+        return ImageManipulator::rotate(image, 30).format();
+    };
+    QCOMPARE(rotated(QImage::Format_ARGB32), QImage::Format_ARGB32);
+    QCOMPARE(rotated(QImage::Format_RGB32), QImage::Format_ARGB32);
+    QCOMPARE(rotated(QImage::Format_Grayscale8), QImage::Format_ARGB32);
+    QCOMPARE(rotated(QImage::Format_RGBA64), QImage::Format_RGBA64);
+    QCOMPARE(rotated(QImage::Format_RGBX64), QImage::Format_RGBA64);
+}
+
+void TestImageManipulator::rotateHighBitDepth()
+{
+    // Levels that 8 bits cannot hold, so a detour through ARGB32 would change them.
+    const quint16 color[4] = { 1000, 20000, 40000, 65535 };
+    QImage image(16, 16, QImage::Format_RGBA64);
+    for(int y = 0; y < image.height(); ++y){
+        quint16* line = reinterpret_cast<quint16*>(image.scanLine(y));
+        for(int x = 0; x < image.width(); ++x){
+            std::copy(color, color + 4, line + 4 * x);
+        }
+    }
+
+    const QImage rotated = ImageManipulator::rotate(image, 30);
+    QCOMPARE(rotated.format(), QImage::Format_RGBA64);
+    const quint16* center = reinterpret_cast<const quint16*>(rotated.constScanLine(rotated.height() / 2))
+                          + 4 * (rotated.width() / 2);
+    for(int c = 0; c < 4; ++c){
+        QCOMPARE(center[c], color[c]);
+    }
+    const quint16* corner = reinterpret_cast<const quint16*>(rotated.constScanLine(0));
+    QCOMPARE(corner[3], quint16(0));
+}
+
+QTEST_MAIN(TestImageManipulator)
+
+#include "tst_imagemanipulator.moc"
@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+TARGET = tst_integralimage
+
+SOURCES += \
+    tst_integralimage.cpp \
+    ../../colormatrix.cpp \
+    ../../filterapplyer.cpp \
+    ../../floatimage.cpp \
+    ../../integralimage.cpp \
+    ../../simdkernels.cpp \
+    ../../tilescheduler.cpp \
+    ../../warpengine.cpp
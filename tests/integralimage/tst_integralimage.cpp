@@ -0,0 +1,50 @@
+#include <QtTest>
+
+#include "filterapplyer.h"
+#include "integralimage.h"
+
+class TestIntegralImage : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void nullSource();
+    void rectangleSums();
+};
+
+void TestIntegralImage::nullSource()
+{
+    const IntegralImage table{QImage()};
+    QVERIFY(table.isNull());
+    QCOMPARE(table.width(), 0);
+    QCOMPARE(table.height(), 0);
+    QVERIFY(FilterApplyer::applyPixelate(table, 8).isNull());
+    QVERIFY(FilterApplyer::applyBoxBlur(table, 3).isNull());
+    QVERIFY(IntegralImage().isNull());
+}
+
+void TestIntegralImage::rectangleSums()
+{
+    QImage image(37, 23, QImage::Format_ARGB32);
+    for(int y = 0; y < image.height(); ++y){
+        for(int x = 0; x < image.width(); ++x){
+            image.setPixel(x, y, qRgba(x, y, x + y, 255));
+        }
+    }
+    const IntegralImage table(image);
+    QVERIFY(!table.isNull());
+
+    const QRect rect(5, 3, 10, 7);
+    quint32 red = 0;
+    for(int y = rect.top(); y <= rect.bottom(); ++y){
+        for(int x = rect.left(); x <= rect.right(); ++x){
+            red += quint32(qRed(image.pixel(x, y)));
+        }
+    }
+    QCOMPARE(table.sum(rect, IntegralImage::Channel::Red), red);
+    QCOMPARE(table.sum(QRect(0, 0, 1, 1), IntegralImage::Channel::Alpha), quint32(255));
+}
+
+QTEST_MAIN(TestIntegralImage)
+
+#include "tst_integralimage.moc"
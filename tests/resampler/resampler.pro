@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_resampler
+
+SOURCES += \
+    tst_resampler.cpp \
+    ../../floatimage.cpp \
+    ../../resampler.cpp \
+    ../../simdkernels.cpp \
+    ../../tilescheduler.cpp
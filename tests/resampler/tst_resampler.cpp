@@ -0,0 +1,51 @@
+#include <QtTest>
+
+#include "resampler.h"
+
+namespace {
+
+// Opaque white, a one pixel opaque black line and then transparent pixels: the
+// color and alpha edges are a pixel apart, so the ringing of one does not match
+// the other.
+QImage alphaEdge()
+{
+    QImage image(40, 24, QImage::Format_ARGB32_Premultiplied);
+    for(int y = 0; y < image.height(); ++y){
+        for(int x = 0; x < image.width(); ++x){
+            image.setPixel(x, y, (x < 17) ? 0xffffffffu : ((x == 17) ? 0xff000000u : 0x00000000u));
+        }
+    }
+    return image;
+}
+
+}
+
+class TestResampler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void colorBelowAlpha();
+};
+
+void TestResampler::colorBelowAlpha()
+{
+    const QSize sizes[] = { QSize(15, 9), QSize(97, 61) };
+    for(const QSize& size : sizes){
+        const QImage image = Resampler::resize(alphaEdge(), size, Resampler::Filter::Lanczos3);
+        QCOMPARE(image.format(), QImage::Format_ARGB32_Premultiplied);
+        for(int y = 0; y < image.height(); ++y){
+            const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+            for(int x = 0; x < image.width(); ++x){
+                const QRgb pixel = line[x];
+                QVERIFY(qRed(pixel) <= qAlpha(pixel));
+                QVERIFY(qGreen(pixel) <= qAlpha(pixel));
+                QVERIFY(qBlue(pixel) <= qAlpha(pixel));
+            }
+        }
+    }
+}
+
+QTEST_MAIN(TestResampler)
+
+#include "tst_resampler.moc"
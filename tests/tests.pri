@@ -0,0 +1,7 @@
+QT       += core gui concurrent testlib
+
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/..
+DEPENDPATH += $$PWD/..
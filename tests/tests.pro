@@ -0,0 +1,10 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    brushengine \
+    colormatrix \
+    graphicscanvas \
+    imagemanipulator \
+    integralimage \
+    resampler \
+    undohistory
@@ -0,0 +1,150 @@
+#include <QtTest>
+#include <QDir>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QThreadPool>
+
+#include "undohistory.h"
+
+namespace {
+
+const int kSide = 256;
+const qint64 kStateBytes = qint64(kSide) * kSide * 4;
+
+// Noise compresses poorly, so every packed state spills about its full size.
+QImage noise(quint32 seed)
+{
+    QImage image(kSide, kSide, QImage::Format_ARGB32);
+    quint32 state = seed * 2654435761u + 1;
+    for(int y = 0; y < image.height(); ++y){
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for(int x = 0; x < image.width(); ++x){
+            state = state * 1664525u + 1013904223u;
+            line[x] = state | 0xff000000u;
+        }
+    }
+    return image;
+}
+
+qint64 spilledBytes(const QString& directory, int* files = nullptr)
+{
+    const QFileInfoList entries = QDir(directory).entryInfoList(QDir::Files);
+    if(files){
+        *files = entries.size();
+    }
+    qint64 bytes = 0;
+    for(const QFileInfo& entry : entries){
+        bytes += entry.size();
+    }
+    return bytes;
+}
+
+}
+
+class TestUndoHistory : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void spillAcrossClears();
+    void spillAcrossUndos();
+    void unreadableSpill();
+};
+
+void TestUndoHistory::spillAcrossClears()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    UndoHistory history;
+    history.setSpillDirectory(directory.path());
+    history.setRecentStates(1);
+    // Room for the current image and the recent state, so packed states spill
+    // but none is dropped.
+    history.setMemoryLimit(3 * kStateBytes);
+
+    const int depth = 4;
+    for(int cycle = 0; cycle < 20; ++cycle){
+        TiledImage current(noise(0));
+        for(int step = 1; step <= depth; ++step){
+            const TiledImage previous = current;
+            current = TiledImage(noise(step));
+            history.push(UndoHistory::State{previous, Orientation()}, current);
+            // Lets the packed tiles finish compressing, so the next push spills them.
+            QThreadPool::globalInstance()->waitForDone();
+            QVERIFY(spilledBytes(directory.path()) <= depth * kStateBytes);
+        }
+        history.clear();
+    }
+    int files = 0;
+    spilledBytes(directory.path(), &files);
+    QCOMPARE(files, 1);
+}
+
+void TestUndoHistory::spillAcrossUndos()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    UndoHistory history;
+    history.setSpillDirectory(directory.path());
+    history.setRecentStates(1);
+    history.setMemoryLimit(3 * kStateBytes);
+
+    const int depth = 4;
+    for(int cycle = 0; cycle < 20; ++cycle){
+        TiledImage current(noise(0));
+        for(int step = 1; step <= depth; ++step){
+            const TiledImage previous = current;
+            current = TiledImage(noise(step));
+            history.push(UndoHistory::State{previous, Orientation()}, current);
+            QThreadPool::globalInstance()->waitForDone();
+        }
+        for(int step = depth - 1; step >= 0; --step){
+            QVERIFY(history.canUndo());
+            current = history.undo(UndoHistory::State{current, Orientation()}).image;
+            QCOMPARE(current.toImage(), noise(step));
+        }
+        QVERIFY(spilledBytes(directory.path()) <= depth * kStateBytes);
+    }
+}
+
+// A state whose spilled tiles are gone is not restored, and stays in the history.
+void TestUndoHistory::unreadableSpill()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    UndoHistory history;
+    history.setSpillDirectory(directory.path());
+    history.setRecentStates(1);
+    history.setMemoryLimit(3 * kStateBytes);
+
+    TiledImage current(noise(0));
+    for(int step = 1; step <= 4; ++step){
+        const TiledImage previous = current;
+        current = TiledImage(noise(step));
+        history.push(UndoHistory::State{previous, Orientation()}, current);
+        QThreadPool::globalInstance()->waitForDone();
+    }
+    const QFileInfoList files = QDir(directory.path()).entryInfoList(QDir::Files);
+    QCOMPARE(files.size(), 1);
+    QVERIFY(QFile::resize(files.first().filePath(), 0));
+
+    bool failed = false;
+    while(history.canUndo() && !failed){
+        bool ok = false;
+        const UndoHistory::State state = history.undo(UndoHistory::State{current, Orientation()}, &ok);
+        if(ok){
+            current = state.image;
+            continue;
+        }
+        failed = true;
+        QCOMPARE(state.image.cacheKey(), current.cacheKey());
+        QVERIFY(history.canUndo());
+        history.undo(UndoHistory::State{current, Orientation()}, &ok);
+        QVERIFY(!ok);
+    }
+    QVERIFY(failed);
+}
+
+QTEST_MAIN(TestUndoHistory)
+
+#include "tst_undohistory.moc"
@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+TARGET = tst_undohistory
+
+SOURCES += \
+    tst_undohistory.cpp \
+    ../../orientation.cpp \
+    ../../tiledimage.cpp \
+    ../../undohistory.cpp
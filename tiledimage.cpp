@@ -0,0 +1,169 @@
+#include "tiledimage.h"
+
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+// Keys of edited images; negative, so they never equal a QImage::cacheKey().
+qint64 nextEditKey()
+{
+    static std::atomic<qint64> serial{0};
+    return -(++serial);
+}
+
+}
+
+TiledImage::TiledImage()
+    : m_columns(0), m_rows(0), m_key(0)
+{
+}
+
+TiledImage::TiledImage(const QImage& image)
+    : TiledImage()
+{
+    if(image.isNull()){
+        return;
+    }
+    const QImage source = (image.depth() < 8) ? image.convertToFormat(QImage::Format_ARGB32) : image;
+    m_size = source.size();
+    m_columns = (m_size.width() + TileSize - 1) / TileSize;
+    m_rows = (m_size.height() + TileSize - 1) / TileSize;
+    m_tiles.reserve(m_columns * m_rows);
+    for(int index = 0; index < m_columns * m_rows; ++index){
+        m_tiles.append(source.copy(tileRect(index)));
+    }
+    m_key = image.cacheKey();
+}
+
+TiledImage::TiledImage(const QSize& size, const QVector<QImage>& tiles, qint64 cacheKey)
+    : m_size(size),
+      m_columns((size.width() + TileSize - 1) / TileSize),
+      m_rows((size.height() + TileSize - 1) / TileSize),
+      m_tiles(tiles),
+      m_key(cacheKey)
+{
+    Q_ASSERT(m_tiles.size() == m_columns * m_rows);
+}
+
+bool TiledImage::isNull() const
+{
+    return m_tiles.isEmpty();
+}
+
+int TiledImage::width() const
+{
+    return m_size.width();
+}
+
+int TiledImage::height() const
+{
+    return m_size.height();
+}
+
+QSize TiledImage::size() const
+{
+    return m_size;
+}
+
+QRect TiledImage::rect() const
+{
+    return QRect(QPoint(0, 0), m_size);
+}
+
+QImage::Format TiledImage::format() const
+{
+    return isNull() ? QImage::Format_Invalid : m_tiles.first().format();
+}
+
+qint64 TiledImage::cacheKey() const
+{
+    return m_key;
+}
+
+QImage TiledImage::toImage() const
+{
+    return copy(rect());
+}
+
+QImage TiledImage::copy(const QRect& rect) const
+{
+    const QRect area = rect.intersected(this->rect());
+    if(area.isEmpty()){
+        return QImage();
+    }
+    QImage result(area.size(), format());
+    result.setColorTable(m_tiles.first().colorTable());
+    const int bytesPerPixel = m_tiles.first().depth() / 8;
+    for(int row = area.top() / TileSize; row <= area.bottom() / TileSize; ++row){
+        for(int column = area.left() / TileSize; column <= area.right() / TileSize; ++column){
+            const int index = row * m_columns + column;
+            const QRect tileArea = tileRect(index);
+            const QRect part = tileArea.intersected(area);
+            const QImage& tile = m_tiles.at(index);
+            for(int y = part.top(); y <= part.bottom(); ++y){
+                const uchar* in = tile.constScanLine(y - tileArea.top()) + (part.left() - tileArea.left()) * bytesPerPixel;
+                uchar* out = result.scanLine(y - area.top()) + (part.left() - area.left()) * bytesPerPixel;
+                std::memcpy(out, in, part.width() * bytesPerPixel);
+            }
+        }
+    }
+    return result;
+}
+
+QRgb TiledImage::pixel(const QPoint& position) const
+{
+    const int index = tileIndex(position);
+    return m_tiles.at(index).pixel(position.x() % TileSize, position.y() % TileSize);
+}
+
+void TiledImage::setPixel(const QPoint& position, uint color)
+{
+    const int index = tileIndex(position);
+    m_tiles[index].setPixel(position.x() % TileSize, position.y() % TileSize, color);
+    m_key = nextEditKey();
+}
+
+void TiledImage::paint(const QRect& area, const std::function<void(QPainter&)>& draw)
+{
+    const QRect clipped = area.intersected(rect());
+    if(clipped.isEmpty()){
+        return;
+    }
+    for(int row = clipped.top() / TileSize; row <= clipped.bottom() / TileSize; ++row){
+        for(int column = clipped.left() / TileSize; column <= clipped.right() / TileSize; ++column){
+            const int index = row * m_columns + column;
+            QPainter painter(&m_tiles[index]);
+            painter.translate(-tileRect(index).topLeft());
+            draw(painter);
+        }
+    }
+    m_key = nextEditKey();
+}
+
+int TiledImage::tileCount() const
+{
+    return m_tiles.size();
+}
+
+QRect TiledImage::tileRect(int index) const
+{
+    const QPoint origin((index % m_columns) * TileSize, (index / m_columns) * TileSize);
+    return QRect(origin, QSize(TileSize, TileSize)).intersected(rect());
+}
+
+const QImage& TiledImage::tile(int index) const
+{
+    return m_tiles.at(index);
+}
+
+QImage& TiledImage::editTile(int index)
+{
+    m_key = nextEditKey();
+    return m_tiles[index];
+}
+
+int TiledImage::tileIndex(const QPoint& position) const
+{
+    return (position.y() / TileSize) * m_columns + position.x() / TileSize;
+}
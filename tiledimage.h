@@ -0,0 +1,63 @@
+#ifndef TILEDIMAGE_H
+#define TILEDIMAGE_H
+
+#include <QImage>
+#include <QPainter>
+#include <QRect>
+#include <QVector>
+#include <functional>
+
+// Image stored as TileSize x TileSize tiles (smaller at the right and bottom
+// edges), so that edits and the display only touch the tiles an edit reaches.
+// The tiles are implicitly shared QImages: a copy of a TiledImage costs one
+// reference per tile, and editing it afterwards detaches only the tiles edited.
+class TiledImage
+{
+public:
+    static const int TileSize = 256;
+
+public:
+    TiledImage();
+    // Formats below 8 bits per pixel are converted to Format_ARGB32.
+    explicit TiledImage(const QImage& image);
+    // Reassembles an image of size from tiles as returned by tile(), row by row.
+    TiledImage(const QSize& size, const QVector<QImage>& tiles, qint64 cacheKey);
+
+    bool isNull() const;
+    int width() const;
+    int height() const;
+    QSize size() const;
+    QRect rect() const;
+    QImage::Format format() const;
+    // Like QImage::cacheKey(): it changes whenever the pixels change, and an image
+    // built from a QImage keeps that image's key until it is edited.
+    qint64 cacheKey() const;
+
+    // Joins the tiles into one image.
+    QImage toImage() const;
+    // Like QImage::copy(), reading only the tiles rect covers.
+    QImage copy(const QRect& rect) const;
+
+    QRgb pixel(const QPoint& position) const;
+    void setPixel(const QPoint& position, uint color);
+    // Runs draw once for every tile that intersects area, with a painter on the
+    // tile translated to image coordinates. draw must not paint outside area.
+    void paint(const QRect& area, const std::function<void(QPainter&)>& draw);
+
+    // Tiles are numbered row by row.
+    int tileCount() const;
+    QRect tileRect(int index) const;
+    const QImage& tile(int index) const;
+    // For edits that write the pixels of a tile directly; it changes cacheKey().
+    QImage& editTile(int index);
+    int tileIndex(const QPoint& position) const;
+
+private:
+    QSize m_size;
+    int m_columns;
+    int m_rows;
+    QVector<QImage> m_tiles;
+    qint64 m_key;
+};
+
+#endif // TILEDIMAGE_H
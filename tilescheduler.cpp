@@ -0,0 +1,109 @@
+#include "tilescheduler.h"
+
+#include <QAtomicInt>
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+namespace {
+
+// Output bytes per band; small enough for a band and its input to stay in L2.
+const int kBandBytes = 128 * 1024;
+
+thread_local TileScheduler::Control* t_control = nullptr;
+
+int workerCount(){
+    return qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+}
+
+}
+
+void TileScheduler::forEachBand(const QSize& size, int bytesPerLine, int halo, const Kernel& kernel, int rowAlignment)
+{
+    run(split(size, QSize(size.width(), bandHeight(bytesPerLine, rowAlignment)), halo), kernel);
+}
+
+void TileScheduler::forEachStrip(const QSize& size, int halo, const Kernel& kernel)
+{
+    const int columns = qBound(16, size.width() / (4 * workerCount()), 256);
+    run(split(size, QSize(columns, size.height()), halo), kernel);
+}
+
+void TileScheduler::forEachTile(const QSize& size, const QSize& tileSize, int halo, const Kernel& kernel)
+{
+    run(split(size, tileSize, halo), kernel);
+}
+
+int TileScheduler::bandHeight(int bytesPerLine, int rowAlignment)
+{
+    const int rows = qMax(1, kBandBytes / qMax(1, bytesPerLine));
+    return qMax(rowAlignment, rows - rows % rowAlignment);
+}
+
+void TileScheduler::run(const QVector<Tile>& tiles, const Kernel& kernel)
+{
+    // Helper threads do not see the caller's control, so it is captured here.
+    Control* control = t_control;
+    if(tiles.isEmpty() || (control && control->cancelled.load(std::memory_order_relaxed))){
+        return;
+    }
+    if(control){
+        control->tilesDone.store(0, std::memory_order_relaxed);
+        control->tilesTotal.store(tiles.size(), std::memory_order_relaxed);
+        control->passes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    QAtomicInt next(0);
+    auto drain = [&](){
+        for(int i = next.fetchAndAddRelaxed(1); i < tiles.size(); i = next.fetchAndAddRelaxed(1)){
+            if(control && control->cancelled.load(std::memory_order_relaxed)){
+                break;
+            }
+            kernel(tiles[i]);
+            if(control){
+                control->tilesDone.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    QVector<QFuture<void>> helpers;
+    const int helperCount = qMin(workerCount(), tiles.size()) - 1;
+    for(int i = 0; i < helperCount; ++i){
+        helpers.append(QtConcurrent::run(drain));
+    }
+    drain();
+    for(QFuture<void>& helper : helpers){
+        helper.waitForFinished();
+    }
+}
+
+void TileScheduler::setControl(Control* control)
+{
+    t_control = control;
+}
+
+TileScheduler::Control* TileScheduler::control()
+{
+    return t_control;
+}
+
+QVector<TileScheduler::Tile> TileScheduler::split(const QSize& size, const QSize& tileSize, int halo)
+{
+    QVector<Tile> tiles;
+    if(size.isEmpty()){
+        return tiles;
+    }
+
+    const QRect bounds(QPoint(0, 0), size);
+    const int tileWidth = qMax(1, tileSize.width());
+    const int tileHeight = qMax(1, tileSize.height());
+    for(int y = 0; y < size.height(); y += tileHeight){
+        for(int x = 0; x < size.width(); x += tileWidth){
+            Tile tile;
+            tile.rect = QRect(x, y, qMin(tileWidth, size.width() - x), qMin(tileHeight, size.height() - y));
+            tile.source = tile.rect.adjusted(-halo, -halo, halo, halo).intersected(bounds);
+            tiles.append(tile);
+        }
+    }
+    return tiles;
+}
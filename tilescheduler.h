@@ -0,0 +1,59 @@
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <QRect>
+#include <QSize>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+// Splits an image into independent tiles and runs a kernel on them from the
+// global thread pool. The calling thread works through tiles too, so the call
+// blocks until every tile is done and is safe to use from a pool thread.
+//
+// Kernels read from shared, read-only sources and write only the pixels of
+// their own tile into a preallocated destination.
+class TileScheduler
+{
+public:
+    struct Tile{
+        QRect rect;     // Output pixels the kernel writes.
+        QRect source;   // rect grown by the kernel halo and clipped to the image.
+    };
+
+    typedef std::function<void(const Tile&)> Kernel;
+
+    // Progress and cancellation of the runs made by one thread, e.g. a FilterJob.
+    // Every run() is one pass: it resets the tile counts and updates them as tiles
+    // finish. Once cancelled, run() hands out no more tiles, so the output of the
+    // filter is incomplete and must be discarded.
+    struct Control{
+        std::atomic<bool> cancelled{false};
+        std::atomic<int> passes{0};
+        std::atomic<int> tilesDone{0};
+        std::atomic<int> tilesTotal{0};
+    };
+
+public:
+    // Full-width row bands sized so the output of one band stays in cache.
+    // Band heights are multiples of rowAlignment (for block-based filters).
+    static void forEachBand(const QSize& size, int bytesPerLine, int halo, const Kernel& kernel, int rowAlignment = 1);
+    // Full-height column strips, for passes that run down the columns.
+    static void forEachStrip(const QSize& size, int halo, const Kernel& kernel);
+    // Rectangular tiles of at most tileSize.
+    static void forEachTile(const QSize& size, const QSize& tileSize, int halo, const Kernel& kernel);
+
+    // Rows per band used by forEachBand().
+    static int bandHeight(int bytesPerLine, int rowAlignment = 1);
+
+    static void run(const QVector<Tile>& tiles, const Kernel& kernel);
+
+    // Installs control for the runs made by the calling thread, or removes it with nullptr.
+    static void setControl(Control* control);
+    static Control* control();
+
+private:
+    static QVector<Tile> split(const QSize& size, const QSize& tileSize, int halo);
+};
+
+#endif // TILESCHEDULER_H
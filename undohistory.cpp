@@ -0,0 +1,411 @@
+#include "undohistory.h"
+
+#include <QDir>
+#include <QFuture>
+#include <QMap>
+#include <QTemporaryFile>
+#include <QtConcurrent/QtConcurrentRun>
+#include <cstring>
+
+// The temporary file tiles are spilled to. Tiles release their range when the
+// last state referring to them goes, and later tiles are written to the first
+// free range they fit in; a free range at the end of the file is cut off.
+struct UndoHistory::SpillFile{
+    QTemporaryFile file;
+    // Free ranges, size by offset; adjacent ones are merged.
+    QMap<qint64, qint64> free;
+
+    explicit SpillFile(const QString& templateName)
+        : file(templateName)
+    {
+    }
+
+    qint64 allocate(qint64 size)
+    {
+        for(auto range = free.begin(); range != free.end(); ++range){
+            if(range.value() >= size){
+                const qint64 offset = range.key();
+                const qint64 rest = range.value() - size;
+                free.erase(range);
+                if(rest > 0){
+                    free.insert(offset + size, rest);
+                }
+                return offset;
+            }
+        }
+        return file.size();
+    }
+
+    void release(qint64 offset, qint64 size)
+    {
+        const auto next = free.find(offset + size);
+        if(next != free.end()){
+            size += next.value();
+            free.erase(next);
+        }
+        auto previous = free.lowerBound(offset);
+        if(previous != free.begin()){
+            --previous;
+            if(previous.key() + previous.value() == offset){
+                offset = previous.key();
+                size += previous.value();
+                free.erase(previous);
+            }
+        }
+        if(offset + size >= file.size()){
+            file.resize(offset);
+        }else{
+            free.insert(offset, size);
+        }
+    }
+};
+
+struct UndoHistory::PackedTile{
+    ~PackedTile()
+    {
+        if(file){
+            file->release(offset, dataSize);
+        }
+    }
+
+    // The tile until its compressed data is collected.
+    QImage image;
+    QFuture<QByteArray> pending;
+    QByteArray data;
+    // Where data went once spilled.
+    QSharedPointer<SpillFile> file;
+    qint64 offset = -1;
+    int dataSize = 0;
+    QSize size;
+    QImage::Format format = QImage::Format_Invalid;
+    QVector<QRgb> colorTable;
+};
+
+namespace {
+
+// zlib at its fastest level: tiles of brush strokes and fills are mostly runs
+// of equal pixels, which it packs at several hundred MB/s.
+const int CompressionLevel = 1;
+
+QByteArray compressTile(const QImage& tile)
+{
+    return qCompress(tile.constBits(), int(qint64(tile.bytesPerLine()) * tile.height()), CompressionLevel);
+}
+
+qint64 tileBytes(const QImage& tile)
+{
+    return qint64(tile.bytesPerLine()) * tile.height();
+}
+
+// Adds the bytes of the tiles of image not in seen yet, and adds them to seen.
+// Tiles are told apart by their pixel data, which copies of a tile share.
+qint64 addUnseenTiles(const TiledImage& image, QSet<const void*>& seen)
+{
+    qint64 bytes = 0;
+    for(int index = 0; index < image.tileCount(); ++index){
+        const QImage& tile = image.tile(index);
+        if(!seen.contains(tile.constBits())){
+            seen.insert(tile.constBits());
+            bytes += tileBytes(tile);
+        }
+    }
+    return bytes;
+}
+
+}
+
+UndoHistory::Entry::Entry(const State& state)
+    : state(state), packed(false), cacheKey(0)
+{
+}
+
+UndoHistory::Entry::Entry(const Command& command, const Orientation& orientation)
+    : state(State{TiledImage(), orientation}), packed(false), cacheKey(0), command(command)
+{
+}
+
+UndoHistory::UndoHistory()
+    : m_limit(qint64(1) << 30), m_recent(4), m_spillDirectory(QDir::tempPath())
+{
+}
+
+void UndoHistory::setMemoryLimit(qint64 bytes)
+{
+    m_limit = qMax<qint64>(0, bytes);
+}
+
+qint64 UndoHistory::memoryLimit() const
+{
+    return m_limit;
+}
+
+void UndoHistory::setRecentStates(int count)
+{
+    m_recent = qMax(1, count);
+}
+
+void UndoHistory::setSpillDirectory(const QString& path)
+{
+    if(path != m_spillDirectory){
+        m_spillDirectory = path;
+        m_spillFile.reset();
+    }
+}
+
+qint64 UndoHistory::memoryUsed(const TiledImage& current) const
+{
+    QSet<const void*> seen;
+    addUnseenTiles(current, seen);
+    qint64 bytes = 0;
+    for(const Entry& entry : m_redo){
+        bytes += entryBytes(entry, seen);
+    }
+    for(const Entry& entry : m_undo){
+        bytes += entryBytes(entry, seen);
+    }
+    return bytes;
+}
+
+qint64 UndoHistory::entryBytes(const Entry& entry, QSet<const void*>& seen)
+{
+    qint64 bytes = addUnseenTiles(entry.state.image, seen);
+    for(const PackedTilePointer& tile : entry.tiles){
+        // A tile still being compressed shares its pixels with the state it came from
+        const void* key = tile->image.isNull() ? static_cast<const void*>(tile.data()) : tile->image.constBits();
+        if(!seen.contains(key)){
+            seen.insert(key);
+            bytes += tile->image.isNull() ? tile->data.size() : tileBytes(tile->image);
+        }
+    }
+    return bytes;
+}
+
+void UndoHistory::push(const State& state, const TiledImage& current)
+{
+    collectFinished();
+    m_undo.append(Entry(state));
+    m_redo.clear();
+    packOlderStates();
+    enforceLimit(current);
+}
+
+void UndoHistory::push(const Command& command, const State& current)
+{
+    collectFinished();
+    m_undo.append(Entry(command, current.orientation));
+    m_redo.clear();
+    packOlderStates();
+    enforceLimit(current.image);
+}
+
+bool UndoHistory::canUndo() const
+{
+    return !m_undo.isEmpty();
+}
+
+bool UndoHistory::canRedo() const
+{
+    return !m_redo.isEmpty();
+}
+
+UndoHistory::State UndoHistory::undo(const State& current, bool* ok)
+{
+    collectFinished();
+    if(ok){
+        *ok = true;
+    }
+    if(m_undo.last().packed && !m_undo.last().command.undo){
+        State state;
+        if(!unpack(m_undo.last(), state)){
+            if(ok){
+                *ok = false;
+            }
+            return current;
+        }
+        m_undo.removeLast();
+        m_redo.append(Entry(current));
+        // The tiles unpacked are new allocations, which m_lastPacked must not
+        // mistake for the ones it was made from
+        m_lastPacked.clear();
+        return state;
+    }
+    const Entry entry = m_undo.takeLast();
+    if(entry.command.undo){
+        m_redo.append(Entry(entry.command, current.orientation));
+        return State{TiledImage(entry.command.undo(current.image.toImage())), entry.state.orientation};
+    }
+    m_redo.append(Entry(current));
+    return entry.state;
+}
+
+UndoHistory::State UndoHistory::redo(const State& current)
+{
+    const Entry entry = m_redo.takeLast();
+    if(entry.command.redo){
+        m_undo.append(Entry(entry.command, current.orientation));
+        return State{TiledImage(entry.command.redo(current.image.toImage())), entry.state.orientation};
+    }
+    m_undo.append(Entry(current));
+    return entry.state;
+}
+
+void UndoHistory::clear()
+{
+    m_undo.clear();
+    m_redo.clear();
+    m_lastPacked.clear();
+}
+
+void UndoHistory::packOlderStates()
+{
+    // States leave the recent ones in the order they were pushed, so the state
+    // packed before this one is the one it may share tiles with, unless a command
+    // came between them
+    for(int index = 0; index < m_undo.size() - m_recent; ++index){
+        const Entry& entry = m_undo.at(index);
+        if(entry.packed){
+            continue;
+        }
+        if(entry.command.undo){
+            m_undo[index].packed = true;
+            m_lastPacked.clear();
+        }else{
+            m_undo[index] = pack(entry.state);
+        }
+    }
+}
+
+UndoHistory::Entry UndoHistory::pack(const State& state)
+{
+    Entry entry(State{TiledImage(), state.orientation});
+    entry.packed = true;
+    entry.size = state.image.size();
+    entry.cacheKey = state.image.cacheKey();
+    QHash<const uchar*, PackedTilePointer> packed;
+    entry.tiles.reserve(state.image.tileCount());
+    for(int index = 0; index < state.image.tileCount(); ++index){
+        const QImage& image = state.image.tile(index);
+        PackedTilePointer tile = m_lastPacked.value(image.constBits());
+        if(!tile){
+            tile = PackedTilePointer::create();
+            tile->image = image;
+            tile->size = image.size();
+            tile->format = image.format();
+            tile->colorTable = image.colorTable();
+            tile->pending = QtConcurrent::run(compressTile, image);
+        }
+        packed.insert(image.constBits(), tile);
+        entry.tiles.append(tile);
+    }
+    m_lastPacked = packed;
+    return entry;
+}
+
+bool UndoHistory::unpack(const Entry& entry, State& state) const
+{
+    QVector<QImage> tiles;
+    tiles.reserve(entry.tiles.size());
+    for(const PackedTilePointer& tile : entry.tiles){
+        if(!tile->image.isNull()){
+            tiles.append(tile->image);
+            continue;
+        }
+        QByteArray data = tile->data;
+        if(tile->file){
+            if(!tile->file->file.seek(tile->offset)){
+                return false;
+            }
+            data = tile->file->file.read(tile->dataSize);
+            if(data.size() != tile->dataSize){
+                return false;
+            }
+        }
+        const QByteArray pixels = qUncompress(data);
+        QImage image(tile->size, tile->format);
+        if(image.isNull() || pixels.size() != tileBytes(image)){
+            return false;
+        }
+        image.setColorTable(tile->colorTable);
+        std::memcpy(image.bits(), pixels.constData(), pixels.size());
+        tiles.append(image);
+    }
+    state = State{TiledImage(entry.size, tiles, entry.cacheKey), entry.state.orientation};
+    return true;
+}
+
+void UndoHistory::collectFinished()
+{
+    for(Entry& entry : m_undo){
+        for(const PackedTilePointer& tile : entry.tiles){
+            if(!tile->image.isNull() && tile->pending.isFinished()){
+                tile->data = tile->pending.result();
+                tile->pending = QFuture<QByteArray>();
+                tile->image = QImage();
+            }
+        }
+    }
+}
+
+void UndoHistory::enforceLimit(const TiledImage& current)
+{
+    qint64 used = memoryUsed(current);
+    // Compressed tiles of the oldest states go to disk first
+    bool spilling = true;
+    for(int index = 0; spilling && index < m_undo.size() && used > m_limit; ++index){
+        for(const PackedTilePointer& tile : m_undo.at(index).tiles){
+            const int size = tile->data.size();
+            if(size > 0){
+                spilling = spill(*tile);
+                if(!spilling){
+                    break;
+                }
+                used -= size;
+            }
+        }
+    }
+    if(used <= m_limit){
+        return;
+    }
+    // Walks from the newest state back, so tiles an older state shares with a
+    // newer one are charged to the newer one. The cost of a state is only known
+    // once the next operation changed the tiles, so the limit is checked when the
+    // next state is pushed.
+    QSet<const void*> seen;
+    addUnseenTiles(current, seen);
+    qint64 bytes = 0;
+    for(const Entry& entry : m_redo){
+        bytes += entryBytes(entry, seen);
+    }
+    for(int index = m_undo.size() - 1; index >= 0; --index){
+        bytes += entryBytes(m_undo.at(index), seen);
+        if(bytes > m_limit && index < m_undo.size() - 1){
+            m_undo.erase(m_undo.begin(), m_undo.begin() + index + 1);
+            // The state m_lastPacked was made from may be gone
+            m_lastPacked.clear();
+            return;
+        }
+    }
+}
+
+bool UndoHistory::spill(PackedTile& tile)
+{
+    if(!m_spillFile){
+        QSharedPointer<SpillFile> file(new SpillFile(QDir(m_spillDirectory).filePath("undo-XXXXXX.tmp")));
+        if(!file->file.open()){
+            return false;
+        }
+        m_spillFile = file;
+    }
+    const qint64 offset = m_spillFile->allocate(tile.data.size());
+    // Flushed right away, so the tile is on disk once its memory is released
+    if(!m_spillFile->file.seek(offset) || m_spillFile->file.write(tile.data) != tile.data.size()
+            || !m_spillFile->file.flush()){
+        m_spillFile->release(offset, tile.data.size());
+        return false;
+    }
+    tile.file = m_spillFile;
+    tile.offset = offset;
+    tile.dataSize = tile.data.size();
+    tile.data = QByteArray();
+    return true;
+}
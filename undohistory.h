@@ -0,0 +1,116 @@
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+#include "orientation.h"
+#include "tiledimage.h"
+
+// Undo and redo states of a GraphicsCanvas. A state refers to the tiles of the
+// image it was taken from, so it costs memory only for the tiles an operation
+// changed afterwards; tiles shared by several states and the current image are
+// counted once.
+//
+// The most recent undo states stay as they are, so undoing them is instant.
+// Older ones are packed: their tiles are compressed on a pool thread and
+// decompressed when the state is undone. When the states take more than the
+// memory limit, compressed tiles are moved to a temporary file in the spill
+// directory, and only if that fails are the oldest undo states dropped. The
+// space of spilled tiles no state refers to any more is reused, so the file
+// stays about as large as the tiles still in it.
+//
+// Operations that can be undone exactly are recorded as commands instead,
+// which keep no pixels at all.
+class UndoHistory
+{
+public:
+    struct State{
+        TiledImage image;
+        Orientation orientation;
+    };
+
+    // Undo runs undo on the image the command produced and redo runs redo again
+    // on the image it was applied to, so undo(redo(image)) must equal image.
+    struct Command{
+        std::function<QImage(const QImage&)> undo;
+        std::function<QImage(const QImage&)> redo;
+    };
+
+public:
+    UndoHistory();
+
+    // Memory the states may take together, 1 GiB by default. The most recent undo
+    // state is always kept, even if it alone exceeds the limit.
+    void setMemoryLimit(qint64 bytes);
+    qint64 memoryLimit() const;
+    // Undo states kept unpacked, 4 by default.
+    void setRecentStates(int count);
+    // Where packed tiles are spilled, QDir::tempPath() by default. Tiles already
+    // spilled stay in their file.
+    void setSpillDirectory(const QString& path);
+    // Bytes of the tiles that only the states refer to, i.e. not shared with
+    // current, plus the compressed tiles kept in memory.
+    qint64 memoryUsed(const TiledImage& current) const;
+
+    // Records state, taken before an operation on current, and clears the redo states.
+    void push(const State& state, const TiledImage& current);
+    // Records command, about to be applied to current, and clears the redo states.
+    void push(const Command& command, const State& current);
+    bool canUndo() const;
+    bool canRedo() const;
+    // Returns the state to restore and keeps current for the opposite direction.
+    // If the state's spilled tiles cannot be read back, it stays in the history,
+    // *ok is set to false and current is returned.
+    State undo(const State& current, bool* ok = nullptr);
+    State redo(const State& current);
+    void clear();
+
+private:
+    struct PackedTile;
+    typedef QSharedPointer<PackedTile> PackedTilePointer;
+    struct SpillFile;
+
+    // A state, or once packed, its tiles (row by row, as TiledImage::tile()), or a
+    // command with the orientation the image had on its side of it. Commands are
+    // marked packed once they left the recent states.
+    struct Entry{
+        explicit Entry(const State& state = State());
+        Entry(const Command& command, const Orientation& orientation);
+
+        State state;
+        bool packed;
+        QVector<PackedTilePointer> tiles;
+        QSize size;
+        qint64 cacheKey;
+        Command command;
+    };
+
+    // Bytes of the tiles of entry not in seen yet, which are added to seen.
+    static qint64 entryBytes(const Entry& entry, QSet<const void*>& seen);
+    void packOlderStates();
+    Entry pack(const State& state);
+    // False if a spilled tile could not be read back whole.
+    bool unpack(const Entry& entry, State& state) const;
+    void collectFinished();
+    void enforceLimit(const TiledImage& current);
+    bool spill(PackedTile& tile);
+
+private:
+    QList<Entry> m_undo;
+    QList<Entry> m_redo;
+    qint64 m_limit;
+    int m_recent;
+    QString m_spillDirectory;
+    QSharedPointer<SpillFile> m_spillFile;
+    // Packed tiles of the newest packed state by the pixel data they were made
+    // from, so the tiles the next packed state shares with it are packed once.
+    QHash<const uchar*, PackedTilePointer> m_lastPacked;
+};
+
+#endif // UNDOHISTORY_H
@@ -0,0 +1,292 @@
+#include "warpengine.h"
+#include "simdkernels.h"
+#include "tilescheduler.h"
+
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtMath>
+#include <climits>
+
+namespace {
+
+const int kFixedOne = 1 << SimdKernels::RemapFractionBits;
+// Far enough outside any image, and still clear of overflow in the kernels.
+const qreal kCoordinateLimit = qreal(1 << 22);
+
+const int kDefaultCacheKiB = 512 * 1024;
+
+// Keeps every table alive while a caller holds it, even after it is evicted.
+struct TableCache{
+    QMutex mutex;
+    QCache<QByteArray, QSharedPointer<const RemapTable>> remapTables;
+    QCache<QByteArray, QSharedPointer<const RadialTable>> radialTables;
+
+    TableCache()
+        : remapTables(kDefaultCacheKiB / 2), radialTables(kDefaultCacheKiB / 2)
+    {
+    }
+};
+
+TableCache& cache(){
+    static TableCache instance;
+    return instance;
+}
+
+int costInKiB(qint64 bytes){
+    return int(qMin<qint64>((bytes + 1023) / 1024, INT_MAX));
+}
+
+// Cache key: a kind tag followed by the raw bytes of the parameters.
+class KeyBuilder
+{
+public:
+    explicit KeyBuilder(char kind){
+        m_key.append(kind);
+    }
+
+    KeyBuilder& add(qreal value){
+        m_key.append(reinterpret_cast<const char*>(&value), int(sizeof(value)));
+        return *this;
+    }
+
+    KeyBuilder& add(const QSize& size){
+        const int values[2] = { size.width(), size.height() };
+        m_key.append(reinterpret_cast<const char*>(values), int(sizeof(values)));
+        return *this;
+    }
+
+    QByteArray key() const{
+        return m_key;
+    }
+
+private:
+    QByteArray m_key;
+};
+
+// Looks table up in cache, or builds it with build() and caches it.
+template <typename Table, typename Build>
+QSharedPointer<const Table> cachedTable(QCache<QByteArray, QSharedPointer<const Table>>& tables, const QByteArray& key,
+                                        const Build& build){
+    {
+        QMutexLocker locker(&cache().mutex);
+        if(QSharedPointer<const Table>* cached = tables.object(key)){
+            return *cached;
+        }
+    }
+    // Two threads may build the same table at once; the second one simply replaces the first.
+    const QSharedPointer<const Table> table(build());
+    QMutexLocker locker(&cache().mutex);
+    tables.insert(key, new QSharedPointer<const Table>(table), costInKiB(table->bytes()));
+    return table;
+}
+
+void remapRow(const SimdKernels::RemapSource& src, const qint32* xs, const qint32* ys, int count, QRgb* out,
+              ImageManipulator::Interpolation interpolation){
+    switch(interpolation){
+    case ImageManipulator::Interpolation::Nearest:
+        SimdKernels::remapNearest(src, xs, ys, count, out);
+        break;
+    case ImageManipulator::Interpolation::Bicubic:
+        SimdKernels::remapBicubic(src, xs, ys, count, out);
+        break;
+    default:
+        SimdKernels::remapBilinear(src, xs, ys, count, out);
+        break;
+    }
+}
+
+}
+
+RemapTable::RemapTable(const QSize& size)
+    : m_size(size.isEmpty() ? QSize(0, 0) : size),
+      m_xs(m_size.width() * m_size.height()),
+      m_ys(m_size.width() * m_size.height())
+{
+}
+
+QSize RemapTable::size() const
+{
+    return m_size;
+}
+
+qint64 RemapTable::bytes() const
+{
+    return qint64(m_xs.size() + m_ys.size()) * qint64(sizeof(qint32));
+}
+
+const qint32* RemapTable::xs(int y) const
+{
+    return m_xs.constData() + qptrdiff(y) * m_size.width();
+}
+
+const qint32* RemapTable::ys(int y) const
+{
+    return m_ys.constData() + qptrdiff(y) * m_size.width();
+}
+
+void RemapTable::set(int x, int y, qreal sourceX, qreal sourceY)
+{
+    const qptrdiff i = qptrdiff(y) * m_size.width() + x;
+    m_xs.data()[i] = qint32(qRound(qBound(-kCoordinateLimit, sourceX, kCoordinateLimit) * kFixedOne));
+    m_ys.data()[i] = qint32(qRound(qBound(-kCoordinateLimit, sourceY, kCoordinateLimit) * kFixedOne));
+}
+
+RadialTable::RadialTable(const QSize& size)
+    : m_size(size.isEmpty() ? QSize(0, 0) : size),
+      m_center(m_size.width() / 2, m_size.height() / 2)
+{
+    if(m_size.isEmpty()){
+        return;
+    }
+    // Pixels right of and below the center are never farther out than those left of and above it.
+    const int columns = m_center.x() + 1;
+    const int rows = m_center.y() + 1;
+    m_distances.resize(columns * rows);
+    quint16* distances = m_distances.data();
+    TileScheduler::forEachBand(QSize(columns, rows), columns * int(sizeof(quint16)), 0, [&](const TileScheduler::Tile& tile){
+        for(int dy = tile.rect.top(); dy <= tile.rect.bottom(); ++dy){
+            quint16* row = distances + qptrdiff(dy) * columns;
+            for(int dx = 0; dx < columns; ++dx){
+                const int distance = int(qSqrt(qreal(qint64(dx) * dx + qint64(dy) * dy)));
+                row[dx] = quint16(qMin(distance, 0xffff));
+            }
+        }
+    });
+}
+
+QSize RadialTable::size() const
+{
+    return m_size;
+}
+
+QPoint RadialTable::center() const
+{
+    return m_center;
+}
+
+qint64 RadialTable::bytes() const
+{
+    return qint64(m_distances.size()) * qint64(sizeof(quint16));
+}
+
+int RadialTable::maxDistance() const
+{
+    return m_distances.isEmpty() ? 0 : m_distances.last();
+}
+
+const quint16* RadialTable::distances(int y) const
+{
+    return m_distances.constData() + qptrdiff(qAbs(y - m_center.y())) * (m_center.x() + 1);
+}
+
+QImage WarpEngine::warpPerspective(const QImage& src, const QTransform& homography, const QSize& size,
+                                   ImageManipulator::Interpolation interpolation, EdgeMode edges){
+    return remap(src, *perspectiveTable(homography, size), interpolation, edges);
+}
+
+QImage WarpEngine::correctLensDistortion(const QImage& src, qreal k1, qreal k2,
+                                         ImageManipulator::Interpolation interpolation, EdgeMode edges){
+    return remap(src, *lensTable(src.size(), k1, k2), interpolation, edges);
+}
+
+QImage WarpEngine::remap(const QImage& src, const RemapTable& table, ImageManipulator::Interpolation interpolation,
+                         EdgeMode edges){
+    if(src.isNull() || table.size().isEmpty()){
+        return QImage();
+    }
+
+    const QImage source = src.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const SimdKernels::RemapSource remapSource = {
+        reinterpret_cast<const QRgb*>(source.constBits()), source.bytesPerLine() / 4, source.width(), source.height(),
+        edges == EdgeMode::Clamp
+    };
+    QImage dst(table.size(), QImage::Format_ARGB32_Premultiplied);
+    dst.setDotsPerMeterX(src.dotsPerMeterX());
+    dst.setDotsPerMeterY(src.dotsPerMeterY());
+
+    uchar* bits = dst.bits();
+    const qptrdiff stride = dst.bytesPerLine();
+    const int width = dst.width();
+    TileScheduler::forEachBand(dst.size(), dst.bytesPerLine(), 0, [&](const TileScheduler::Tile& tile){
+        for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+            remapRow(remapSource, table.xs(y), table.ys(y), width, reinterpret_cast<QRgb*>(bits + y * stride), interpolation);
+        }
+    });
+    if(src.hasAlphaChannel() || edges == EdgeMode::Clamp){
+        return dst.convertToFormat(src.format());
+    }
+    return dst;
+}
+
+QSharedPointer<const RemapTable> WarpEngine::perspectiveTable(const QTransform& homography, const QSize& size){
+    const QByteArray key = KeyBuilder('p').add(size)
+            .add(homography.m11()).add(homography.m12()).add(homography.m13())
+            .add(homography.m21()).add(homography.m22()).add(homography.m23())
+            .add(homography.m31()).add(homography.m32()).add(homography.m33()).key();
+    return cachedTable(cache().remapTables, key, [&](){
+        RemapTable* table = new RemapTable(size);
+        bool invertible = false;
+        const QTransform inverse = homography.inverted(&invertible);
+        TileScheduler::forEachBand(table->size(), table->size().width() * 8, 0, [&](const TileScheduler::Tile& tile){
+            for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+                // Pixel centers are at +0.5 in the continuous coordinates the homography works in.
+                const qreal py = y + 0.5;
+                for(int x = 0; x < table->size().width(); ++x){
+                    const qreal px = x + 0.5;
+                    const qreal w = inverse.m13() * px + inverse.m23() * py + inverse.m33();
+                    if(!invertible || w <= 0){
+                        // Behind the camera: nothing of the source shows there.
+                        table->set(x, y, -kCoordinateLimit, -kCoordinateLimit);
+                        continue;
+                    }
+                    table->set(x, y, (inverse.m11() * px + inverse.m21() * py + inverse.m31()) / w - 0.5,
+                               (inverse.m12() * px + inverse.m22() * py + inverse.m32()) / w - 0.5);
+                }
+            }
+        });
+        return table;
+    });
+}
+
+QSharedPointer<const RemapTable> WarpEngine::lensTable(const QSize& size, qreal k1, qreal k2){
+    const QByteArray key = KeyBuilder('l').add(size).add(k1).add(k2).key();
+    return cachedTable(cache().remapTables, key, [&](){
+        RemapTable* table = new RemapTable(size);
+        const qreal centerX = (size.width() - 1) / 2.0;
+        const qreal centerY = (size.height() - 1) / 2.0;
+        const qreal halfDiagonal = qMax(qreal(1), qSqrt(qreal(size.width()) * size.width() + qreal(size.height()) * size.height()) / 2);
+        TileScheduler::forEachBand(table->size(), table->size().width() * 8, 0, [&](const TileScheduler::Tile& tile){
+            for(int y = tile.rect.top(); y <= tile.rect.bottom(); ++y){
+                const qreal dy = (y - centerY) / halfDiagonal;
+                for(int x = 0; x < table->size().width(); ++x){
+                    const qreal dx = (x - centerX) / halfDiagonal;
+                    const qreal r2 = dx * dx + dy * dy;
+                    const qreal scale = 1 + k1 * r2 + k2 * r2 * r2;
+                    table->set(x, y, centerX + dx * scale * halfDiagonal, centerY + dy * scale * halfDiagonal);
+                }
+            }
+        });
+        return table;
+    });
+}
+
+QSharedPointer<const RadialTable> WarpEngine::radialTable(const QSize& size){
+    const QByteArray key = KeyBuilder('r').add(size).key();
+    return cachedTable(cache().radialTables, key, [&](){
+        return new RadialTable(size);
+    });
+}
+
+void WarpEngine::setCacheLimit(qint64 bytes){
+    QMutexLocker locker(&cache().mutex);
+    const int half = costInKiB(bytes / 2);
+    cache().remapTables.setMaxCost(half);
+    cache().radialTables.setMaxCost(half);
+}
+
+void WarpEngine::clearCache(){
+    QMutexLocker locker(&cache().mutex);
+    cache().remapTables.clear();
+    cache().radialTables.clear();
+}
@@ -0,0 +1,103 @@
+#ifndef WARPENGINE_H
+#define WARPENGINE_H
+
+#include <QImage>
+#include <QPoint>
+#include <QSharedPointer>
+#include <QSize>
+#include <QTransform>
+#include <QVector>
+
+#include "imagemanipulator.h"
+
+// Source position of every output pixel of a warp, in the fixed point of the
+// SimdKernels remap kernels with pixel centers on whole numbers.
+class RemapTable
+{
+public:
+    explicit RemapTable(const QSize& size);
+
+    QSize size() const;
+    qint64 bytes() const;
+
+    const qint32* xs(int y) const;
+    const qint32* ys(int y) const;
+
+    // Stores a position in source pixels; positions far outside the source are clamped.
+    void set(int x, int y, qreal sourceX, qreal sourceY);
+
+private:
+    QSize m_size;
+    QVector<qint32> m_xs;
+    QVector<qint32> m_ys;
+};
+
+// Whole-pixel distance of every pixel from the image center (width / 2, height / 2),
+// for radial effects. Distances are symmetric, so only one quadrant is stored.
+class RadialTable
+{
+public:
+    explicit RadialTable(const QSize& size);
+
+    QSize size() const;
+    QPoint center() const;
+    qint64 bytes() const;
+    // Largest distance in the table, that of the corners.
+    int maxDistance() const;
+
+    // Distances of row y, indexed by qAbs(x - center().x()).
+    const quint16* distances(int y) const;
+
+private:
+    QSize m_size;
+    QPoint m_center;
+    QVector<quint16> m_distances;
+};
+
+// Resamples images through arbitrary coordinate maps: perspective (keystone)
+// correction, lens distortion correction, and anything else expressed as a
+// RemapTable. Output rows run in parallel bands through TileScheduler.
+//
+// Tables depend only on the geometry, so they are cached by their parameters
+// and shared: warping a batch of photos from the same camera, or a preview and
+// then the full image, builds each table once.
+class WarpEngine
+{
+public:
+    // What the warp shows where it samples outside the source.
+    enum class EdgeMode{
+        Transparent,
+        Clamp
+    };
+
+public:
+    // homography maps source positions to output positions, e.g.
+    // QTransform::quadToQuad() from the corners of a keystoned document to a
+    // rectangle. The output has the given size.
+    static QImage warpPerspective(const QImage& src, const QTransform& homography, const QSize& size,
+                                  ImageManipulator::Interpolation interpolation = ImageManipulator::Interpolation::Bicubic,
+                                  EdgeMode edges = EdgeMode::Transparent);
+    // Removes radial (barrel or pincushion) distortion with the Brown model: an
+    // output pixel at radius r from the center, as a fraction of the half diagonal,
+    // is read from radius r * (1 + k1 * r^2 + k2 * r^4).
+    static QImage correctLensDistortion(const QImage& src, qreal k1, qreal k2,
+                                        ImageManipulator::Interpolation interpolation = ImageManipulator::Interpolation::Bicubic,
+                                        EdgeMode edges = EdgeMode::Clamp);
+    // The output has the table's size. Images without alpha keep their format only
+    // when the edges are clamped; otherwise the result is ARGB32_Premultiplied.
+    static QImage remap(const QImage& src, const RemapTable& table, ImageManipulator::Interpolation interpolation,
+                        EdgeMode edges);
+
+    // Cached tables, built in parallel on first use.
+    static QSharedPointer<const RemapTable> perspectiveTable(const QTransform& homography, const QSize& size);
+    static QSharedPointer<const RemapTable> lensTable(const QSize& size, qreal k1, qreal k2);
+    static QSharedPointer<const RadialTable> radialTable(const QSize& size);
+
+    // Memory all cached tables may take together, 512 MiB by default. The least
+    // recently used tables are dropped first; a table larger than the limit is
+    // built for each call and never kept.
+    static void setCacheLimit(qint64 bytes);
+    static void clearCache();
+};
+
+#endif // WARPENGINE_H